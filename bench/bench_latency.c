@@ -0,0 +1,363 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <uiohook.h>
+
+#define DEFAULT_EVENT_COUNT 1000
+
+// An event which doesn't reach the hook in this time is counted as lost.
+#define RECEIVE_TIMEOUT_MS  1000
+
+// The histogram buckets are powers of two of microseconds, so the last one holds everything from about 1 s.
+#define HISTOGRAM_BUCKETS   21
+#define HISTOGRAM_WIDTH     50
+
+#define NS_PER_US           1000ULL
+#define NS_PER_MS           1000000ULL
+#define NS_PER_S            1000000000ULL
+
+static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t state_cond = PTHREAD_COND_INITIALIZER;
+
+static bool hook_enabled = false;
+static bool hook_disabled = false;
+static uint64_t enabled_ns;
+
+// The event which the benchmark is waiting for, and when it arrived.
+static bool waiting = false;
+static bool arrived = false;
+static uint16_t expected_type;
+static uint64_t arrival_ns;
+
+static void logger_proc(unsigned int level, void *user_data, const char *format, va_list args) {
+    switch (level) {
+        case LOG_LEVEL_WARN:
+        case LOG_LEVEL_ERROR:
+            vfprintf(stderr, format, args);
+            break;
+    }
+}
+
+static uint64_t get_monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static bool is_expected(uiohook_event * const event) {
+    switch (event->type) {
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            return event->type == expected_type && event->data.keyboard.keycode == VC_SHIFT_L;
+
+        // Relative motion is reported as absolute when the back-end knows where the pointer is.
+        case EVENT_MOUSE_MOVED:
+        case EVENT_MOUSE_MOVED_RELATIVE:
+            return expected_type == EVENT_MOUSE_MOVED_RELATIVE;
+
+        default:
+            return false;
+    }
+}
+
+static void dispatch_proc(uiohook_event * const event, void *user_data) {
+    // The time is taken first, so that waiting for the lock isn't counted.
+    uint64_t now = get_monotonic_ns();
+
+    pthread_mutex_lock(&state_mutex);
+
+    switch (event->type) {
+        case EVENT_HOOK_ENABLED:
+            hook_enabled = true;
+            enabled_ns = now;
+            pthread_cond_broadcast(&state_cond);
+            break;
+
+        case EVENT_HOOK_DISABLED:
+            hook_disabled = true;
+            pthread_cond_broadcast(&state_cond);
+            break;
+
+        default:
+            // Only the events which this process has posted are matched, and only the first one of each.
+            if (waiting && !arrived && (event->mask & MASK_EMULATED) && is_expected(event)) {
+                arrived = true;
+                arrival_ns = now;
+                pthread_cond_broadcast(&state_cond);
+            }
+            break;
+    }
+
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static void *hook_thread_proc(void *arg) {
+    int status = hook_run();
+    if (status != UIOHOOK_SUCCESS) {
+        fprintf(stderr, "Failed to run the hook! (%#X)\n", status);
+    }
+
+    // The hook may fail before it's enabled, so don't leave the benchmark waiting for it.
+    pthread_mutex_lock(&state_mutex);
+    hook_disabled = true;
+    pthread_cond_broadcast(&state_cond);
+    pthread_mutex_unlock(&state_mutex);
+
+    return NULL;
+}
+
+// Posts a single event and waits for the hook to report it. Returns false if it was lost.
+static bool measure(uiohook_event *event, uint16_t type, uint64_t *latency_ns) {
+    pthread_mutex_lock(&state_mutex);
+    waiting = true;
+    arrived = false;
+    expected_type = type;
+    pthread_mutex_unlock(&state_mutex);
+
+    uint64_t start = get_monotonic_ns();
+
+    int status = hook_post_event(event);
+    if (status != UIOHOOK_SUCCESS) {
+        fprintf(stderr, "Failed to post an event! (%#X)\n", status);
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    uint64_t deadline_ns = (uint64_t) deadline.tv_nsec + RECEIVE_TIMEOUT_MS * NS_PER_MS;
+    deadline.tv_sec += deadline_ns / NS_PER_S;
+    deadline.tv_nsec = deadline_ns % NS_PER_S;
+
+    pthread_mutex_lock(&state_mutex);
+
+    int result = 0;
+    while (status == UIOHOOK_SUCCESS && !arrived && result == 0) {
+        result = pthread_cond_timedwait(&state_cond, &state_mutex, &deadline);
+    }
+
+    bool received = arrived;
+    waiting = false;
+    *latency_ns = arrival_ns - start;
+
+    pthread_mutex_unlock(&state_mutex);
+
+    return received;
+}
+
+static int compare_latencies(const void *left, const void *right) {
+    uint64_t left_value = *(const uint64_t *) left;
+    uint64_t right_value = *(const uint64_t *) right;
+
+    return (left_value > right_value) - (left_value < right_value);
+}
+
+static double get_percentile_us(const uint64_t *latencies, uint32_t count, double percentile) {
+    uint32_t index = (uint32_t) (percentile / 100 * (count - 1) + 0.5);
+
+    return latencies[index] / (double) NS_PER_US;
+}
+
+static void print_histogram(const uint64_t *latencies, uint32_t count) {
+    uint32_t buckets[HISTOGRAM_BUCKETS] = {};
+    uint32_t max_bucket = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t us = latencies[i] / NS_PER_US;
+
+        unsigned int bucket = 0;
+        while (us > 1 && bucket < HISTOGRAM_BUCKETS - 1) {
+            us >>= 1;
+            bucket++;
+        }
+
+        buckets[bucket]++;
+        if (buckets[bucket] > max_bucket) {
+            max_bucket = buckets[bucket];
+        }
+    }
+
+    for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+
+        unsigned int width = (unsigned int) ((uint64_t) buckets[i] * HISTOGRAM_WIDTH / max_bucket);
+
+        fprintf(stdout, "  < %8llu us %7u ", 1ULL << (i + 1), buckets[i]);
+        for (unsigned int j = 0; j < width; j++) {
+            fputc('#', stdout);
+        }
+
+        fputc('\n', stdout);
+    }
+}
+
+// Measures how long it takes from starting the hook until it's enabled, and until the first posted event arrives.
+static int run_startup_benchmark(uint64_t start_ns) {
+    uiohook_event event = {
+        .type = EVENT_KEY_PRESSED,
+        .data.keyboard.keycode = VC_SHIFT_L
+    };
+
+    uint64_t latency;
+    bool received = measure(&event, EVENT_KEY_PRESSED, &latency);
+    uint64_t first_event_ns = arrival_ns;
+
+    // The key is released again, so that the rest of the benchmark starts with it up.
+    event.type = EVENT_KEY_RELEASED;
+    measure(&event, EVENT_KEY_RELEASED, &latency);
+
+    if (!received) {
+        fprintf(stdout, "startup: hook enabled after %.1f ms, the first event was lost\n",
+                (enabled_ns - start_ns) / (double) NS_PER_MS);
+
+        return UIOHOOK_FAILURE;
+    }
+
+    fprintf(stdout, "startup: hook enabled after %.1f ms, first event after %.1f ms\n",
+            (enabled_ns - start_ns) / (double) NS_PER_MS,
+            (first_event_ns - start_ns) / (double) NS_PER_MS);
+
+    return UIOHOOK_SUCCESS;
+}
+
+static int run_benchmark(const char *name, uint32_t count, bool keyboard) {
+    uint64_t *latencies = malloc(sizeof(uint64_t) * count);
+    if (latencies == NULL) {
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    uint32_t received = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uiohook_event event;
+        uint16_t type;
+
+        if (keyboard) {
+            // Presses and releases the left shift key, which doesn't type anything on its own.
+            type = i % 2 == 0 ? EVENT_KEY_PRESSED : EVENT_KEY_RELEASED;
+            event = (uiohook_event) {
+                .type = type,
+                .data.keyboard.keycode = VC_SHIFT_L
+            };
+        } else {
+            // Moves the pointer back and forth by a pixel, so that the benchmark leaves it where it was.
+            type = EVENT_MOUSE_MOVED_RELATIVE;
+            event = (uiohook_event) {
+                .type = type,
+                .data.mouse.x = i % 2 == 0 ? 1 : -1,
+                .data.mouse.y = 0
+            };
+        }
+
+        uint64_t latency;
+        if (measure(&event, type, &latency)) {
+            latencies[received++] = latency;
+        }
+    }
+
+    fprintf(stdout, "%s: %u of %u events received\n", name, received, count);
+
+    if (received > 0) {
+        qsort(latencies, received, sizeof(uint64_t), compare_latencies);
+
+        fprintf(stdout, "  p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+                get_percentile_us(latencies, received, 50),
+                get_percentile_us(latencies, received, 99),
+                get_percentile_us(latencies, received, 99.9),
+                get_percentile_us(latencies, received, 100));
+
+        print_histogram(latencies, received);
+    }
+
+    free(latencies);
+
+    return received == count ? UIOHOOK_SUCCESS : UIOHOOK_FAILURE;
+}
+
+static bool set_backend(const char *name) {
+    if (strcmp(name, "auto") == 0) {
+        return true;
+    }
+
+    int mode;
+    if (strcmp(name, "x11") == 0) {
+        mode = LINUX_MODE_X11;
+    } else if (strcmp(name, "wayland") == 0) {
+        mode = LINUX_MODE_WAYLAND;
+    } else if (strcmp(name, "xrecord") == 0) {
+        mode = LINUX_MODE_XRECORD;
+    } else {
+        return false;
+    }
+
+    return hook_set_linux_mode(mode) == UIOHOOK_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    hook_set_logger_proc(&logger_proc, NULL);
+
+    const char *backend = argc > 1 ? argv[1] : "auto";
+    uint32_t count = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : DEFAULT_EVENT_COUNT;
+
+    if (!set_backend(backend) || count == 0) {
+        fprintf(stderr, "Usage: %s [auto|x11|wayland|xrecord] [event count]\n", argv[0]);
+        return UIOHOOK_FAILURE;
+    }
+
+    int status = hook_init_virtual_devices("uiohook benchmark");
+    if (status != UIOHOOK_SUCCESS) {
+        fprintf(stderr, "Failed to initialize the virtual devices! (%#X)\n", status);
+        return status;
+    }
+
+    hook_set_dispatch_proc(dispatch_proc, NULL);
+
+    uint64_t start_ns = get_monotonic_ns();
+
+    pthread_t hook_thread;
+    pthread_create(&hook_thread, NULL, hook_thread_proc, NULL);
+
+    pthread_mutex_lock(&state_mutex);
+    while (!hook_enabled && !hook_disabled) {
+        pthread_cond_wait(&state_cond, &state_mutex);
+    }
+
+    bool enabled = hook_enabled;
+    pthread_mutex_unlock(&state_mutex);
+
+    if (enabled) {
+        fprintf(stdout, "Measuring the latency from posting to the hook with %u events\n", count);
+
+        status = run_startup_benchmark(start_ns);
+
+        int key_status = run_benchmark("key", count, true);
+        if (status == UIOHOOK_SUCCESS) {
+            status = key_status;
+        }
+
+        int motion_status = run_benchmark("motion", count, false);
+        if (status == UIOHOOK_SUCCESS) {
+            status = motion_status;
+        }
+
+        hook_stop();
+    } else {
+        status = UIOHOOK_FAILURE;
+    }
+
+    pthread_join(hook_thread, NULL);
+
+    hook_set_dispatch_proc(NULL, NULL);
+    hook_destroy_virtual_devices();
+
+    return status;
+}
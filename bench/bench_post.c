@@ -0,0 +1,108 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define sleep(x) Sleep(1000 * (x))
+#else
+#include <unistd.h>
+#endif
+
+#define EVENT_COUNT 10000
+
+static void logger_proc(unsigned int level, void *user_data, const char *format, va_list args) {
+    switch (level) {
+        case LOG_LEVEL_WARN:
+        case LOG_LEVEL_ERROR:
+            vfprintf(stderr, format, args);
+            break;
+    }
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Moves the pointer back and forth by a pixel, so that the benchmark leaves it where it was.
+static void fill_motion_events(uiohook_event *events, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        events[i] = (uiohook_event) {
+            .type = EVENT_MOUSE_MOVED_RELATIVE,
+            .data.mouse.x = i % 2 == 0 ? 1 : -1,
+            .data.mouse.y = 0
+        };
+    }
+}
+
+// Presses and releases the left shift key, which doesn't type anything on its own.
+static void fill_key_events(uiohook_event *events, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        events[i] = (uiohook_event) {
+            .type = i % 2 == 0 ? EVENT_KEY_PRESSED : EVENT_KEY_RELEASED,
+            .data.keyboard.keycode = VC_SHIFT_L
+        };
+    }
+}
+
+static int run_benchmark(const char *name, uiohook_event *events, uint32_t count, uint32_t batch_size) {
+    double start = now_seconds();
+
+    for (uint32_t i = 0; i < count; i += batch_size) {
+        uint32_t size = count - i < batch_size ? count - i : batch_size;
+
+        int status = hook_post_events(events + i, size);
+        if (status != UIOHOOK_SUCCESS) {
+            fprintf(stderr, "Failed to post the %s events! (%#X)\n", name, status);
+            return status;
+        }
+    }
+
+    double elapsed = now_seconds() - start;
+
+    fprintf(stdout, "%-8s batch size %5u: %10.0f events/s\n", name, batch_size, count / elapsed);
+
+    return UIOHOOK_SUCCESS;
+}
+
+int main() {
+    hook_set_logger_proc(&logger_proc, NULL);
+
+    uiohook_event *events = malloc(sizeof(uiohook_event) * EVENT_COUNT);
+    if (events == NULL) {
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    int status = hook_init_virtual_devices("uiohook benchmark");
+    if (status != UIOHOOK_SUCCESS) {
+        fprintf(stderr, "Failed to initialize the virtual devices! (%#X)\n", status);
+
+        free(events);
+        return status;
+    }
+
+    sleep(1);
+
+    uint32_t batch_sizes[] = { 1, 16, 256, EVENT_COUNT };
+    size_t batch_size_count = sizeof(batch_sizes) / sizeof(batch_sizes[0]);
+
+    fill_motion_events(events, EVENT_COUNT);
+    for (size_t i = 0; i < batch_size_count && status == UIOHOOK_SUCCESS; i++) {
+        status = run_benchmark("motion", events, EVENT_COUNT, batch_sizes[i]);
+    }
+
+    fill_key_events(events, EVENT_COUNT);
+    for (size_t i = 0; i < batch_size_count && status == UIOHOOK_SUCCESS; i++) {
+        status = run_benchmark("key", events, EVENT_COUNT, batch_sizes[i]);
+    }
+
+    hook_destroy_virtual_devices();
+    free(events);
+
+    return status;
+}
@@ -13,6 +13,7 @@
 #define UIOHOOK_ERROR_OUT_OF_MEMORY                           0x02
 #define UIOHOOK_ERROR_NULL                                    0x03
 #define UIOHOOK_ERROR_UNSUPPORTED_FEATURE                     0x04
+#define UIOHOOK_ERROR_CANCELED                                0x05
 
 // Linux-specific errors.
 #define UIOHOOK_ERROR_LINUX_LOAD_BACKEND                      0x10
@@ -60,6 +61,14 @@
 #define UIOHOOK_FEATURE_POINTER_PROPERTIES             (1 << 6)
 /* End Optional Features */
 
+/* Begin System Settings */
+#define UIOHOOK_SETTING_AUTO_REPEAT_RATE                    (1 << 0)
+#define UIOHOOK_SETTING_AUTO_REPEAT_DELAY                   (1 << 1)
+#define UIOHOOK_SETTING_POINTER_ACCELERATION_MULTIPLIER     (1 << 2)
+#define UIOHOOK_SETTING_POINTER_ACCELERATION_THRESHOLD      (1 << 3)
+#define UIOHOOK_SETTING_POINTER_SENSITIVITY                 (1 << 4)
+/* End System Settings */
+
 /* Begin Linux Modes */
 #define LINUX_MODE_AUTO_XRECORD     0x0
 #define LINUX_MODE_AUTO_LOW_LEVEL   0x1
@@ -145,11 +154,43 @@ typedef struct _uiohook_event {
     } data;
 } uiohook_event;
 
+// A relative pointer movement which can include fractions of a pixel.
+typedef struct _relative_motion_data {
+    double x;
+    double y;
+} relative_motion_data;
+
+// A point which a pointer path goes through or is bent towards.
+typedef struct _pointer_waypoint {
+    int16_t x;
+    int16_t y;
+} pointer_waypoint;
+
+// How a pointer path is generated. Absolute paths are in desktop coordinates, and relative ones are relative to
+// the pointer position when the path starts. The duration is in milliseconds, and the rate is in events per second.
+typedef struct _pointer_path_options {
+    uint8_t curve;
+    uint8_t easing;
+    bool relative;
+    uint32_t duration;
+    uint32_t rate;
+} pointer_path_options;
+
 typedef void (*dispatcher_t)(uiohook_event * const, void *);
 
 typedef int (*device_open_t)(const char *path, int flags, void *user_data);
 
 typedef void (*device_close_t)(int fd, void *user_data);
+
+// Settings changed callback function prototype, which receives the bitmask of the settings that have changed.
+typedef void (*settings_changed_t)(uint32_t, void *);
+
+// Timed post progress callback function prototype, which receives the number of events posted so far, the total
+// number of events and the status. The last call either has all events posted or a status other than success.
+typedef void (*post_progress_t)(uint32_t, uint32_t, int, void *);
+
+// Preload callback function prototype, which receives the status once the back-end is ready or has failed to load.
+typedef void (*preload_done_t)(int, void *);
 /* End Virtual Event Types and Data Structures */
 
 
@@ -405,6 +446,10 @@ typedef void (*device_close_t)(int fd, void *user_data);
 #define MASK_CAPS_LOCK                           (1 << 14)
 #define MASK_SCROLL_LOCK                         (1 << 15)
 
+// The virtual device set which posted an emulated event, or 0 for the default virtual devices and other devices.
+#define MASK_VIRTUAL_DEVICE_SET                  (0xFF << 16)
+#define MASK_VIRTUAL_DEVICE_SET_SHIFT            16
+
 #define MASK_EMULATED                            (1 << 30)
 #define MASK_CONSUMED                            (1U << 31)
 /* End Virtual Modifier Masks */
@@ -425,6 +470,40 @@ typedef void (*device_close_t)(int fd, void *user_data);
 #define WHEEL_HORIZONTAL_DIRECTION               4
 /* End Virtual Mouse Buttons */
 
+
+/* Begin Pointer Paths */
+#define POINTER_PATH_CURVE_LINEAR                0    // Straight lines through the waypoints
+#define POINTER_PATH_CURVE_BEZIER                1    // A Bezier curve whose control points are the waypoints
+
+#define POINTER_PATH_EASING_LINEAR               0    // Constant speed
+#define POINTER_PATH_EASING_IN                   1    // Speeds up from the start
+#define POINTER_PATH_EASING_OUT                  2    // Slows down towards the end
+#define POINTER_PATH_EASING_IN_OUT               3    // Speeds up and then slows down
+
+// The most events per second which a pointer path is posted with, as event times are in milliseconds.
+#define POINTER_PATH_RATE_MAX                    1000
+/* End Pointer Paths */
+
+
+/* Begin Hook Statistics */
+#define HOOK_STATS_EVENT_TYPES                   (EVENT_MOUSE_WHEEL + 1)    // Indexed by the event type
+#define HOOK_STATS_DELAY_BUCKETS                 32
+
+// Counters of the events which the hook received, which are kept since the back-end was loaded or the counters were
+// reset. Times are in nanoseconds. Bucket 0 of the delay histogram counts the events which were dispatched less than
+// a microsecond after the kernel timestamped them, and bucket i counts delays from 2^(i - 1) up to 2^i microseconds.
+// The last bucket also counts every longer delay. Events without a kernel timestamp aren't in the histogram, and
+// events are dropped when there is no dispatch callback.
+typedef struct _hook_stats {
+    uint64_t events[HOOK_STATS_EVENT_TYPES];
+    uint64_t events_dropped;
+    uint64_t callback_count;
+    uint64_t callback_time_total;
+    uint64_t callback_time_max;
+    uint64_t delay_histogram[HOOK_STATS_DELAY_BUCKETS];
+} hook_stats;
+/* End Hook Statistics */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -434,9 +513,20 @@ extern "C" {
     // Set the logger callback function.
     void hook_set_logger_proc(logger_t logger_proc, void *user_data);
 
+    // Get the lowest level of the messages which are passed to the logger callback.
+    unsigned int hook_get_log_level();
+
+    // Set the lowest level of the messages which are passed to the logger callback. Messages below it are dropped
+    // before they are formatted, so it's cheaper than filtering them in the callback.
+    void hook_set_log_level(unsigned int level);
+
     // Set the event callback function.
     void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data);
 
+    // Set the callback function which is called when the values of the system properties change.
+    // The callback is called on an internal thread.
+    void hook_set_settings_changed_proc(settings_changed_t settings_changed_proc, void *user_data);
+
     // Insert the event hook for all events.
     int hook_run();
 
@@ -455,6 +545,28 @@ extern "C" {
     // Send virtual events back to the system.
     int hook_post_events(uiohook_event * const events, uint32_t size);
 
+    // Send virtual events back to the system, and get the number of events which were posted. When posting fails,
+    // it's the index of the event which stopped it, and the events from that index on may not have been posted.
+    int hook_post_events_counted(uiohook_event * const events, uint32_t size, uint32_t *posted);
+
+    // Send virtual events back to the system on a library thread, keeping the intervals between their times.
+    // The events are copied, and the progress callback is called on that thread. Only one batch can be posted
+    // this way at a time.
+    int hook_post_events_timed(uiohook_event * const events, uint32_t size, post_progress_t progress_proc,
+        void *user_data);
+
+    // Stop posting the events which were passed to hook_post_events_timed.
+    int hook_cancel_post_events_timed();
+
+    // Move the pointer along a path on a library thread, which generates the intermediate movements itself. It is
+    // posted like events which are passed to hook_post_events_timed, so it can be canceled the same way.
+    int hook_post_pointer_path(const pointer_waypoint * const waypoints, uint32_t count,
+        const pointer_path_options * const options, post_progress_t progress_proc, void *user_data);
+
+    // Move the pointer by fractions of a pixel. The fractions which can't be posted yet are kept and added to the
+    // next movements, so that a path which is split into many small movements doesn't drift.
+    int hook_post_relative_motion(const relative_motion_data * const motions, uint32_t size);
+
     // Send text back to the system.
     int hook_post_text(const uint16_t * const text);
 
@@ -464,6 +576,17 @@ extern "C" {
     // Destroy the virtual devices used for event simulation.
     int hook_destroy_virtual_devices();
 
+    // Create a set of virtual devices which is independent of the default ones, and get its ID. Each set has
+    // its own devices, so events can be posted to different sets at the same time, and the hook reports the ID
+    // in the mask of the events which were posted to it.
+    int hook_create_virtual_device_set(const char * const application_name, uint8_t *set_id);
+
+    // Destroy a set of virtual devices.
+    int hook_destroy_virtual_device_set(uint8_t set_id);
+
+    // Send virtual events back to the system using a set of virtual devices, or the default ones if the ID is 0.
+    int hook_post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size);
+
     /* End Main Functions */
 
     /* Begin Platform-Independent Configuration Functions */
@@ -509,12 +632,23 @@ extern "C" {
     // Get the mode which selects the back-end on Linux.
     int hook_get_linux_mode();
 
-    // Set the mode which selects the back-end on Linux.
+    // Set the mode which selects the back-end on Linux. If a different back-end is already loaded, it's switched to the
+    // new one: the callbacks, the settings and the virtual devices are moved over, and a running hook is stopped and
+    // started again on the new back-end, so the dispatcher gets EVENT_HOOK_DISABLED and EVENT_HOOK_ENABLED. Fails with
+    // UIOHOOK_FAILURE while virtual device sets or a timed post are active, as their IDs and callbacks can't be moved.
+    // The previous back-end stays loaded, but releases its threads and connections once its hook has stopped, so this
+    // mustn't be called from its settings changed callback.
     int hook_set_linux_mode(int mode);
 
     // Get the back-end which is currently loaded on Linux.
     int hook_get_loaded_linux_backend();
 
+    // Load the back-end which the mode selects on a background thread, and open what it otherwise opens on first use,
+    // e.g. the display connections, the keymap and the screen layout. The callback is called on a background thread
+    // once it's ready, or right away on platforms which have nothing to load. Fails if a different back-end is already
+    // loaded.
+    int hook_preload(int mode, preload_done_t done_proc, void *user_data);
+
     // Supply the device node descriptors instead of opening them directly.
     void hook_set_device_procs(device_open_t open_proc, device_close_t close_proc, void *user_data);
 
@@ -525,6 +659,11 @@ extern "C" {
     // Retrieves an array of screen data for each available monitor.
     screen_data* hook_create_screen_info(unsigned char *count);
 
+    // Copies the screen data for each available monitor into the buffer and returns the number of monitors.
+    // Nothing is copied if the buffer is too small, or if layout_version already holds the version of the current
+    // layout. Otherwise layout_version is set to it. Pass 0 as the version to always get the current layout.
+    uint8_t hook_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *layout_version);
+
     // Retrieves the keyboard auto repeat rate.
     long int hook_get_auto_repeat_rate();
 
@@ -543,6 +682,12 @@ extern "C" {
     // Retrieves the double/triple click interval.
     long int hook_get_multi_click_time();
 
+    // Copies the counters of the events which the hook received. Only supported on Linux.
+    int hook_get_stats(hook_stats *stats);
+
+    // Resets the counters of the events which the hook received.
+    void hook_reset_stats();
+
     /* End System Info Functions */
 
 #ifdef __cplusplus
@@ -0,0 +1,14 @@
+#ifndef BACKEND_LIFECYCLE_H
+#define BACKEND_LIFECYCLE_H
+
+#include <stdbool.h>
+
+/* Reports whether the back-end has virtual device sets or a timed post, which belong to the caller and can't be moved
+ * over to another back-end. The loader refuses to switch away from a busy back-end. */
+bool backend_is_busy();
+
+/* Releases the threads, connections and virtual devices of a back-end which was switched away from, once its hook has
+ * stopped. The back-end stays loaded, and opens them again when it's used later on. */
+void backend_release();
+
+#endif
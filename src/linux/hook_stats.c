@@ -0,0 +1,103 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <uiohook.h>
+
+#include "hook_stats.h"
+
+#define NS_PER_S    1000000000ULL
+#define NS_PER_US   1000ULL
+
+// Only the hook thread counts events, and nothing is ordered by the counters, so relaxed atomics are enough for them to
+// be read from any thread.
+static atomic_uint_fast64_t events[HOOK_STATS_EVENT_TYPES];
+static atomic_uint_fast64_t events_dropped;
+static atomic_uint_fast64_t callback_count;
+static atomic_uint_fast64_t callback_time_total;
+static atomic_uint_fast64_t callback_time_max;
+static atomic_uint_fast64_t delay_histogram[HOOK_STATS_DELAY_BUCKETS];
+
+static void increment(atomic_uint_fast64_t *counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+uint64_t stats_get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+// Delays are bucketed by the number of bits in microseconds, so every bucket is twice as wide as the one before it.
+static unsigned int get_delay_bucket(uint64_t delay) {
+    uint64_t delay_us = delay / NS_PER_US;
+    if (delay_us == 0) {
+        return 0;
+    }
+
+    unsigned int bucket = 64 - __builtin_clzll(delay_us);
+    return bucket < HOOK_STATS_DELAY_BUCKETS ? bucket : HOOK_STATS_DELAY_BUCKETS - 1;
+}
+
+void stats_record_event(uint16_t type, uint64_t event_time, uint64_t now) {
+    if (type < HOOK_STATS_EVENT_TYPES) {
+        increment(&events[type], 1);
+    }
+
+    // Events which were timestamped on another clock, e.g. by a remote X server, can't be measured.
+    if (event_time != STATS_NO_EVENT_TIME && event_time <= now) {
+        increment(&delay_histogram[get_delay_bucket(now - event_time)], 1);
+    }
+}
+
+void stats_record_dropped() {
+    increment(&events_dropped, 1);
+}
+
+void stats_record_callback(uint64_t duration) {
+    increment(&callback_count, 1);
+    increment(&callback_time_total, duration);
+
+    uint64_t max = atomic_load_explicit(&callback_time_max, memory_order_relaxed);
+    while (duration > max && !atomic_compare_exchange_weak_explicit(&callback_time_max, &max, duration,
+            memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+int hook_get_stats(hook_stats *stats) {
+    if (stats == NULL) {
+        return UIOHOOK_FAILURE;
+    }
+
+    // The counters are read one by one while the hook may still be counting, so they can be an event apart.
+    for (unsigned int i = 0; i < HOOK_STATS_EVENT_TYPES; i++) {
+        stats->events[i] = atomic_load_explicit(&events[i], memory_order_relaxed);
+    }
+
+    stats->events_dropped = atomic_load_explicit(&events_dropped, memory_order_relaxed);
+    stats->callback_count = atomic_load_explicit(&callback_count, memory_order_relaxed);
+    stats->callback_time_total = atomic_load_explicit(&callback_time_total, memory_order_relaxed);
+    stats->callback_time_max = atomic_load_explicit(&callback_time_max, memory_order_relaxed);
+
+    for (unsigned int i = 0; i < HOOK_STATS_DELAY_BUCKETS; i++) {
+        stats->delay_histogram[i] = atomic_load_explicit(&delay_histogram[i], memory_order_relaxed);
+    }
+
+    return UIOHOOK_SUCCESS;
+}
+
+void hook_reset_stats() {
+    for (unsigned int i = 0; i < HOOK_STATS_EVENT_TYPES; i++) {
+        atomic_store_explicit(&events[i], 0, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&events_dropped, 0, memory_order_relaxed);
+    atomic_store_explicit(&callback_count, 0, memory_order_relaxed);
+    atomic_store_explicit(&callback_time_total, 0, memory_order_relaxed);
+    atomic_store_explicit(&callback_time_max, 0, memory_order_relaxed);
+
+    for (unsigned int i = 0; i < HOOK_STATS_DELAY_BUCKETS; i++) {
+        atomic_store_explicit(&delay_histogram[i], 0, memory_order_relaxed);
+    }
+}
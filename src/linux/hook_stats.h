@@ -0,0 +1,27 @@
+#ifndef HOOK_STATS_H
+#define HOOK_STATS_H
+
+#include <stdint.h>
+
+#include <uiohook.h>
+
+// The event time of events which the kernel didn't timestamp, e.g. when the hook is enabled.
+#define STATS_NO_EVENT_TIME 0
+
+// Every back-end counts its own events, so the helpers are hidden rather than resolved to the copies of another object
+// through symbol interposition. Only hook_get_stats and hook_reset_stats are exported.
+#define STATS_HIDDEN __attribute__((visibility("hidden")))
+
+/* Returns the time of the monotonic clock, which the kernel timestamps input events with, in nanoseconds. */
+STATS_HIDDEN uint64_t stats_get_time();
+
+/* Counts an event which is about to be dispatched, and the delay since the event time unless it's unknown. */
+STATS_HIDDEN void stats_record_event(uint16_t type, uint64_t event_time, uint64_t now);
+
+/* Counts an event which was dropped as there was no dispatch callback. */
+STATS_HIDDEN void stats_record_dropped();
+
+/* Counts a call of the dispatch callback which took the duration in nanoseconds. */
+STATS_HIDDEN void stats_record_callback(uint64_t duration);
+
+#endif
@@ -4,6 +4,7 @@
 #include <libgen.h>
 #include <limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -14,7 +15,9 @@
 #include <uiohook.h>
 
 typedef void (*set_logger_proc_t)(logger_t, void *);
+typedef void (*set_log_level_t)(unsigned int);
 typedef void (*set_dispatch_proc_t)(dispatcher_t, void *);
+typedef void (*set_settings_changed_proc_t)(settings_changed_t, void *);
 
 typedef int (*run_t)();
 typedef int (*run_keyboard_t)();
@@ -23,10 +26,19 @@ typedef int (*stop_t)();
 
 typedef int (*post_event_t)(uiohook_event * const);
 typedef int (*post_events_t)(uiohook_event * const, uint32_t);
+typedef int (*post_events_counted_t)(uiohook_event * const, uint32_t, uint32_t *);
 typedef int (*post_text_t)(const uint16_t * const);
+typedef int (*post_events_timed_t)(uiohook_event * const, uint32_t, post_progress_t, void *);
+typedef int (*cancel_post_events_timed_t)();
+typedef int (*post_relative_motion_t)(const relative_motion_data * const, uint32_t);
+typedef int (*post_pointer_path_t)(const pointer_waypoint * const, uint32_t, const pointer_path_options * const,
+    post_progress_t, void *);
 
 typedef int (*init_virtual_devices_t)(const char * const);
 typedef int (*destroy_virtual_devices_t)();
+typedef int (*create_virtual_device_set_t)(const char * const, uint8_t *);
+typedef int (*destroy_virtual_device_set_t)(uint8_t);
+typedef int (*post_events_on_t)(uint8_t, uiohook_event * const, uint32_t);
 
 typedef uint32_t (*get_optional_feature_support_t)();
 
@@ -43,8 +55,12 @@ typedef uint64_t (*get_post_text_delay_linux_t)();
 typedef void (*set_post_text_delay_linux_t)(uint64_t);
 
 typedef void (*set_device_procs_t)(device_open_t, device_close_t, void *);
+typedef int (*preload_t)(int, preload_done_t, void *);
+typedef bool (*is_busy_t)();
+typedef void (*release_t)();
 
 typedef screen_data* (*create_screen_info_t)(unsigned char *);
+typedef uint8_t (*get_screen_info_t)(screen_data *, uint8_t, uint32_t *);
 typedef long int (*get_auto_repeat_rate_t)();
 typedef long int (*get_auto_repeat_delay_t)();
 typedef long int (*get_pointer_acceleration_multiplier_t)();
@@ -52,10 +68,116 @@ typedef long int (*get_pointer_acceleration_threshold_t)();
 typedef long int (*get_pointer_sensitivity_t)();
 typedef long int (*get_multi_click_time_t)();
 
-static bool backend_loaded = false;
-static int loaded_backend = LINUX_LOADED_BACKEND_NONE;
+typedef int (*get_stats_t)(hook_stats *);
+typedef void (*reset_stats_t)();
+
+typedef struct _backend_vtable {
+    int backend;
+
+    set_logger_proc_t set_logger_proc;
+    set_log_level_t set_log_level;
+    set_dispatch_proc_t set_dispatch_proc;
+    set_settings_changed_proc_t set_settings_changed_proc;
+
+    run_t run;
+    run_keyboard_t run_keyboard;
+    run_mouse_t run_mouse;
+    stop_t stop;
+
+    post_event_t post_event;
+    post_events_t post_events;
+    post_events_counted_t post_events_counted;
+    post_text_t post_text;
+    post_events_timed_t post_events_timed;
+    cancel_post_events_timed_t cancel_post_events_timed;
+    post_relative_motion_t post_relative_motion;
+    post_pointer_path_t post_pointer_path;
+
+    init_virtual_devices_t init_virtual_devices;
+    destroy_virtual_devices_t destroy_virtual_devices;
+    create_virtual_device_set_t create_virtual_device_set;
+    destroy_virtual_device_set_t destroy_virtual_device_set;
+    post_events_on_t post_events_on;
+
+    get_optional_feature_support_t get_optional_feature_support;
+
+    is_key_typed_enabled_t is_key_typed_enabled;
+    set_key_typed_enabled_t set_key_typed_enabled;
+
+    is_ax_api_enabled_t is_ax_api_enabled;
+    get_prompt_user_if_ax_api_disabled_t get_prompt_user_if_ax_api_disabled;
+    set_prompt_user_if_ax_api_disabled_t set_prompt_user_if_ax_api_disabled;
+    get_ax_poll_frequency_t get_ax_poll_frequency;
+    set_ax_poll_frequency_t set_ax_poll_frequency;
+
+    get_post_text_delay_linux_t get_post_text_delay_linux;
+    set_post_text_delay_linux_t set_post_text_delay_linux;
+
+    set_device_procs_t set_device_procs;
+    preload_t preload;
+    is_busy_t is_busy;
+    release_t release;
+
+    create_screen_info_t create_screen_info;
+    get_screen_info_t get_screen_info;
+    get_auto_repeat_rate_t get_auto_repeat_rate;
+    get_auto_repeat_delay_t get_auto_repeat_delay;
+    get_pointer_acceleration_multiplier_t get_pointer_acceleration_multiplier;
+    get_pointer_acceleration_threshold_t get_pointer_acceleration_threshold;
+    get_pointer_sensitivity_t get_pointer_sensitivity;
+    get_multi_click_time_t get_multi_click_time;
+
+    get_stats_t get_stats;
+    reset_stats_t reset_stats;
+} backend_vtable;
+
+typedef enum _backend_state {
+    BACKEND_CLOSED,
+    BACKEND_OPEN,
+    BACKEND_RETIRED,
+    BACKEND_RELEASING,
+    BACKEND_RELEASED
+} backend_state;
+
+// The table comes first, so that a pointer to the table is a pointer to its slot.
+typedef struct _backend_slot {
+    backend_vtable table;
+    void *handle;
+    backend_state state;
+} backend_slot;
+
 static int linux_mode = LINUX_MODE_AUTO_XRECORD;
 static pthread_mutex_t backend_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t backend_released_cond = PTHREAD_COND_INITIALIZER;
+
+// The functions of the back-end are filled in under the mutex, and only then is the table published, so calling into
+// the back-end takes a single load of the pointer to it, but never the mutex. Back-ends are never unloaded, so a call
+// which races a switch may still reach the previous back-end, but never one which isn't mapped anymore. Once its hook
+// has stopped, the previous back-end releases its threads and connections, and opens them again if it's used again.
+static backend_slot backend_slots[LINUX_LOADED_BACKEND_WAYLAND];
+static _Atomic(const backend_vtable *) published_vtable = NULL;
+
+static backend_slot *get_slot(const backend_vtable *table) {
+    return (backend_slot *) table;
+}
+
+typedef enum _hook_kind {
+    HOOK_ALL,
+    HOOK_KEYBOARD,
+    HOOK_MOUSE
+} hook_kind;
+
+// The back-end which the hook runs on, and whether the hook should be started again on the published one once it stops.
+static const backend_vtable *running_vtable = NULL;
+static bool restart_pending = false;
+
+// Creating the virtual devices can take a while, so it's serialized by a mutex of its own rather than the back-end one.
+static pthread_mutex_t virtual_devices_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The back-end which the virtual devices were created on, and the name which they were created with, so that they can
+// be created again on another back-end.
+static const backend_vtable *virtual_devices_table = NULL;
+static char *virtual_devices_name = NULL;
 
 static const char const * BACKEND_X11_NAME = "x11";
 static const char const * BACKEND_WAYLAND_NAME = "wayland";
@@ -67,48 +189,30 @@ static void *callback_data = NULL;
 static dispatcher_t dispatch_callback = NULL;
 static void *dispatch_callback_data = NULL;
 
-static set_logger_proc_t set_logger_proc = NULL;
-static set_dispatch_proc_t set_dispatch_proc = NULL;
-
-static run_t run = NULL;
-static run_keyboard_t run_keyboard = NULL;
-static run_mouse_t run_mouse = NULL;
-static stop_t stop = NULL;
-
-static post_event_t post_event = NULL;
-static post_events_t post_events = NULL;
-static post_text_t post_text = NULL;
+static settings_changed_t settings_changed_callback = NULL;
+static void *settings_changed_callback_data = NULL;
 
-static init_virtual_devices_t init_virtual_devices = NULL;
-static destroy_virtual_devices_t destroy_virtual_devices = NULL;
+static device_open_t device_open_callback = NULL;
+static device_close_t device_close_callback = NULL;
+static void *device_callback_data = NULL;
 
-static get_optional_feature_support_t get_optional_feature_support = NULL;
+typedef struct _preload_request {
+    int mode;
+    preload_done_t done_proc;
+    void *user_data;
+} preload_request;
 
-static is_key_typed_enabled_t is_key_typed_enabled = NULL;
-static set_key_typed_enabled_t set_key_typed_enabled = NULL;
+static const backend_vtable *load_backend();
+static void release_retired_backend(const backend_vtable *table);
+static const backend_vtable *open_backend_locked(int backend);
+static void move_virtual_devices(const backend_vtable *next);
+static void hand_over_callbacks_locked(const backend_vtable *table);
+static int get_backend(int mode);
+static const char *get_backend_name(int backend);
 
-static is_ax_api_enabled_t is_ax_api_enabled = NULL;
-static get_prompt_user_if_ax_api_disabled_t get_prompt_user_if_ax_api_disabled = NULL;
-static set_prompt_user_if_ax_api_disabled_t set_prompt_user_if_ax_api_disabled = NULL;
-static get_ax_poll_frequency_t get_ax_poll_frequency = NULL;
-static set_ax_poll_frequency_t set_ax_poll_frequency = NULL;
+_Atomic unsigned int logger_level = LOG_LEVEL_DEBUG;
 
-static get_post_text_delay_linux_t get_post_text_delay_linux = NULL;
-static set_post_text_delay_linux_t set_post_text_delay_linux = NULL;
-
-static set_device_procs_t set_device_procs = NULL;
-
-static create_screen_info_t create_screen_info = NULL;
-static get_auto_repeat_rate_t get_auto_repeat_rate = NULL;
-static get_auto_repeat_delay_t get_auto_repeat_delay = NULL;
-static get_pointer_acceleration_multiplier_t get_pointer_acceleration_multiplier = NULL;
-static get_pointer_acceleration_threshold_t get_pointer_acceleration_threshold = NULL;
-static get_pointer_sensitivity_t get_pointer_sensitivity = NULL;
-static get_multi_click_time_t get_multi_click_time = NULL;
-
-static bool load_backend();
-
-void logger(unsigned int level, const char *format, ...) {
+void log_message(unsigned int level, const char *format, ...) {
     if (callback != NULL) {
         va_list args;
 
@@ -128,47 +232,169 @@ int hook_get_linux_mode() {
     return result;
 }
 
-int hook_set_linux_mode(int mode) {
+static bool is_known_mode(int mode) {
     switch (mode) {
         case LINUX_MODE_AUTO_XRECORD:
         case LINUX_MODE_AUTO_LOW_LEVEL:
         case LINUX_MODE_XRECORD:
         case LINUX_MODE_X11:
         case LINUX_MODE_WAYLAND:
-            break;
+            return true;
 
         default:
             logger(LOG_LEVEL_WARN, "%s [%u]: Ignoring the unknown Linux mode %#X.\n",
                     __FUNCTION__, __LINE__, mode);
 
-            return UIOHOOK_FAILURE;
+            return false;
+    }
+}
+
+int hook_set_linux_mode(int mode) {
+    if (!is_known_mode(mode)) {
+        return UIOHOOK_FAILURE;
     }
 
     pthread_mutex_lock(&backend_mutex);
 
-    if (backend_loaded) {
+    const backend_vtable *previous = atomic_load_explicit(&published_vtable, memory_order_acquire);
+    int selected_backend = get_backend(mode);
+
+    if (previous == NULL || previous->backend == selected_backend) {
+        linux_mode = mode;
+
         pthread_mutex_unlock(&backend_mutex);
+        return UIOHOOK_SUCCESS;
+    }
 
-        logger(LOG_LEVEL_WARN, "%s [%u]: The Linux mode cannot be changed as a back-end is already loaded.\n",
+    // The caller holds the IDs of the device sets and the callbacks of a timed post, which can't follow a switch.
+    if (previous->is_busy()) {
+        pthread_mutex_unlock(&backend_mutex);
+
+        logger(LOG_LEVEL_WARN, "%s [%u]: Cannot switch while virtual device sets or a timed post are active.\n",
                 __FUNCTION__, __LINE__);
 
+        return UIOHOOK_FAILURE;
+    }
+
+    const backend_vtable *next = open_backend_locked(selected_backend);
+    if (next == NULL) {
+        pthread_mutex_unlock(&backend_mutex);
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
+    logger(LOG_LEVEL_INFO, "%s [%u]: Switching from the %s back-end to the %s back-end.\n",
+            __FUNCTION__, __LINE__, get_backend_name(previous->backend), get_backend_name(selected_backend));
+
+    hand_over_callbacks_locked(next);
+
+    next->set_key_typed_enabled(previous->is_key_typed_enabled());
+    next->set_post_text_delay_linux(previous->get_post_text_delay_linux());
+
+    // The previous back-end may still watch the settings until it's released, but they no longer describe the session.
+    previous->set_settings_changed_proc(NULL, NULL);
+
     linux_mode = mode;
+    atomic_store_explicit(&published_vtable, next, memory_order_release);
+
+    get_slot(previous)->state = BACKEND_RETIRED;
+
+    // The thread which runs the hook starts it on the new back-end once the previous one returns.
+    const backend_vtable *running = running_vtable;
+    restart_pending = running != NULL;
 
     pthread_mutex_unlock(&backend_mutex);
+
+    move_virtual_devices(next);
+
+    if (running != NULL) {
+        // The thread which runs the hook releases the previous back-end once its hook has returned.
+        int status = running->stop();
+        if (status != UIOHOOK_SUCCESS) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Failed to stop the hook on the previous back-end: %#X.\n",
+                    __FUNCTION__, __LINE__, status);
+        }
+    } else {
+        release_retired_backend(previous);
+    }
+
     return UIOHOOK_SUCCESS;
 }
 
 int hook_get_loaded_linux_backend() {
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
+
+    return current != NULL ? current->backend : LINUX_LOADED_BACKEND_NONE;
+}
+
+static void *preload_thread_proc(void *arg) {
+    preload_request *request = arg;
+
+    const backend_vtable *current = load_backend();
+    if (current != NULL) {
+        current->preload(request->mode, request->done_proc, request->user_data);
+    } else if (request->done_proc != NULL) {
+        request->done_proc(UIOHOOK_ERROR_LINUX_LOAD_BACKEND, request->user_data);
+    }
+
+    free(request);
+
+    return NULL;
+}
+
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    if (!is_known_mode(mode)) {
+        return UIOHOOK_FAILURE;
+    }
+
     pthread_mutex_lock(&backend_mutex);
 
-    int result = loaded_backend;
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
+    if (current != NULL && current->backend != get_backend(mode)) {
+        pthread_mutex_unlock(&backend_mutex);
+
+        logger(LOG_LEVEL_WARN, "%s [%u]: Cannot preload a back-end as a different one is already loaded.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+    }
+
+    linux_mode = mode;
 
     pthread_mutex_unlock(&backend_mutex);
 
-    return result;
+    preload_request *request = malloc(sizeof(preload_request));
+    if (request == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the preload request!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    *request = (preload_request) {
+        .mode = mode,
+        .done_proc = done_proc,
+        .user_data = user_data
+    };
+
+    // Nothing waits for the thread, so it cleans up after itself.
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    pthread_t preload_thread;
+    int result = pthread_create(&preload_thread, &attributes, preload_thread_proc, request);
+
+    pthread_attr_destroy(&attributes);
+
+    if (result != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the preload thread: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(result));
+
+        free(request);
+        return UIOHOOK_FAILURE;
+    }
+
+    return UIOHOOK_SUCCESS;
 }
 
 void hook_set_logger_proc(logger_t logger_proc, void *user_data) {
@@ -177,12 +403,30 @@ void hook_set_logger_proc(logger_t logger_proc, void *user_data) {
     callback = logger_proc;
     callback_data = user_data;
 
-    bool loaded = backend_loaded;
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
+
+    pthread_mutex_unlock(&backend_mutex);
+
+    if (current != NULL) {
+        current->set_logger_proc(logger_proc, user_data);
+    }
+}
+
+unsigned int hook_get_log_level() {
+    return get_logger_level();
+}
+
+void hook_set_log_level(unsigned int level) {
+    pthread_mutex_lock(&backend_mutex);
+
+    atomic_store_explicit(&logger_level, level, memory_order_relaxed);
+
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
 
     pthread_mutex_unlock(&backend_mutex);
 
-    if (loaded) {
-        set_logger_proc(logger_proc, user_data);
+    if (current != NULL) {
+        current->set_log_level(level);
     }
 }
 
@@ -192,229 +436,515 @@ void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data) {
     dispatch_callback = dispatch_proc;
     dispatch_callback_data = user_data;
 
-    bool loaded = backend_loaded;
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
 
     pthread_mutex_unlock(&backend_mutex);
 
-    if (loaded) {
-        set_dispatch_proc(dispatch_proc, user_data);
+    if (current != NULL) {
+        current->set_dispatch_proc(dispatch_proc, user_data);
+    }
+}
+
+void hook_set_settings_changed_proc(settings_changed_t settings_changed_proc, void *user_data) {
+    pthread_mutex_lock(&backend_mutex);
+
+    settings_changed_callback = settings_changed_proc;
+    settings_changed_callback_data = user_data;
+
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
+
+    pthread_mutex_unlock(&backend_mutex);
+
+    if (current != NULL) {
+        current->set_settings_changed_proc(settings_changed_proc, user_data);
+    }
+}
+
+static int run_backend(const backend_vtable *table, hook_kind kind) {
+    switch (kind) {
+        case HOOK_KEYBOARD:
+            return table->run_keyboard();
+
+        case HOOK_MOUSE:
+            return table->run_mouse();
+
+        case HOOK_ALL:
+        default:
+            return table->run();
+    }
+}
+
+static int run_hook(hook_kind kind) {
+    bool restarting = false;
+    int status = UIOHOOK_SUCCESS;
+
+    while (true) {
+        const backend_vtable *current = load_backend();
+        if (current == NULL) {
+            return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+        }
+
+        pthread_mutex_lock(&backend_mutex);
+
+        // The hook may have been stopped while it was moving over to the new back-end.
+        if (restarting && !restart_pending) {
+            pthread_mutex_unlock(&backend_mutex);
+            return status;
+        }
+
+        // The back-end is checked under the mutex, so that a switch either happens before the hook is started on it or
+        // sees that the hook is running and stops it.
+        if (current != atomic_load_explicit(&published_vtable, memory_order_acquire)) {
+            pthread_mutex_unlock(&backend_mutex);
+            continue;
+        }
+
+        running_vtable = current;
+        restart_pending = false;
+
+        pthread_mutex_unlock(&backend_mutex);
+
+        status = run_backend(current, kind);
+
+        pthread_mutex_lock(&backend_mutex);
+
+        running_vtable = NULL;
+        restarting = restart_pending;
+        bool retired = current != atomic_load_explicit(&published_vtable, memory_order_acquire);
+
+        pthread_mutex_unlock(&backend_mutex);
+
+        // The switch left the back-end which the hook ran on to this thread, as it's only released once it stopped.
+        if (retired) {
+            release_retired_backend(current);
+        }
+
+        if (!restarting) {
+            return status;
+        }
+
+        logger(LOG_LEVEL_INFO, "%s [%u]: Restarting the hook on the %s back-end.\n",
+                __FUNCTION__, __LINE__, get_backend_name(hook_get_loaded_linux_backend()));
     }
 }
 
 int hook_run() {
-    if (!load_backend()) {
+    return run_hook(HOOK_ALL);
+}
+
+int hook_run_keyboard() {
+    return run_hook(HOOK_KEYBOARD);
+}
+
+int hook_run_mouse() {
+    return run_hook(HOOK_MOUSE);
+}
+
+int hook_stop() {
+    pthread_mutex_lock(&backend_mutex);
+
+    const backend_vtable *running = running_vtable;
+    bool restarting = restart_pending && running == NULL;
+    restart_pending = false;
+
+    pthread_mutex_unlock(&backend_mutex);
+
+    // Nothing runs between two back-ends, so it's enough that the hook isn't started again.
+    if (restarting) {
+        return UIOHOOK_SUCCESS;
+    }
+
+    const backend_vtable *current = running != NULL ? running : load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return run();
+    return current->stop();
 }
 
-int hook_run_keyboard() {
-    if (!load_backend()) {
+int hook_post_event(uiohook_event * const event) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return run_keyboard();
+    return current->post_event(event);
 }
 
-int hook_run_mouse() {
-    if (!load_backend()) {
+int hook_post_events(uiohook_event * const events, uint32_t size) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return run_mouse();
+    return current->post_events(events, size);
 }
 
-int hook_stop() {
-    if (!load_backend()) {
+int hook_post_events_counted(uiohook_event * const events, uint32_t size, uint32_t *posted) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        if (posted != NULL) {
+            *posted = 0;
+        }
+
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return stop();
+    return current->post_events_counted(events, size, posted);
 }
 
-int hook_post_event(uiohook_event * const event) {
-    if (!load_backend()) {
+int hook_post_text(const uint16_t * const text) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return post_event(event);
+    return current->post_text(text);
 }
 
-int hook_post_events(uiohook_event * const events, uint32_t size) {
-    if (!load_backend()) {
+int hook_post_events_timed(uiohook_event * const events, uint32_t size, post_progress_t progress_proc,
+        void *user_data) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return post_events(events, size);
+    return current->post_events_timed(events, size, progress_proc, user_data);
 }
 
-int hook_post_text(const uint16_t * const text) {
-    if (!load_backend()) {
+int hook_cancel_post_events_timed() {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+    }
+
+    return current->cancel_post_events_timed();
+}
+
+int hook_post_relative_motion(const relative_motion_data * const motions, uint32_t size) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+    }
+
+    return current->post_relative_motion(motions, size);
+}
+
+int hook_post_pointer_path(const pointer_waypoint * const waypoints, uint32_t count,
+        const pointer_path_options * const options, post_progress_t progress_proc, void *user_data) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return post_text(text);
+    return current->post_pointer_path(waypoints, count, options, progress_proc, user_data);
+}
+
+// Moves the virtual devices over to the back-end which was switched to, if they were created on another one.
+static void move_virtual_devices(const backend_vtable *next) {
+    pthread_mutex_lock(&virtual_devices_mutex);
+
+    const backend_vtable *previous = virtual_devices_table;
+    if (previous != NULL && previous != next) {
+        previous->destroy_virtual_devices();
+        virtual_devices_table = NULL;
+
+        int status = next->init_virtual_devices(virtual_devices_name);
+        if (status == UIOHOOK_SUCCESS) {
+            virtual_devices_table = next;
+        } else {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Failed to create the virtual devices on the %s back-end: %#X.\n",
+                    __FUNCTION__, __LINE__, get_backend_name(next->backend), status);
+
+            free(virtual_devices_name);
+            virtual_devices_name = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&virtual_devices_mutex);
 }
 
 int hook_init_virtual_devices(const char * const application_name) {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return init_virtual_devices(application_name);
+    pthread_mutex_lock(&virtual_devices_mutex);
+
+    int status = current->init_virtual_devices(application_name);
+    if (status == UIOHOOK_SUCCESS) {
+        char *name = strdup(application_name != NULL ? application_name : "");
+        if (name == NULL) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Failed to allocate memory for the application name, so the virtual "
+                    "devices won't be created again when the back-end is switched.\n",
+                    __FUNCTION__, __LINE__);
+        }
+
+        free(virtual_devices_name);
+        virtual_devices_name = name;
+
+        // The devices which are still on a back-end which was switched away from are replaced by the new ones.
+        if (virtual_devices_table != NULL && virtual_devices_table != current) {
+            virtual_devices_table->destroy_virtual_devices();
+            virtual_devices_table = NULL;
+        }
+
+        if (virtual_devices_table == NULL && name != NULL) {
+            virtual_devices_table = current;
+        }
+    }
+
+    pthread_mutex_unlock(&virtual_devices_mutex);
+
+    return status;
 }
 
 int hook_destroy_virtual_devices() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+    }
+
+    pthread_mutex_lock(&virtual_devices_mutex);
+
+    // The devices are destroyed where they were created, even if a switch hasn't moved them over yet.
+    const backend_vtable *table = virtual_devices_table != NULL ? virtual_devices_table : current;
+
+    int status = table->destroy_virtual_devices();
+    if (status == UIOHOOK_SUCCESS) {
+        free(virtual_devices_name);
+        virtual_devices_name = NULL;
+
+        virtual_devices_table = NULL;
+    }
+
+    pthread_mutex_unlock(&virtual_devices_mutex);
+
+    return status;
+}
+
+int hook_create_virtual_device_set(const char * const application_name, uint8_t *set_id) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+    }
+
+    return current->create_virtual_device_set(application_name, set_id);
+}
+
+int hook_destroy_virtual_device_set(uint8_t set_id) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+    }
+
+    return current->destroy_virtual_device_set(set_id);
+}
+
+int hook_post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
     }
 
-    return destroy_virtual_devices();
+    return current->post_events_on(set_id, events, size);
 }
 
 uint32_t hook_get_optional_feature_support() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return 0;
     }
 
-    return get_optional_feature_support();
+    return current->get_optional_feature_support();
 }
 
 bool hook_is_key_typed_enabled() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return false;
     }
 
-    return is_key_typed_enabled();
+    return current->is_key_typed_enabled();
 }
 
 void hook_set_key_typed_enabled(bool enabled) {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return;
     }
 
-    set_key_typed_enabled(enabled);
+    current->set_key_typed_enabled(enabled);
 }
 
 bool hook_is_ax_api_enabled(bool promptUserIfDisabled) {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return false;
     }
 
-    return is_ax_api_enabled(promptUserIfDisabled);
+    return current->is_ax_api_enabled(promptUserIfDisabled);
 }
 
 bool hook_get_prompt_user_if_ax_api_disabled() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return false;
     }
 
-    return get_prompt_user_if_ax_api_disabled();
+    return current->get_prompt_user_if_ax_api_disabled();
 }
 
 void hook_set_prompt_user_if_ax_api_disabled(bool promptUserIfDisabled) {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return;
     }
 
-    set_prompt_user_if_ax_api_disabled(promptUserIfDisabled);
+    current->set_prompt_user_if_ax_api_disabled(promptUserIfDisabled);
 }
 
 uint32_t hook_get_ax_poll_frequency() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return 0;
     }
 
-    return get_ax_poll_frequency();
+    return current->get_ax_poll_frequency();
 }
 
 void hook_set_ax_poll_frequency(uint32_t frequency) {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return;
     }
 
-    set_ax_poll_frequency(frequency);
+    current->set_ax_poll_frequency(frequency);
 }
 
 uint64_t hook_get_post_text_delay_linux() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return 0;
     }
 
-    return get_post_text_delay_linux();
+    return current->get_post_text_delay_linux();
 }
 
 void hook_set_post_text_delay_linux(uint64_t delay) {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return;
     }
 
-    set_post_text_delay_linux(delay);
+    current->set_post_text_delay_linux(delay);
 }
 
 void hook_set_device_procs(device_open_t open_proc, device_close_t close_proc, void *user_data) {
-    if (!load_backend()) {
-        return;
-    }
+    pthread_mutex_lock(&backend_mutex);
+
+    device_open_callback = open_proc;
+    device_close_callback = close_proc;
+    device_callback_data = user_data;
+
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
+
+    pthread_mutex_unlock(&backend_mutex);
 
-    set_device_procs(open_proc, close_proc, user_data);
+    if (current != NULL) {
+        current->set_device_procs(open_proc, close_proc, user_data);
+    }
 }
 
 screen_data* hook_create_screen_info(unsigned char *count) {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return NULL;
     }
 
-    return create_screen_info(count);
+    return current->create_screen_info(count);
+}
+
+uint8_t hook_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *layout_version) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return 0;
+    }
+
+    return current->get_screen_info(buf, capacity, layout_version);
 }
 
 long int hook_get_auto_repeat_rate() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return -1;
     }
 
-    return get_auto_repeat_rate();
+    return current->get_auto_repeat_rate();
 }
 
 long int hook_get_auto_repeat_delay() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return -1;
     }
 
-    return get_auto_repeat_delay();
+    return current->get_auto_repeat_delay();
 }
 
 long int hook_get_pointer_acceleration_multiplier() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return -1;
     }
 
-    return get_pointer_acceleration_multiplier();
+    return current->get_pointer_acceleration_multiplier();
 }
 
 long int hook_get_pointer_acceleration_threshold() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return -1;
     }
 
-    return get_pointer_acceleration_threshold();
+    return current->get_pointer_acceleration_threshold();
 }
 
 long int hook_get_pointer_sensitivity() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return -1;
     }
 
-    return get_pointer_sensitivity();
+    return current->get_pointer_sensitivity();
 }
 
 long int hook_get_multi_click_time() {
-    if (!load_backend()) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
         return -1;
     }
 
-    return get_multi_click_time();
+    return current->get_multi_click_time();
+}
+
+int hook_get_stats(hook_stats *stats) {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return UIOHOOK_ERROR_LINUX_LOAD_BACKEND;
+    }
+
+    return current->get_stats(stats);
+}
+
+void hook_reset_stats() {
+    const backend_vtable *current = load_backend();
+    if (current == NULL) {
+        return;
+    }
+
+    current->reset_stats();
 }
 
 static bool is_wayland_session() {
@@ -462,180 +992,263 @@ static const char *get_backend_name(int backend) {
     }
 }
 
-static bool load_backend_symbols(void *handle) {
-    set_logger_proc = (set_logger_proc_t) dlsym(handle, "hook_set_logger_proc");
-    if (set_logger_proc == NULL) {
+static bool load_backend_symbols(void *handle, backend_vtable *table) {
+    table->set_logger_proc = (set_logger_proc_t) dlsym(handle, "hook_set_logger_proc");
+    if (table->set_logger_proc == NULL) {
+        return false;
+    }
+
+    table->set_log_level = (set_log_level_t) dlsym(handle, "hook_set_log_level");
+    if (table->set_log_level == NULL) {
+        return false;
+    }
+
+    table->set_dispatch_proc = (set_dispatch_proc_t) dlsym(handle, "hook_set_dispatch_proc");
+    if (table->set_dispatch_proc == NULL) {
+        return false;
+    }
+
+    table->set_settings_changed_proc = (set_settings_changed_proc_t) dlsym(handle, "hook_set_settings_changed_proc");
+    if (table->set_settings_changed_proc == NULL) {
+        return false;
+    }
+
+    table->run = (run_t) dlsym(handle, "hook_run");
+    if (table->run == NULL) {
+        return false;
+    }
+
+    table->run_keyboard = (run_keyboard_t) dlsym(handle, "hook_run_keyboard");
+    if (table->run_keyboard == NULL) {
+        return false;
+    }
+
+    table->run_mouse = (run_mouse_t) dlsym(handle, "hook_run_mouse");
+    if (table->run_mouse == NULL) {
+        return false;
+    }
+
+    table->stop = (stop_t) dlsym(handle, "hook_stop");
+    if (table->stop == NULL) {
+        return false;
+    }
+
+    table->post_event = (post_event_t) dlsym(handle, "hook_post_event");
+    if (table->post_event == NULL) {
+        return false;
+    }
+
+    table->post_events = (post_events_t) dlsym(handle, "hook_post_events");
+    if (table->post_events == NULL) {
+        return false;
+    }
+
+    table->post_events_counted = (post_events_counted_t) dlsym(handle, "hook_post_events_counted");
+    if (table->post_events_counted == NULL) {
+        return false;
+    }
+
+    table->post_text = (post_text_t) dlsym(handle, "hook_post_text");
+    if (table->post_text == NULL) {
         return false;
     }
 
-    set_dispatch_proc = (set_dispatch_proc_t) dlsym(handle, "hook_set_dispatch_proc");
-    if (set_dispatch_proc == NULL) {
+    table->post_events_timed = (post_events_timed_t) dlsym(handle, "hook_post_events_timed");
+    if (table->post_events_timed == NULL) {
         return false;
     }
 
-    run = (run_t) dlsym(handle, "hook_run");
-    if (run == NULL) {
+    table->cancel_post_events_timed = (cancel_post_events_timed_t) dlsym(handle, "hook_cancel_post_events_timed");
+    if (table->cancel_post_events_timed == NULL) {
         return false;
     }
 
-    run_keyboard = (run_keyboard_t) dlsym(handle, "hook_run_keyboard");
-    if (run_keyboard == NULL) {
+    table->post_relative_motion = (post_relative_motion_t) dlsym(handle, "hook_post_relative_motion");
+    if (table->post_relative_motion == NULL) {
         return false;
     }
 
-    run_mouse = (run_mouse_t) dlsym(handle, "hook_run_mouse");
-    if (run_mouse == NULL) {
+    table->post_pointer_path = (post_pointer_path_t) dlsym(handle, "hook_post_pointer_path");
+    if (table->post_pointer_path == NULL) {
         return false;
     }
 
-    stop = (stop_t) dlsym(handle, "hook_stop");
-    if (stop == NULL) {
+    table->init_virtual_devices = (init_virtual_devices_t) dlsym(handle, "hook_init_virtual_devices");
+    if (table->init_virtual_devices == NULL) {
         return false;
     }
 
-    post_event = (post_event_t) dlsym(handle, "hook_post_event");
-    if (post_event == NULL) {
+    table->destroy_virtual_devices = (destroy_virtual_devices_t) dlsym(handle, "hook_destroy_virtual_devices");
+    if (table->destroy_virtual_devices == NULL) {
         return false;
     }
 
-    post_events = (post_events_t) dlsym(handle, "hook_post_events");
-    if (post_events == NULL) {
+    table->create_virtual_device_set = (create_virtual_device_set_t) dlsym(handle, "hook_create_virtual_device_set");
+    if (table->create_virtual_device_set == NULL) {
         return false;
     }
 
-    post_text = (post_text_t) dlsym(handle, "hook_post_text");
-    if (post_text == NULL) {
+    table->destroy_virtual_device_set = (destroy_virtual_device_set_t) dlsym(handle, "hook_destroy_virtual_device_set");
+    if (table->destroy_virtual_device_set == NULL) {
         return false;
     }
 
-    init_virtual_devices = (init_virtual_devices_t) dlsym(handle, "hook_init_virtual_devices");
-    if (init_virtual_devices == NULL) {
+    table->post_events_on = (post_events_on_t) dlsym(handle, "hook_post_events_on");
+    if (table->post_events_on == NULL) {
         return false;
     }
 
-    destroy_virtual_devices = (destroy_virtual_devices_t) dlsym(handle, "hook_destroy_virtual_devices");
-    if (destroy_virtual_devices == NULL) {
+    table->get_optional_feature_support = (get_optional_feature_support_t) dlsym(handle, "hook_get_optional_feature_support");
+    if (table->get_optional_feature_support == NULL) {
         return false;
     }
 
-    get_optional_feature_support = (get_optional_feature_support_t) dlsym(handle, "hook_get_optional_feature_support");
-    if (get_optional_feature_support == NULL) {
+    table->is_key_typed_enabled = (is_key_typed_enabled_t) dlsym(handle, "hook_is_key_typed_enabled");
+    if (table->is_key_typed_enabled == NULL) {
         return false;
     }
 
-    is_key_typed_enabled = (is_key_typed_enabled_t) dlsym(handle, "hook_is_key_typed_enabled");
-    if (is_key_typed_enabled == NULL) {
+    table->set_key_typed_enabled = (set_key_typed_enabled_t) dlsym(handle, "hook_set_key_typed_enabled");
+    if (table->set_key_typed_enabled == NULL) {
         return false;
     }
 
-    set_key_typed_enabled = (set_key_typed_enabled_t) dlsym(handle, "hook_set_key_typed_enabled");
-    if (set_key_typed_enabled == NULL) {
+    table->is_ax_api_enabled = (is_ax_api_enabled_t) dlsym(handle, "hook_is_ax_api_enabled");
+    if (table->is_ax_api_enabled == NULL) {
         return false;
     }
 
-    is_ax_api_enabled = (is_ax_api_enabled_t) dlsym(handle, "hook_is_ax_api_enabled");
-    if (is_ax_api_enabled == NULL) {
+    table->get_prompt_user_if_ax_api_disabled = (get_prompt_user_if_ax_api_disabled_t) dlsym(handle, "hook_get_prompt_user_if_ax_api_disabled");
+    if (table->get_prompt_user_if_ax_api_disabled == NULL) {
         return false;
     }
 
-    get_prompt_user_if_ax_api_disabled = (get_prompt_user_if_ax_api_disabled_t) dlsym(handle, "hook_get_prompt_user_if_ax_api_disabled");
-    if (get_prompt_user_if_ax_api_disabled == NULL) {
+    table->set_prompt_user_if_ax_api_disabled = (set_prompt_user_if_ax_api_disabled_t) dlsym(handle, "hook_set_prompt_user_if_ax_api_disabled");
+    if (table->set_prompt_user_if_ax_api_disabled == NULL) {
         return false;
     }
 
-    set_prompt_user_if_ax_api_disabled = (set_prompt_user_if_ax_api_disabled_t) dlsym(handle, "hook_set_prompt_user_if_ax_api_disabled");
-    if (set_prompt_user_if_ax_api_disabled == NULL) {
+    table->get_ax_poll_frequency = (get_ax_poll_frequency_t) dlsym(handle, "hook_get_ax_poll_frequency");
+    if (table->get_ax_poll_frequency == NULL) {
         return false;
     }
 
-    get_ax_poll_frequency = (get_ax_poll_frequency_t) dlsym(handle, "hook_get_ax_poll_frequency");
-    if (get_ax_poll_frequency == NULL) {
+    table->set_ax_poll_frequency = (set_ax_poll_frequency_t) dlsym(handle, "hook_set_ax_poll_frequency");
+    if (table->set_ax_poll_frequency == NULL) {
         return false;
     }
 
-    set_ax_poll_frequency = (set_ax_poll_frequency_t) dlsym(handle, "hook_set_ax_poll_frequency");
-    if (set_ax_poll_frequency == NULL) {
+    table->get_post_text_delay_linux = (get_post_text_delay_linux_t) dlsym(handle, "hook_get_post_text_delay_linux");
+    if (table->get_post_text_delay_linux == NULL) {
         return false;
     }
 
-    get_post_text_delay_linux = (get_post_text_delay_linux_t) dlsym(handle, "hook_get_post_text_delay_linux");
-    if (get_post_text_delay_linux == NULL) {
+    table->set_post_text_delay_linux = (set_post_text_delay_linux_t) dlsym(handle, "hook_set_post_text_delay_linux");
+    if (table->set_post_text_delay_linux == NULL) {
         return false;
     }
 
-    set_post_text_delay_linux = (set_post_text_delay_linux_t) dlsym(handle, "hook_set_post_text_delay_linux");
-    if (set_post_text_delay_linux == NULL) {
+    table->set_device_procs = (set_device_procs_t) dlsym(handle, "hook_set_device_procs");
+    if (table->set_device_procs == NULL) {
         return false;
     }
 
-    set_device_procs = (set_device_procs_t) dlsym(handle, "hook_set_device_procs");
-    if (set_device_procs == NULL) {
+    table->preload = (preload_t) dlsym(handle, "hook_preload");
+    if (table->preload == NULL) {
         return false;
     }
 
-    create_screen_info = (create_screen_info_t) dlsym(handle, "hook_create_screen_info");
-    if (create_screen_info == NULL) {
+    table->is_busy = (is_busy_t) dlsym(handle, "backend_is_busy");
+    if (table->is_busy == NULL) {
         return false;
     }
 
-    get_auto_repeat_rate = (get_auto_repeat_rate_t) dlsym(handle, "hook_get_auto_repeat_rate");
-    if (get_auto_repeat_rate == NULL) {
+    table->release = (release_t) dlsym(handle, "backend_release");
+    if (table->release == NULL) {
         return false;
     }
 
-    get_auto_repeat_delay = (get_auto_repeat_delay_t) dlsym(handle, "hook_get_auto_repeat_delay");
-    if (get_auto_repeat_delay == NULL) {
+    table->create_screen_info = (create_screen_info_t) dlsym(handle, "hook_create_screen_info");
+    if (table->create_screen_info == NULL) {
         return false;
     }
 
-    get_pointer_acceleration_multiplier = (get_pointer_acceleration_multiplier_t) dlsym(handle, "hook_get_pointer_acceleration_multiplier");
-    if (get_pointer_acceleration_multiplier == NULL) {
+    table->get_screen_info = (get_screen_info_t) dlsym(handle, "hook_get_screen_info");
+    if (table->get_screen_info == NULL) {
         return false;
     }
 
-    get_pointer_acceleration_threshold = (get_pointer_acceleration_threshold_t) dlsym(handle, "hook_get_pointer_acceleration_threshold");
-    if (get_pointer_acceleration_threshold == NULL) {
+    table->get_auto_repeat_rate = (get_auto_repeat_rate_t) dlsym(handle, "hook_get_auto_repeat_rate");
+    if (table->get_auto_repeat_rate == NULL) {
         return false;
     }
 
-    get_pointer_sensitivity = (get_pointer_sensitivity_t) dlsym(handle, "hook_get_pointer_sensitivity");
-    if (get_pointer_sensitivity == NULL) {
+    table->get_auto_repeat_delay = (get_auto_repeat_delay_t) dlsym(handle, "hook_get_auto_repeat_delay");
+    if (table->get_auto_repeat_delay == NULL) {
         return false;
     }
 
-    get_multi_click_time = (get_multi_click_time_t) dlsym(handle, "hook_get_multi_click_time");
-    if (get_multi_click_time == NULL) {
+    table->get_pointer_acceleration_multiplier = (get_pointer_acceleration_multiplier_t) dlsym(handle, "hook_get_pointer_acceleration_multiplier");
+    if (table->get_pointer_acceleration_multiplier == NULL) {
+        return false;
+    }
+
+    table->get_pointer_acceleration_threshold = (get_pointer_acceleration_threshold_t) dlsym(handle, "hook_get_pointer_acceleration_threshold");
+    if (table->get_pointer_acceleration_threshold == NULL) {
+        return false;
+    }
+
+    table->get_pointer_sensitivity = (get_pointer_sensitivity_t) dlsym(handle, "hook_get_pointer_sensitivity");
+    if (table->get_pointer_sensitivity == NULL) {
+        return false;
+    }
+
+    table->get_multi_click_time = (get_multi_click_time_t) dlsym(handle, "hook_get_multi_click_time");
+    if (table->get_multi_click_time == NULL) {
+        return false;
+    }
+
+    table->get_stats = (get_stats_t) dlsym(handle, "hook_get_stats");
+    if (table->get_stats == NULL) {
+        return false;
+    }
+
+    table->reset_stats = (reset_stats_t) dlsym(handle, "hook_reset_stats");
+    if (table->reset_stats == NULL) {
         return false;
     }
 
     return true;
 }
 
-static bool load_backend() {
-    if (backend_loaded) {
-        return true;
-    }
+// Opens the back-end and fills in its table, or returns the table if it's still loaded. Called under the mutex.
+static const backend_vtable *open_backend_locked(int backend) {
+    backend_slot *slot = &backend_slots[backend - 1];
 
-    pthread_mutex_lock(&backend_mutex);
+    // A back-end which is being released can only be used again once its threads are gone.
+    while (slot->state == BACKEND_RELEASING) {
+        pthread_cond_wait(&backend_released_cond, &backend_mutex);
+    }
 
-    if (backend_loaded) {
-        pthread_mutex_unlock(&backend_mutex);
-        return true;
+    // A back-end which was loaded before is simply used again, and opens whatever it released when it's called.
+    if (slot->state != BACKEND_CLOSED) {
+        slot->state = BACKEND_OPEN;
+        return &slot->table;
     }
 
-    int selected_backend = get_backend(linux_mode);
-    const char *selected_backend_name = get_backend_name(selected_backend);
+    backend_vtable *table = &slot->table;
+
+    const char *backend_name = get_backend_name(backend);
 
     logger(LOG_LEVEL_DEBUG, "%s [%u]: Using the %s back-end.\n",
-            __FUNCTION__, __LINE__, selected_backend_name);
+            __FUNCTION__, __LINE__, backend_name);
 
     Dl_info info;
-    if (dladdr((void *) load_backend, &info) == 0) {
+    if (dladdr((void *) open_backend_locked, &info) == 0) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to get the path of the current shared object: %s!\n",
                 __FUNCTION__, __LINE__, dlerror());
 
-        pthread_mutex_unlock(&backend_mutex);
-        return false;
+        return NULL;
     }
 
     char dir[PATH_MAX];
@@ -645,38 +1258,129 @@ static bool load_backend() {
     char *backend_directory = dirname(dir);
 
     char backend_path[PATH_MAX];
-    snprintf(backend_path, sizeof(backend_path), "%s/libuiohook-%s.so", backend_directory, selected_backend_name);
+    snprintf(backend_path, sizeof(backend_path), "%s/libuiohook-%s.so", backend_directory, backend_name);
 
-    void *backend_handle = dlopen(backend_path, RTLD_LAZY | RTLD_LOCAL | RTLD_NODELETE);
+    void *backend_handle = dlopen(backend_path, RTLD_LAZY | RTLD_LOCAL);
     if (backend_handle == NULL) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to open backend '%s': %s!\n",
-                __FUNCTION__, __LINE__, selected_backend_name, dlerror());
+                __FUNCTION__, __LINE__, backend_name, dlerror());
 
-        pthread_mutex_unlock(&backend_mutex);
-        return false;
+        return NULL;
     }
 
-    if (!load_backend_symbols(backend_handle)) {
+    if (!load_backend_symbols(backend_handle, table)) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to load symbols from backend '%s': %s!\n",
-                __FUNCTION__, __LINE__, selected_backend_name, dlerror());
+                __FUNCTION__, __LINE__, backend_name, dlerror());
 
-        pthread_mutex_unlock(&backend_mutex);
-        return false;
+        dlclose(backend_handle);
+        *table = (backend_vtable) { .backend = LINUX_LOADED_BACKEND_NONE };
+
+        return NULL;
     }
 
-    // Hand over the callbacks which were set before the back-end existed.
+    table->backend = backend;
+
+    slot->handle = backend_handle;
+    slot->state = BACKEND_OPEN;
+
+    return table;
+}
+
+// Hands over the callbacks which were set before the back-end was published. Called under the mutex.
+static void hand_over_callbacks_locked(const backend_vtable *table) {
     if (callback != NULL) {
-        set_logger_proc(callback, callback_data);
+        table->set_logger_proc(callback, callback_data);
     }
 
+    table->set_log_level(get_logger_level());
+
     if (dispatch_callback != NULL) {
-        set_dispatch_proc(dispatch_callback, dispatch_callback_data);
+        table->set_dispatch_proc(dispatch_callback, dispatch_callback_data);
     }
 
-    backend_loaded = true;
-    loaded_backend = selected_backend;
+    if (settings_changed_callback != NULL) {
+        table->set_settings_changed_proc(settings_changed_callback, settings_changed_callback_data);
+    }
+
+    if (device_open_callback != NULL || device_close_callback != NULL) {
+        table->set_device_procs(device_open_callback, device_close_callback, device_callback_data);
+    }
+}
+
+// Loads the back-end under the mutex, so that callers which race for the first call load it only once.
+static const backend_vtable *load_backend_locked() {
+    pthread_mutex_lock(&backend_mutex);
+
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
+    if (current != NULL) {
+        pthread_mutex_unlock(&backend_mutex);
+        return current;
+    }
+
+    current = open_backend_locked(get_backend(linux_mode));
+    if (current == NULL) {
+        pthread_mutex_unlock(&backend_mutex);
+        return NULL;
+    }
+
+    hand_over_callbacks_locked(current);
+
+    // The table is filled in before it's published, so it's complete for whoever loads the pointer to it.
+    atomic_store_explicit(&published_vtable, current, memory_order_release);
 
     pthread_mutex_unlock(&backend_mutex);
 
-    return true;
+    return current;
+}
+
+// Releases the threads, connections and virtual devices of a back-end which was switched away from. The back-end stays
+// loaded, as calls which raced the switch may still be running on it. Never called on one of the back-end's threads.
+static void release_retired_backend(const backend_vtable *table) {
+    backend_slot *slot = get_slot(table);
+
+    pthread_mutex_lock(&backend_mutex);
+
+    // The back-end may have been switched back to, or still run the hook, which releases it once it returns.
+    if (slot->state != BACKEND_RETIRED || running_vtable == table) {
+        pthread_mutex_unlock(&backend_mutex);
+        return;
+    }
+
+    // A device set or a timed post may have been started by a call which raced the switch, and is left to the caller.
+    if (table->is_busy()) {
+        pthread_mutex_unlock(&backend_mutex);
+
+        logger(LOG_LEVEL_WARN, "%s [%u]: Keeping the %s back-end open for its device sets or timed post.\n",
+                __FUNCTION__, __LINE__, get_backend_name(table->backend));
+
+        return;
+    }
+
+    slot->state = BACKEND_RELEASING;
+
+    pthread_mutex_unlock(&backend_mutex);
+
+    // The back-end waits for its threads, which may call back into the loader, so the mutex is free.
+    table->release();
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Released the %s back-end.\n",
+            __FUNCTION__, __LINE__, get_backend_name(table->backend));
+
+    pthread_mutex_lock(&backend_mutex);
+
+    slot->state = BACKEND_RELEASED;
+    pthread_cond_broadcast(&backend_released_cond);
+
+    pthread_mutex_unlock(&backend_mutex);
+}
+
+// Gets the published back-end, and loads it if there's none. Back-ends are never unloaded, so the table can be called
+// without holding anything.
+static const backend_vtable *load_backend() {
+    const backend_vtable *current = atomic_load_explicit(&published_vtable, memory_order_acquire);
+    if (current == NULL) {
+        current = load_backend_locked();
+    }
+
+    return current;
 }
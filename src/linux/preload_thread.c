@@ -0,0 +1,69 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <logger.h>
+#include <uiohook.h>
+
+#include "preload_thread.h"
+
+typedef struct _preload_request {
+    preload_proc_t preload_proc;
+    preload_done_t done_proc;
+    void *user_data;
+} preload_request;
+
+static void *preload_thread_proc(void *arg) {
+    preload_request *request = arg;
+
+    int status = request->preload_proc();
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Preloaded the back-end. (%#X)\n",
+            __FUNCTION__, __LINE__, status);
+
+    if (request->done_proc != NULL) {
+        request->done_proc(status, request->user_data);
+    }
+
+    free(request);
+
+    return NULL;
+}
+
+int start_preload_thread(preload_proc_t preload_proc, preload_done_t done_proc, void *user_data) {
+    preload_request *request = malloc(sizeof(preload_request));
+    if (request == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the preload request!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    *request = (preload_request) {
+        .preload_proc = preload_proc,
+        .done_proc = done_proc,
+        .user_data = user_data
+    };
+
+    // Nothing waits for the thread, so it cleans up after itself.
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    pthread_t preload_thread;
+    int result = pthread_create(&preload_thread, &attributes, preload_thread_proc, request);
+
+    pthread_attr_destroy(&attributes);
+
+    if (result != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the preload thread: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(result));
+
+        free(request);
+        return UIOHOOK_FAILURE;
+    }
+
+    return UIOHOOK_SUCCESS;
+}
@@ -0,0 +1,13 @@
+#ifndef PRELOAD_THREAD_H
+#define PRELOAD_THREAD_H
+
+#include <uiohook.h>
+
+/* Opens what a back-end otherwise opens on first use, and returns the status. */
+typedef int (*preload_proc_t)();
+
+/* Runs the procedure on a detached thread, which then calls the callback with its status. Only a back-end which is
+ * built into libuiohook needs it, as the loader otherwise calls hook_preload on a thread of its own. */
+int start_preload_thread(preload_proc_t preload_proc, preload_done_t done_proc, void *user_data);
+
+#endif
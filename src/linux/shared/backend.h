@@ -9,20 +9,41 @@
  * Returns the number of code units which were written to the buffer. */
 size_t backend_key_to_unicode(uint16_t evdev_code, uint16_t modifier_mask, uint16_t *buffer, size_t length);
 
+/* Lets the back-end follow the keyboard state which backend_key_to_unicode translates with.
+ * Called on the hook thread after a key event has been dispatched. */
+void backend_update_key_state(uint16_t evdev_code, bool pressed);
+
 /* Gets the current pointer position in desktop coordinates.
  * Returns false if the back-end cannot provide a position. */
 bool backend_get_pointer_position(int16_t *x, int16_t *y);
 
-/* Gets the size of the desktop bounding box.
- * Returns false if the back-end cannot provide it. */
-bool backend_get_desktop_bounds(uint16_t *width, uint16_t *height);
+/* Lets back-ends which cannot query the pointer follow it from the relative motion, in pixels, which the hook sees.
+ * Called on the hook thread before the motion is dispatched. */
+void backend_track_pointer_motion(double dx, double dy);
+
+/* Lets back-ends which cannot query the pointer follow it from the absolute positions which the hook sees.
+ * Called on the hook thread before the motion is dispatched. */
+void backend_track_pointer_position(int16_t x, int16_t y);
+
+/* The size of the desktop bounding box, and the position of the origin of the coordinate space which
+ * backend_get_pointer_position reports within it. */
+typedef struct _desktop_geometry {
+    uint16_t width;
+    uint16_t height;
+    int16_t origin_x;
+    int16_t origin_y;
+} desktop_geometry;
+
+/* Gets the size and origin of the desktop bounding box at once.
+ * The hook thread doesn't wait for a back-end which is still reading them, and gets false instead.
+ * Returns false if the back-end cannot provide them. */
+bool backend_get_desktop_geometry(desktop_geometry *geometry, bool wait);
 
-/* Adjusts a position which was transformed over the desktop bounding box so that it's in the same
- * coordinate space as the positions which backend_get_pointer_position reports. */
-void backend_adjust_absolute_position(int16_t *x, int16_t *y);
+/* Gets a file descriptor which the input loop watches alongside libinput, so that the back-end can keep
+ * its own state up to date on the hook thread. Returns -1 if there is nothing to watch. */
+int backend_get_event_fd();
 
-/* Moves a position which is in the coordinate space that backend_get_pointer_position reports back
- * into the desktop bounding box. The inverse of backend_adjust_absolute_position. */
-void backend_restore_absolute_position(int16_t *x, int16_t *y);
+/* Handles whatever became readable on the file descriptor from backend_get_event_fd. */
+void backend_handle_events();
 
 #endif
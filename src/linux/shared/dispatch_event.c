@@ -12,6 +12,7 @@
 
 #include "backend.h"
 #include "dispatch_event.h"
+#include "hook_stats.h"
 #include "input_helper.h"
 
 // libinput reports 120 units per wheel click, which is the same unit as WHEEL_DELTA on Windows.
@@ -21,6 +22,8 @@
 // Finger and continuous scrolling are reported in pixels instead of wheel clicks.
 #define SCROLL_PIXELS_PER_CLICK     10.0
 
+#define NS_PER_US                   1000
+
 typedef struct _mouse_click {
     uint16_t count;
     uint64_t time;
@@ -44,9 +47,15 @@ static bool desktop_bounds_unavailable_logged = false;
 
 static uiohook_event uio_event;
 
+// When the kernel timestamped the event which is being dispatched, on the monotonic clock.
+static uint64_t event_time = STATS_NO_EVENT_TIME;
+
 static dispatcher_t dispatch = NULL;
 static void *dispatch_data = NULL;
 
+static settings_changed_t settings_changed = NULL;
+static void *settings_changed_data = NULL;
+
 static bool key_typed_enabled = false;
 
 static bool is_key_typed_supported() {
@@ -58,11 +67,10 @@ bool hook_is_key_typed_enabled() {
 }
 
 void hook_set_key_typed_enabled(bool enabled) {
+    // On Wayland, support depends on the keymap, which can arrive later, so the flag is kept either way.
     if (enabled && !is_key_typed_supported()) {
-        logger(LOG_LEVEL_WARN, "%s [%u]: Key typed events are not supported on this back-end.\n",
+        logger(LOG_LEVEL_INFO, "%s [%u]: Key typed events will be dispatched once they are supported.\n",
                 __FUNCTION__, __LINE__);
-
-        return;
     }
 
     key_typed_enabled = enabled;
@@ -76,6 +84,27 @@ void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data) {
     dispatch_data = user_data;
 }
 
+void hook_set_settings_changed_proc(settings_changed_t settings_changed_proc, void *user_data) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting new settings changed callback to %#p.\n",
+            __FUNCTION__, __LINE__, settings_changed_proc);
+
+    settings_changed = settings_changed_proc;
+    settings_changed_data = user_data;
+}
+
+void dispatch_settings_changed(uint32_t changed_settings) {
+    if (changed_settings == 0) {
+        return;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Settings changed. (%#X)\n",
+            __FUNCTION__, __LINE__, changed_settings);
+
+    if (settings_changed != NULL) {
+        settings_changed(changed_settings, settings_changed_data);
+    }
+}
+
 static uint64_t get_unix_timestamp() {
     struct timeval system_time;
 
@@ -103,12 +132,18 @@ static uint64_t get_multi_click_time() {
 }
 
 static void dispatch_event(uiohook_event *const uio_event) {
+    uint64_t start = stats_get_time();
+    stats_record_event(uio_event->type, event_time, start);
+
     if (dispatch != NULL) {
         logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching event type %u.\n",
                 __FUNCTION__, __LINE__, uio_event->type);
 
         dispatch(uio_event, dispatch_data);
+        stats_record_callback(stats_get_time() - start);
     } else {
+        stats_record_dropped();
+
         logger(LOG_LEVEL_WARN, "%s [%u]: No dispatch callback set!\n",
                 __FUNCTION__, __LINE__);
     }
@@ -130,6 +165,8 @@ void dispatch_hook_enabled() {
     motion_remainder_y = 0.0;
     desktop_bounds_unavailable_logged = false;
 
+    event_time = STATS_NO_EVENT_TIME;
+
     uio_event.time = get_unix_timestamp();
     uio_event.type = EVENT_HOOK_ENABLED;
     uio_event.mask = 0x00;
@@ -138,6 +175,8 @@ void dispatch_hook_enabled() {
 }
 
 void dispatch_hook_disabled() {
+    event_time = STATS_NO_EVENT_TIME;
+
     uio_event.time = get_unix_timestamp();
     uio_event.type = EVENT_HOOK_DISABLED;
     uio_event.mask = 0x00;
@@ -145,7 +184,7 @@ void dispatch_hook_disabled() {
     dispatch_event(&uio_event);
 }
 
-static void dispatch_key_typed(uint64_t timestamp, uint16_t evdev_code, uint16_t uiocode, bool emulated) {
+static void dispatch_key_typed(uint64_t timestamp, uint16_t evdev_code, uint16_t uiocode, uint32_t source_mask) {
     uint16_t surrogate[2] = {};
     size_t count = backend_key_to_unicode(evdev_code, get_modifiers(), surrogate, sizeof(surrogate) / sizeof(uint16_t));
 
@@ -153,9 +192,7 @@ static void dispatch_key_typed(uint64_t timestamp, uint16_t evdev_code, uint16_t
         uio_event.time = timestamp;
         uio_event.type = EVENT_KEY_TYPED;
         uio_event.mask = get_modifiers();
-        if (emulated) {
-            uio_event.mask |= MASK_EMULATED;
-        }
+        uio_event.mask |= source_mask;
 
         uio_event.data.keyboard.keycode = uiocode;
         uio_event.data.keyboard.rawcode = evdev_code;
@@ -169,7 +206,7 @@ static void dispatch_key_typed(uint64_t timestamp, uint16_t evdev_code, uint16_t
     }
 }
 
-static void dispatch_key(uint64_t timestamp, struct libinput_event_keyboard *keyboard_event, bool emulated) {
+static void dispatch_key(uint64_t timestamp, struct libinput_event_keyboard *keyboard_event, uint32_t source_mask) {
     uint16_t evdev_code = (uint16_t) libinput_event_keyboard_get_key(keyboard_event);
     uint16_t uiocode = evdev_code_to_uiocode(evdev_code);
     bool pressed = libinput_event_keyboard_get_key_state(keyboard_event) == LIBINPUT_KEY_STATE_PRESSED;
@@ -195,9 +232,7 @@ static void dispatch_key(uint64_t timestamp, struct libinput_event_keyboard *key
     uio_event.time = timestamp;
     uio_event.type = pressed ? EVENT_KEY_PRESSED : EVENT_KEY_RELEASED;
     uio_event.mask = get_modifiers();
-    if (emulated) {
-        uio_event.mask |= MASK_EMULATED;
-    }
+    uio_event.mask |= source_mask;
 
     uio_event.data.keyboard.keycode = uiocode;
     uio_event.data.keyboard.rawcode = evdev_code;
@@ -210,18 +245,20 @@ static void dispatch_key(uint64_t timestamp, struct libinput_event_keyboard *key
 
     dispatch_event(&uio_event);
 
-    if (pressed && hook_is_key_typed_enabled()) {
-        dispatch_key_typed(timestamp, evdev_code, uiocode, emulated);
+    // Without support, the back-end doesn't translate any characters, so the hook thread doesn't ask for it.
+    if (pressed && key_typed_enabled) {
+        dispatch_key_typed(timestamp, evdev_code, uiocode, source_mask);
     }
+
+    // The key is translated with the state from before it, which matters for the keys that change it.
+    backend_update_key_state(evdev_code, pressed);
 }
 
-static void dispatch_mouse_clicked(uint64_t timestamp, uint16_t button, bool emulated) {
+static void dispatch_mouse_clicked(uint64_t timestamp, uint16_t button, uint32_t source_mask) {
     uio_event.time = timestamp;
     uio_event.type = EVENT_MOUSE_CLICKED;
     uio_event.mask = get_modifiers();
-    if (emulated) {
-        uio_event.mask |= MASK_EMULATED;
-    }
+    uio_event.mask |= source_mask;
 
     uio_event.data.mouse.button = button;
     uio_event.data.mouse.clicks = click.count;
@@ -235,7 +272,8 @@ static void dispatch_mouse_clicked(uint64_t timestamp, uint16_t button, bool emu
     dispatch_event(&uio_event);
 }
 
-static void dispatch_mouse_button(uint64_t timestamp, struct libinput_event_pointer *pointer_event, bool emulated) {
+static void dispatch_mouse_button(uint64_t timestamp, struct libinput_event_pointer *pointer_event,
+        uint32_t source_mask) {
     uint16_t button = evdev_code_to_button((uint16_t) libinput_event_pointer_get_button(pointer_event));
     if (button == MOUSE_NOBUTTON) {
         logger(LOG_LEVEL_DEBUG, "%s [%u]: Ignoring unmapped button %u.\n",
@@ -272,9 +310,7 @@ static void dispatch_mouse_button(uint64_t timestamp, struct libinput_event_poin
     uio_event.time = timestamp;
     uio_event.type = pressed ? EVENT_MOUSE_PRESSED : EVENT_MOUSE_RELEASED;
     uio_event.mask = get_modifiers();
-    if (emulated) {
-        uio_event.mask |= MASK_EMULATED;
-    }
+    uio_event.mask |= source_mask;
 
     uio_event.data.mouse.button = button;
     uio_event.data.mouse.clicks = click.count;
@@ -288,11 +324,11 @@ static void dispatch_mouse_button(uint64_t timestamp, struct libinput_event_poin
     dispatch_event(&uio_event);
 
     if (!pressed && !pointer_moved) {
-        dispatch_mouse_clicked(timestamp, button, emulated);
+        dispatch_mouse_clicked(timestamp, button, source_mask);
     }
 }
 
-static void dispatch_mouse_moved(uint64_t timestamp, int16_t x, int16_t y, bool absolute, bool emulated) {
+static void dispatch_mouse_moved(uint64_t timestamp, int16_t x, int16_t y, bool absolute, uint32_t source_mask) {
     pointer_moved = true;
 
     if (click.count != 0 && timestamp - click.time > get_multi_click_time()) {
@@ -303,9 +339,7 @@ static void dispatch_mouse_moved(uint64_t timestamp, int16_t x, int16_t y, bool
 
     uio_event.time = timestamp;
     uio_event.mask = get_modifiers();
-    if (emulated) {
-        uio_event.mask |= MASK_EMULATED;
-    }
+    uio_event.mask |= source_mask;
 
     if (absolute) {
         uio_event.type = button_held ? EVENT_MOUSE_DRAGGED : EVENT_MOUSE_MOVED;
@@ -326,34 +360,41 @@ static void dispatch_mouse_moved(uint64_t timestamp, int16_t x, int16_t y, bool
     dispatch_event(&uio_event);
 }
 
-static void dispatch_mouse_motion(uint64_t timestamp, struct libinput_event_pointer *pointer_event, bool emulated) {
+static void dispatch_mouse_motion(uint64_t timestamp, struct libinput_event_pointer *pointer_event,
+        uint32_t source_mask) {
+    double motion_x = libinput_event_pointer_get_dx(pointer_event);
+    double motion_y = libinput_event_pointer_get_dy(pointer_event);
+
+    backend_track_pointer_motion(motion_x, motion_y);
+
     int16_t x, y;
 
     if (backend_get_pointer_position(&x, &y)) {
-        dispatch_mouse_moved(timestamp, x, y, true, emulated);
+        dispatch_mouse_moved(timestamp, x, y, true, source_mask);
         return;
     }
 
-    int16_t dx = accumulate_motion(libinput_event_pointer_get_dx(pointer_event), &motion_remainder_x);
-    int16_t dy = accumulate_motion(libinput_event_pointer_get_dy(pointer_event), &motion_remainder_y);
+    int16_t dx = accumulate_motion(motion_x, &motion_remainder_x);
+    int16_t dy = accumulate_motion(motion_y, &motion_remainder_y);
 
     if (dx == 0 && dy == 0) {
         // The movement is still shorter than a pixel, so there is nothing to report yet.
         return;
     }
 
-    dispatch_mouse_moved(timestamp, dx, dy, false, emulated);
+    dispatch_mouse_moved(timestamp, dx, dy, false, source_mask);
 }
 
-static void dispatch_mouse_motion_absolute(uint64_t timestamp, struct libinput_event_pointer *pointer_event, bool emulated) {
+static void dispatch_mouse_motion_absolute(uint64_t timestamp, struct libinput_event_pointer *pointer_event,
+        uint32_t source_mask) {
     int16_t x, y;
-    uint16_t width, height;
-
-    if (backend_get_desktop_bounds(&width, &height)) {
-        x = round_to_int16(libinput_event_pointer_get_absolute_x_transformed(pointer_event, width));
-        y = round_to_int16(libinput_event_pointer_get_absolute_y_transformed(pointer_event, height));
+    desktop_geometry geometry;
 
-        backend_adjust_absolute_position(&x, &y);
+    if (backend_get_desktop_geometry(&geometry, false)) {
+        x = round_to_int16(libinput_event_pointer_get_absolute_x_transformed(pointer_event, geometry.width)
+            - geometry.origin_x);
+        y = round_to_int16(libinput_event_pointer_get_absolute_y_transformed(pointer_event, geometry.height)
+            - geometry.origin_y);
     } else if (!backend_get_pointer_position(&x, &y)) {
         if (!desktop_bounds_unavailable_logged) {
             logger(LOG_LEVEL_WARN, "%s [%u]: Ignoring absolute motion as the desktop bounds are unavailable!\n",
@@ -365,7 +406,8 @@ static void dispatch_mouse_motion_absolute(uint64_t timestamp, struct libinput_e
         return;
     }
 
-    dispatch_mouse_moved(timestamp, x, y, true, emulated);
+    backend_track_pointer_position(x, y);
+    dispatch_mouse_moved(timestamp, x, y, true, source_mask);
 }
 
 static void dispatch_mouse_wheel(
@@ -373,7 +415,7 @@ static void dispatch_mouse_wheel(
         struct libinput_event_pointer *pointer_event,
         enum libinput_pointer_axis axis,
         bool wheel,
-        bool emulated) {
+        uint32_t source_mask) {
     double value = wheel
         ? libinput_event_pointer_get_scroll_value_v120(pointer_event, axis)
         : libinput_event_pointer_get_scroll_value(pointer_event, axis) * WHEEL_DELTA / SCROLL_PIXELS_PER_CLICK;
@@ -390,9 +432,7 @@ static void dispatch_mouse_wheel(
     uio_event.time = timestamp;
     uio_event.type = EVENT_MOUSE_WHEEL;
     uio_event.mask = get_modifiers();
-    if (emulated) {
-        uio_event.mask |= MASK_EMULATED;
-    }
+    uio_event.mask |= source_mask;
 
     get_pointer_position(&uio_event.data.wheel.x, &uio_event.data.wheel.y);
 
@@ -412,24 +452,45 @@ static void dispatch_mouse_wheel(
     dispatch_event(&uio_event);
 }
 
-void dispatch_libinput_event(struct libinput_event *event, bool emulated) {
+// libinput timestamps events with the monotonic clock in microseconds. The type is checked first, as libinput logs a
+// bug for every event which is asked for a keyboard or pointer event of another type.
+static uint64_t get_event_time(struct libinput_event *event) {
+    switch (libinput_event_get_type(event)) {
+        case LIBINPUT_EVENT_KEYBOARD_KEY:
+            return libinput_event_keyboard_get_time_usec(libinput_event_get_keyboard_event(event)) * NS_PER_US;
+
+        case LIBINPUT_EVENT_POINTER_MOTION:
+        case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+        case LIBINPUT_EVENT_POINTER_BUTTON:
+        case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
+        case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
+        case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS:
+            return libinput_event_pointer_get_time_usec(libinput_event_get_pointer_event(event)) * NS_PER_US;
+
+        default:
+            return STATS_NO_EVENT_TIME;
+    }
+}
+
+void dispatch_libinput_event(struct libinput_event *event, uint32_t source_mask) {
     uint64_t timestamp = get_unix_timestamp();
+    event_time = get_event_time(event);
 
     switch (libinput_event_get_type(event)) {
         case LIBINPUT_EVENT_KEYBOARD_KEY:
-            dispatch_key(timestamp, libinput_event_get_keyboard_event(event), emulated);
+            dispatch_key(timestamp, libinput_event_get_keyboard_event(event), source_mask);
             break;
 
         case LIBINPUT_EVENT_POINTER_MOTION:
-            dispatch_mouse_motion(timestamp, libinput_event_get_pointer_event(event), emulated);
+            dispatch_mouse_motion(timestamp, libinput_event_get_pointer_event(event), source_mask);
             break;
 
         case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
-            dispatch_mouse_motion_absolute(timestamp, libinput_event_get_pointer_event(event), emulated);
+            dispatch_mouse_motion_absolute(timestamp, libinput_event_get_pointer_event(event), source_mask);
             break;
 
         case LIBINPUT_EVENT_POINTER_BUTTON:
-            dispatch_mouse_button(timestamp, libinput_event_get_pointer_event(event), emulated);
+            dispatch_mouse_button(timestamp, libinput_event_get_pointer_event(event), source_mask);
             break;
 
         case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
@@ -441,13 +502,13 @@ void dispatch_libinput_event(struct libinput_event *event, bool emulated) {
             if (libinput_event_pointer_has_axis(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)) {
                 dispatch_mouse_wheel(
                         timestamp, pointer_event,
-                        LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL, wheel, emulated);
+                        LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL, wheel, source_mask);
             }
 
             if (libinput_event_pointer_has_axis(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL)) {
                 dispatch_mouse_wheel(
                         timestamp, pointer_event,
-                        LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL, wheel, emulated);
+                        LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL, wheel, source_mask);
             }
             break;
 
@@ -2,6 +2,7 @@
 #define SHARED_DISPATCH_EVENT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <libinput.h>
 
@@ -11,7 +12,10 @@ void dispatch_hook_enabled();
 /* Dispatches the event which reports that the hook has been disabled. */
 void dispatch_hook_disabled();
 
+/* Reports which settings have changed to the settings changed callback. */
+void dispatch_settings_changed(uint32_t changed_settings);
+
 /* Translates a libinput event into a uiohook event and dispatches it. */
-void dispatch_libinput_event(struct libinput_event *event, bool emulated);
+void dispatch_libinput_event(struct libinput_event *event, uint32_t source_mask);
 
 #endif
@@ -18,10 +18,12 @@
 #include <logger.h>
 #include <uiohook.h>
 
+#include "backend.h"
 #include "device_procs.h"
 #include "dispatch_event.h"
 #include "input_helper.h"
 #include "input_loop.h"
+#include "uinput_helper.h"
 
 #define VIRTUAL_DEVICE_PATH         "/sys/devices/virtual/"
 
@@ -31,7 +33,8 @@ static pthread_mutex_t stop_fd_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static device_procs procs;
 
-static const char emulated_device;
+// The user data of a virtual device points to the element of its set, so that the set can be reported with its events.
+static const char emulated_devices[VIRTUAL_DEVICE_SET_MAX + 1];
 
 static unsigned int input_device_count = 0;
 
@@ -48,6 +51,23 @@ static const struct libinput_interface interface = {
     .close_restricted = close_restricted
 };
 
+// The virtual devices of this library store their set in their version, and other virtual devices have no set.
+static uint8_t get_virtual_device_set(struct udev_device *udev_device) {
+    struct udev_device *parent = udev_device_get_parent_with_subsystem_devtype(udev_device, "input", NULL);
+    if (parent == NULL) {
+        return VIRTUAL_DEVICE_SET_DEFAULT;
+    }
+
+    const char *vendor = udev_device_get_sysattr_value(parent, "id/vendor");
+    const char *version = udev_device_get_sysattr_value(parent, "id/version");
+
+    if (vendor == NULL || version == NULL || strtoul(vendor, NULL, 16) != VIRTUAL_DEVICE_VENDOR) {
+        return VIRTUAL_DEVICE_SET_DEFAULT;
+    }
+
+    return VIRTUAL_DEVICE_VERSION_SET(strtoul(version, NULL, 16));
+}
+
 static void add_device(struct libinput_device *device) {
     if (!libinput_device_has_capability(device, LIBINPUT_DEVICE_CAP_KEYBOARD)
             && !libinput_device_has_capability(device, LIBINPUT_DEVICE_CAP_POINTER)) {
@@ -72,7 +92,7 @@ static void add_device(struct libinput_device *device) {
 
     const char *syspath = udev_device_get_syspath(udev_device);
     if (syspath != NULL && strncmp(syspath, VIRTUAL_DEVICE_PATH, strlen(VIRTUAL_DEVICE_PATH)) == 0) {
-        libinput_device_set_user_data(device, (void *) &emulated_device);
+        libinput_device_set_user_data(device, (void *) &emulated_devices[get_virtual_device_set(udev_device)]);
     }
 
     const char *devnode = udev_device_get_devnode(udev_device);
@@ -104,7 +124,10 @@ static bool is_device_event(enum libinput_event_type event_type) {
 
 static void handle_event(struct libinput_event *event, bool keyboard, bool mouse) {
     struct libinput_device *device = libinput_event_get_device(event);
-    bool emulated = libinput_device_get_user_data(device) != NULL;
+    const char *emulated_device = libinput_device_get_user_data(device);
+    uint32_t source_mask = emulated_device != NULL
+        ? MASK_EMULATED | (uint32_t) (emulated_device - emulated_devices) << MASK_VIRTUAL_DEVICE_SET_SHIFT
+        : 0;
 
     switch (libinput_event_get_type(event)) {
         case LIBINPUT_EVENT_DEVICE_ADDED:
@@ -117,7 +140,7 @@ static void handle_event(struct libinput_event *event, bool keyboard, bool mouse
 
         case LIBINPUT_EVENT_KEYBOARD_KEY:
             if (keyboard) {
-                dispatch_libinput_event(event, emulated);
+                dispatch_libinput_event(event, source_mask);
             }
             break;
 
@@ -128,7 +151,7 @@ static void handle_event(struct libinput_event *event, bool keyboard, bool mouse
         case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
         case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS:
             if (mouse) {
-                dispatch_libinput_event(event, emulated);
+                dispatch_libinput_event(event, source_mask);
             }
             break;
 
@@ -221,7 +244,7 @@ int run_libinput(bool keyboard, bool mouse) {
         return UIOHOOK_ERROR_LINUX_ASSIGN_SEAT;
     }
 
-    struct pollfd fds[2];
+    struct pollfd fds[3];
 
     fds[0].fd = libinput_get_fd(li);
     fds[0].events = POLLIN;
@@ -244,6 +267,11 @@ int run_libinput(bool keyboard, bool mouse) {
     fds[1].events = POLLIN;
     fds[1].revents = 0;
 
+    // A negative descriptor is ignored by poll, so back-ends without one need no special handling.
+    fds[2].fd = backend_get_event_fd();
+    fds[2].events = POLLIN;
+    fds[2].revents = 0;
+
     clear_modifier_mask();
     input_device_count = 0;
 
@@ -276,7 +304,7 @@ int run_libinput(bool keyboard, bool mouse) {
 
         bool running = true;
         while (running) {
-            int result = poll(fds, 2, -1);
+            int result = poll(fds, 3, -1);
             if (result < 0) {
                 if (errno == EINTR) { // We don't care about interruptions here.
                     continue;
@@ -288,6 +316,11 @@ int run_libinput(bool keyboard, bool mouse) {
                 break;
             }
 
+            // The back-end state has to be current before the input events which may depend on it.
+            if (fds[2].revents & POLLIN) {
+                backend_handle_events();
+            }
+
             if (fds[0].revents & POLLIN) {
                 handle_events(li, keyboard, mouse);
             }
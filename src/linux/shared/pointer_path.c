@@ -0,0 +1,210 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <logger.h>
+#include <uiohook.h>
+
+#include "timed_post.h"
+
+typedef struct _path_point {
+    double x;
+    double y;
+} path_point;
+
+static int16_t round_to_int16(double value) {
+    return (int16_t) (value + (value >= 0 ? 0.5 : -0.5));
+}
+
+static double ease(uint8_t easing, double t) {
+    double u;
+
+    switch (easing) {
+        case POINTER_PATH_EASING_IN:
+            return t * t * t;
+
+        case POINTER_PATH_EASING_OUT:
+            u = 1 - t;
+            return 1 - u * u * u;
+
+        case POINTER_PATH_EASING_IN_OUT:
+            if (t < 0.5) {
+                return 4 * t * t * t;
+            }
+
+            u = 2 - 2 * t;
+            return 1 - u * u * u / 2;
+
+        case POINTER_PATH_EASING_LINEAR:
+        default:
+            return t;
+    }
+}
+
+// The lines are walked at a constant speed, so each of them takes time in proportion to its length.
+// The distances are how far along the path each waypoint is.
+static path_point get_line_point(const pointer_waypoint *waypoints, uint32_t count, const double *distances,
+        double t) {
+    if (count == 1) {
+        return (path_point) { .x = waypoints[0].x, .y = waypoints[0].y };
+    }
+
+    double distance = distances[count - 1] * t;
+
+    uint32_t i = 1;
+    while (i < count - 1 && distances[i] < distance) {
+        i++;
+    }
+
+    double length = distances[i] - distances[i - 1];
+    double fraction = length > 0 ? (distance - distances[i - 1]) / length : 1;
+
+    return (path_point) {
+        .x = waypoints[i - 1].x + (waypoints[i].x - waypoints[i - 1].x) * fraction,
+        .y = waypoints[i - 1].y + (waypoints[i].y - waypoints[i - 1].y) * fraction
+    };
+}
+
+// The points of a Bezier curve are found with de Casteljau's algorithm, which needs a point per waypoint.
+static path_point get_bezier_point(const pointer_waypoint *waypoints, uint32_t count, path_point *scratch,
+        double t) {
+    for (uint32_t i = 0; i < count; i++) {
+        scratch[i] = (path_point) { .x = waypoints[i].x, .y = waypoints[i].y };
+    }
+
+    for (uint32_t level = count - 1; level > 0; level--) {
+        for (uint32_t i = 0; i < level; i++) {
+            scratch[i].x += (scratch[i + 1].x - scratch[i].x) * t;
+            scratch[i].y += (scratch[i + 1].y - scratch[i].y) * t;
+        }
+    }
+
+    return scratch[0];
+}
+
+static bool is_valid_path(const pointer_path_options * const options) {
+    if (options->curve != POINTER_PATH_CURVE_LINEAR && options->curve != POINTER_PATH_CURVE_BEZIER) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Unknown pointer path curve: %u\n",
+                __FUNCTION__, __LINE__, options->curve);
+
+        return false;
+    }
+
+    if (options->easing > POINTER_PATH_EASING_IN_OUT) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Unknown pointer path easing: %u\n",
+                __FUNCTION__, __LINE__, options->easing);
+
+        return false;
+    }
+
+    if (options->rate == 0 || options->rate > POINTER_PATH_RATE_MAX) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: The pointer path rate must be between 1 and %u events per second!\n",
+                __FUNCTION__, __LINE__, POINTER_PATH_RATE_MAX);
+
+        return false;
+    }
+
+    return true;
+}
+
+int hook_post_pointer_path(const pointer_waypoint * const waypoints, uint32_t count,
+        const pointer_path_options * const options, post_progress_t progress_proc, void *user_data) {
+    if (waypoints == NULL || options == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Not simulating a pointer path as the waypoints or options are null.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_NULL;
+    }
+
+    if (count == 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Not simulating a pointer path as it has no waypoints.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_SUCCESS;
+    }
+
+    if (!is_valid_path(options)) {
+        return UIOHOOK_FAILURE;
+    }
+
+    // A path without a duration just moves the pointer to its end.
+    uint64_t steps = (uint64_t) options->duration * options->rate / 1000;
+    if (steps == 0) {
+        steps = 1;
+    }
+
+    if (steps >= UINT32_MAX) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: The pointer path is too long!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_FAILURE;
+    }
+
+    bool linear = options->curve == POINTER_PATH_CURVE_LINEAR;
+
+    uiohook_event *events = malloc(sizeof(uiohook_event) * (steps + 1));
+    double *distances = linear ? malloc(sizeof(double) * count) : NULL;
+    path_point *scratch = linear ? NULL : malloc(sizeof(path_point) * count);
+
+    if (events == NULL || (linear ? distances == NULL : scratch == NULL)) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the pointer path!\n",
+                __FUNCTION__, __LINE__);
+
+        free(events);
+        free(distances);
+        free(scratch);
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    if (linear) {
+        distances[0] = 0;
+
+        for (uint32_t i = 1; i < count; i++) {
+            double dx = waypoints[i].x - waypoints[i - 1].x;
+            double dy = waypoints[i].y - waypoints[i - 1].y;
+
+            distances[i] = distances[i - 1] + sqrt(dx * dx + dy * dy);
+        }
+    }
+
+    // A relative path starts where the pointer is, which is its origin.
+    int16_t previous_x = 0, previous_y = 0;
+    uint32_t size = 0;
+
+    for (uint64_t i = 0; i <= steps; i++) {
+        double t = ease(options->easing, (double) i / steps);
+
+        path_point point = linear
+            ? get_line_point(waypoints, count, distances, t)
+            : get_bezier_point(waypoints, count, scratch, t);
+
+        int16_t x = round_to_int16(point.x);
+        int16_t y = round_to_int16(point.y);
+
+        // The points are rounded before they are compared, so that the relative movements add up without drift.
+        // The last point is always posted, so that the path reports its end even if it doesn't move.
+        bool moved = x != previous_x || y != previous_y || (!options->relative && i == 0);
+        if (!moved && i != steps) {
+            continue;
+        }
+
+        events[size++] = (uiohook_event) {
+            .time = i * options->duration / steps,
+            .type = options->relative ? EVENT_MOUSE_MOVED_RELATIVE : EVENT_MOUSE_MOVED,
+            .data.mouse.x = options->relative ? x - previous_x : x,
+            .data.mouse.y = options->relative ? y - previous_y : y
+        };
+
+        previous_x = x;
+        previous_y = y;
+    }
+
+    free(distances);
+    free(scratch);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Generated %u events for a pointer path through %u waypoints.\n",
+            __FUNCTION__, __LINE__, size, count);
+
+    return start_timed_post(events, size, progress_proc, user_data);
+}
@@ -8,6 +8,7 @@
 
 #include "backend.h"
 #include "input_helper.h"
+#include "post_event.h"
 #include "uinput_helper.h"
 
 #define WHEEL_DELTA 120
@@ -15,9 +16,20 @@
 #define WHEEL_AXIS_VERTICAL   0
 #define WHEEL_AXIS_HORIZONTAL 1
 
-static int32_t wheel_remainder[2] = { 0, 0 };
+#define MOTION_AXIS_X 0
+#define MOTION_AXIS_Y 1
 
-static int post_key_event(uiohook_event * const event) {
+// The desktop geometry which absolute positions are posted over. It's resolved when a batch posts its first
+// absolute position and then kept for the rest of the batch, so that the back-end isn't locked for every event.
+typedef struct _absolute_transform {
+    bool resolved;
+    bool available;
+    desktop_geometry geometry;
+    double scale_x;
+    double scale_y;
+} absolute_transform;
+
+static int post_key_event(virtual_devices_lock *lock, uiohook_event * const event) {
     uint16_t evdev_code = uiocode_to_evdev_code(event->data.keyboard.keycode);
     if (evdev_code == 0) {
         logger(LOG_LEVEL_WARN, "%s [%u]: Unable to look up the evdev key code: %u\n",
@@ -26,22 +38,36 @@ static int post_key_event(uiohook_event * const event) {
         return UIOHOOK_FAILURE;
     }
 
-    return post_virtual_key(evdev_code, event->type == EVENT_KEY_PRESSED);
+    return queue_virtual_key(lock, evdev_code, event->type == EVENT_KEY_PRESSED);
+}
+
+static bool resolve_absolute_transform(absolute_transform *transform) {
+    if (!transform->resolved) {
+        transform->resolved = true;
+        transform->available = backend_get_desktop_geometry(&transform->geometry, true)
+            && transform->geometry.width > 0 && transform->geometry.height > 0;
+
+        if (transform->available) {
+            transform->scale_x = (double) ABSOLUTE_AXIS_MAX / transform->geometry.width;
+            transform->scale_y = (double) ABSOLUTE_AXIS_MAX / transform->geometry.height;
+        }
+    }
+
+    return transform->available;
 }
 
-static int32_t normalize_position(int16_t position, uint16_t size) {
+static int32_t normalize_position(int32_t position, uint16_t size, double scale) {
     if (position < 0) {
         position = 0;
     } else if (position >= size) {
         position = size - 1;
     }
 
-    return (int32_t) ((position + 0.5) * ABSOLUTE_AXIS_MAX / size);
+    return (int32_t) ((position + 0.5) * scale);
 }
 
-static int post_mouse_motion_absolute(int16_t x, int16_t y) {
-    uint16_t width, height;
-    if (!backend_get_desktop_bounds(&width, &height) || width == 0 || height == 0) {
+static int post_mouse_motion_absolute(virtual_devices_lock *lock, absolute_transform *transform, int16_t x, int16_t y) {
+    if (!resolve_absolute_transform(transform)) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Cannot post an absolute position as the desktop bounds "
                 "are unavailable!\n",
                 __FUNCTION__, __LINE__);
@@ -49,17 +75,26 @@ static int post_mouse_motion_absolute(int16_t x, int16_t y) {
         return UIOHOOK_FAILURE;
     }
 
-    backend_restore_absolute_position(&x, &y);
+    const desktop_geometry *geometry = &transform->geometry;
 
     virtual_event events[] = {
-        { .type = EV_ABS, .code = ABS_X, .value = normalize_position(x, width) },
-        { .type = EV_ABS, .code = ABS_Y, .value = normalize_position(y, height) }
+        {
+            .type = EV_ABS,
+            .code = ABS_X,
+            .value = normalize_position(x + geometry->origin_x, geometry->width, transform->scale_x)
+        },
+        {
+            .type = EV_ABS,
+            .code = ABS_Y,
+            .value = normalize_position(y + geometry->origin_y, geometry->height, transform->scale_y)
+        }
     };
 
-    return post_virtual_events(VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
+    return queue_virtual_events(lock, VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
 }
 
-static int post_mouse_motion_event(uiohook_event * const event) {
+static int post_mouse_motion_event(virtual_devices_lock *lock, absolute_transform *transform,
+        uiohook_event * const event) {
     if (event->type == EVENT_MOUSE_MOVED_RELATIVE || event->type == EVENT_MOUSE_DRAGGED_RELATIVE) {
         // The display server applies its pointer acceleration profile to relative motion, so the
         // pointer will not necessarily move by the exact number of pixels which was posted.
@@ -68,13 +103,14 @@ static int post_mouse_motion_event(uiohook_event * const event) {
             { .type = EV_REL, .code = REL_Y, .value = event->data.mouse.y }
         };
 
-        return post_virtual_events(VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
+        return queue_virtual_events(lock, VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
     }
 
-    return post_mouse_motion_absolute(event->data.mouse.x, event->data.mouse.y);
+    return post_mouse_motion_absolute(lock, transform, event->data.mouse.x, event->data.mouse.y);
 }
 
-static int post_mouse_button_event(uiohook_event * const event) {
+static int post_mouse_button_event(virtual_devices_lock *lock, absolute_transform *transform,
+        uiohook_event * const event) {
     uint16_t evdev_code = button_to_evdev_code(event->data.mouse.button);
     if (evdev_code == 0) {
         logger(LOG_LEVEL_WARN, "%s [%u]: Invalid button specified for a mouse button event: %u\n",
@@ -89,7 +125,7 @@ static int post_mouse_button_event(uiohook_event * const event) {
 
     if (!ignore_coords) {
         // Move the pointer to the specified position first.
-        int status = post_mouse_motion_absolute(event->data.mouse.x, event->data.mouse.y);
+        int status = post_mouse_motion_absolute(lock, transform, event->data.mouse.x, event->data.mouse.y);
         if (status != UIOHOOK_SUCCESS) {
             return status;
         }
@@ -99,10 +135,10 @@ static int post_mouse_button_event(uiohook_event * const event) {
         { .type = EV_KEY, .code = evdev_code, .value = pressed ? 1 : 0 }
     };
 
-    return post_virtual_events(VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
+    return queue_virtual_events(lock, VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
 }
 
-static int post_mouse_wheel_event(uiohook_event * const event) {
+static int post_mouse_wheel_event(virtual_devices_lock *lock, uiohook_event * const event) {
     bool horizontal = event->data.wheel.direction == WHEEL_HORIZONTAL_DIRECTION;
 
     // uiohook reports positive values for scrolling up and left, and evdev - for up and right.
@@ -112,6 +148,7 @@ static int post_mouse_wheel_event(uiohook_event * const event) {
     }
 
     unsigned int axis = horizontal ? WHEEL_AXIS_HORIZONTAL : WHEEL_AXIS_VERTICAL;
+    int32_t *wheel_remainder = get_virtual_wheel_remainder(lock);
     int32_t total = wheel_remainder[axis] + value;
     wheel_remainder[axis] = total % WHEEL_DELTA;
 
@@ -122,22 +159,78 @@ static int post_mouse_wheel_event(uiohook_event * const event) {
         { .type = EV_REL, .code = horizontal ? REL_HWHEEL : REL_WHEEL, .value = total / WHEEL_DELTA }
     };
 
-    return post_virtual_events(VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
+    return queue_virtual_events(lock, VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
 }
 
-int hook_init_virtual_devices(const char * const application_name) {
-    return create_virtual_devices(application_name);
+static bool is_motion_in_range(double value) {
+    // This is false for NaN as well.
+    return value > INT16_MIN - 1 && value < INT16_MAX + 1;
 }
 
-int hook_destroy_virtual_devices() {
-    return destroy_virtual_devices();
+static int post_relative_motion(virtual_devices_lock *lock, const relative_motion_data * const motion) {
+    double *motion_remainder = get_virtual_motion_remainder(lock);
+    double total_x = motion_remainder[MOTION_AXIS_X] + motion->x;
+    double total_y = motion_remainder[MOTION_AXIS_Y] + motion->y;
+
+    if (!is_motion_in_range(total_x) || !is_motion_in_range(total_y)) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Invalid relative motion specified: %f, %f\n",
+                __FUNCTION__, __LINE__, motion->x, motion->y);
+
+        return UIOHOOK_FAILURE;
+    }
+
+    // Only whole pixels can be posted. Truncating keeps the rest with the same sign as the movement it came from.
+    int32_t whole_x = (int32_t) total_x;
+    int32_t whole_y = (int32_t) total_y;
+
+    motion_remainder[MOTION_AXIS_X] = total_x - whole_x;
+    motion_remainder[MOTION_AXIS_Y] = total_y - whole_y;
+
+    // A movement which is less than a pixel so far would only post an empty report.
+    if (whole_x == 0 && whole_y == 0) {
+        return UIOHOOK_SUCCESS;
+    }
+
+    virtual_event events[] = {
+        { .type = EV_REL, .code = REL_X, .value = whole_x },
+        { .type = EV_REL, .code = REL_Y, .value = whole_y }
+    };
+
+    return queue_virtual_events(lock, VIRTUAL_DEVICE_POINTER, events, sizeof(events) / sizeof(events[0]));
 }
 
-int hook_post_event(uiohook_event * const event) {
-    return hook_post_events(event, 1);
+static uint32_t get_device_mask(uiohook_event * const events, uint32_t size) {
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < size && mask != VIRTUAL_DEVICES_ALL; i++) {
+        switch (events[i].type) {
+            case EVENT_KEY_PRESSED:
+            case EVENT_KEY_RELEASED:
+                mask |= VIRTUAL_DEVICE_MASK(VIRTUAL_DEVICE_KEYBOARD);
+                break;
+
+            case EVENT_MOUSE_PRESSED:
+            case EVENT_MOUSE_PRESSED_IGNORE_COORDS:
+            case EVENT_MOUSE_RELEASED:
+            case EVENT_MOUSE_RELEASED_IGNORE_COORDS:
+            case EVENT_MOUSE_MOVED:
+            case EVENT_MOUSE_MOVED_RELATIVE:
+            case EVENT_MOUSE_DRAGGED:
+            case EVENT_MOUSE_DRAGGED_RELATIVE:
+            case EVENT_MOUSE_WHEEL:
+                mask |= VIRTUAL_DEVICE_MASK(VIRTUAL_DEVICE_POINTER);
+                break;
+        }
+    }
+
+    return mask;
 }
 
-int hook_post_events(uiohook_event * const events, uint32_t size) {
+int post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size, uint32_t *posted) {
+    if (posted != NULL) {
+        *posted = 0;
+    }
+
     if (events == NULL) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Not simulating any events as the events are null.\n",
                 __FUNCTION__, __LINE__);
@@ -152,36 +245,48 @@ int hook_post_events(uiohook_event * const events, uint32_t size) {
         return UIOHOOK_SUCCESS;
     }
 
-    int status = lock_virtual_devices();
+    // Only the devices which the events are posted to are locked, so that other threads can post to the rest.
+    virtual_devices_lock lock;
+    int status = lock_virtual_devices(&lock, set_id, get_device_mask(events, size));
     if (status != UIOHOOK_SUCCESS) {
         return status;
     }
 
-    for (uint32_t i = 0; i < size && status == UIOHOOK_SUCCESS; i++) {
+    absolute_transform transform = { .resolved = false };
+
+    // The index of the first event whose reports may still be queued.
+    uint32_t pending = 0;
+    uint32_t i = 0;
+
+    for (; i < size; i++) {
         uiohook_event *event = events + i;
 
+        if (!virtual_events_queued(&lock)) {
+            pending = i;
+        }
+
         switch (event->type) {
             case EVENT_KEY_PRESSED:
             case EVENT_KEY_RELEASED:
-                status = post_key_event(event);
+                status = post_key_event(&lock, event);
                 break;
 
             case EVENT_MOUSE_PRESSED:
             case EVENT_MOUSE_PRESSED_IGNORE_COORDS:
             case EVENT_MOUSE_RELEASED:
             case EVENT_MOUSE_RELEASED_IGNORE_COORDS:
-                status = post_mouse_button_event(event);
+                status = post_mouse_button_event(&lock, &transform, event);
                 break;
 
             case EVENT_MOUSE_MOVED:
             case EVENT_MOUSE_MOVED_RELATIVE:
             case EVENT_MOUSE_DRAGGED:
             case EVENT_MOUSE_DRAGGED_RELATIVE:
-                status = post_mouse_motion_event(event);
+                status = post_mouse_motion_event(&lock, &transform, event);
                 break;
 
             case EVENT_MOUSE_WHEEL:
-                status = post_mouse_wheel_event(event);
+                status = post_mouse_wheel_event(&lock, event);
                 break;
 
             case EVENT_KEY_TYPED:
@@ -197,9 +302,131 @@ int hook_post_events(uiohook_event * const events, uint32_t size) {
                 status = UIOHOOK_FAILURE;
                 break;
         }
+
+        if (status != UIOHOOK_SUCCESS) {
+            break;
+        }
+    }
+
+    if (status == UIOHOOK_SUCCESS) {
+        if (!virtual_events_queued(&lock)) {
+            pending = size;
+        }
+
+        status = flush_virtual_events(&lock);
+    } else if (status != UIOHOOK_ERROR_LINUX_WRITE_UINPUT) {
+        // The event which couldn't be posted stops the batch, but the ones before it are still posted.
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Stopped posting at the event with index %u.\n",
+                __FUNCTION__, __LINE__, i);
+
+        int flush_status = flush_virtual_events(&lock);
+        if (flush_status != UIOHOOK_SUCCESS) {
+            status = flush_status;
+        }
+    }
+
+    if (status == UIOHOOK_ERROR_LINUX_WRITE_UINPUT) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: The events starting with index %u may not have been posted.\n",
+                __FUNCTION__, __LINE__, pending);
+    }
+
+    unlock_virtual_devices(&lock);
+
+    if (posted != NULL) {
+        if (status == UIOHOOK_SUCCESS) {
+            *posted = size;
+        } else if (status == UIOHOOK_ERROR_LINUX_WRITE_UINPUT) {
+            *posted = pending;
+        } else {
+            *posted = i;
+        }
+    }
+
+    return status;
+}
+
+int hook_init_virtual_devices(const char * const application_name) {
+    return create_virtual_devices(application_name);
+}
+
+int hook_destroy_virtual_devices() {
+    return destroy_virtual_devices();
+}
+
+int hook_create_virtual_device_set(const char * const application_name, uint8_t *set_id) {
+    if (set_id == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Not creating a virtual device set as the set ID is null.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_NULL;
+    }
+
+    return create_virtual_device_set(application_name, set_id);
+}
+
+int hook_destroy_virtual_device_set(uint8_t set_id) {
+    return destroy_virtual_device_set(set_id);
+}
+
+int hook_post_event(uiohook_event * const event) {
+    return post_events_on(VIRTUAL_DEVICE_SET_DEFAULT, event, 1, NULL);
+}
+
+int hook_post_events(uiohook_event * const events, uint32_t size) {
+    return post_events_on(VIRTUAL_DEVICE_SET_DEFAULT, events, size, NULL);
+}
+
+int hook_post_events_counted(uiohook_event * const events, uint32_t size, uint32_t *posted) {
+    return post_events_on(VIRTUAL_DEVICE_SET_DEFAULT, events, size, posted);
+}
+
+int hook_post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size) {
+    return post_events_on(set_id, events, size, NULL);
+}
+
+int hook_post_relative_motion(const relative_motion_data * const motions, uint32_t size) {
+    if (motions == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Not simulating any motion as the motions are null.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_NULL;
+    }
+
+    if (size == 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Not simulating any motion as the size is 0.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_SUCCESS;
+    }
+
+    virtual_devices_lock lock;
+    int status = lock_virtual_devices(&lock, VIRTUAL_DEVICE_SET_DEFAULT, VIRTUAL_DEVICE_MASK(VIRTUAL_DEVICE_POINTER));
+    if (status != UIOHOOK_SUCCESS) {
+        return status;
+    }
+
+    uint32_t i = 0;
+    for (; i < size; i++) {
+        status = post_relative_motion(&lock, motions + i);
+        if (status != UIOHOOK_SUCCESS) {
+            break;
+        }
+    }
+
+    if (status == UIOHOOK_SUCCESS) {
+        status = flush_virtual_events(&lock);
+    } else if (status != UIOHOOK_ERROR_LINUX_WRITE_UINPUT) {
+        // The motion which couldn't be posted stops the batch, but the ones before it are still posted.
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Stopped posting at the motion with index %u.\n",
+                __FUNCTION__, __LINE__, i);
+
+        int flush_status = flush_virtual_events(&lock);
+        if (flush_status != UIOHOOK_SUCCESS) {
+            status = flush_status;
+        }
     }
 
-    unlock_virtual_devices();
+    unlock_virtual_devices(&lock);
 
     return status;
 }
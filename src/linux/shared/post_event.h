@@ -0,0 +1,14 @@
+#ifndef POST_EVENT_H
+#define POST_EVENT_H
+
+#include <stdint.h>
+
+#include <uiohook.h>
+
+/* Posts the events to the virtual devices of a set, and sets how many of them were posted. The public functions of
+ * the back-end resolve to the ones of the loader, which post through whichever back-end is published, so the threads
+ * of the back-end post through this instead. */
+__attribute__((visibility("hidden")))
+int post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size, uint32_t *posted);
+
+#endif
@@ -0,0 +1,372 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include <logger.h>
+#include <uiohook.h>
+
+#include "post_event.h"
+#include "timed_post.h"
+#include "uinput_helper.h"
+
+#define NS_PER_MS   1000000ULL
+#define NS_PER_S    1000000000ULL
+
+// Timer wake-ups are late by up to the timer slack, which is 50 us by default, so the timer fires this much
+// before the deadline and the rest of the wait is spent spinning.
+#define SPIN_NS     200000ULL
+
+typedef struct _timed_post {
+    uiohook_event *events;
+    uint32_t size;
+    post_progress_t progress_proc;
+    void *user_data;
+    int timer_fd;
+} timed_post;
+
+static pthread_mutex_t timed_post_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t timed_post_thread;
+static bool timed_post_joinable = false;
+static bool timed_post_active = false;
+static int cancel_fd = -1;
+
+static uint64_t get_monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static bool signal_cancel() {
+    uint64_t value = 1;
+
+    // The counter can only overflow if the post has already been canceled.
+    if (write(cancel_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to cancel posting the events: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool is_canceled() {
+    struct pollfd fd = { .fd = cancel_fd, .events = POLLIN };
+
+    return poll(&fd, 1, 0) > 0;
+}
+
+// Sleeps until the time without the timer, so the post can't be canceled in the meantime.
+static void sleep_until(uint64_t time) {
+    struct timespec ts = {
+        .tv_sec = time / NS_PER_S,
+        .tv_nsec = time % NS_PER_S
+    };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) { }
+}
+
+// Waits on the timer until the time unless the post is canceled first. Returns false if the timer can't be used.
+static bool wait_for_timer(int timer_fd, uint64_t time) {
+    struct itimerspec spec = {
+        .it_value = {
+            .tv_sec = time / NS_PER_S,
+            .tv_nsec = time % NS_PER_S
+        }
+    };
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to arm the timer: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        return false;
+    }
+
+    struct pollfd fds[] = {
+        { .fd = timer_fd, .events = POLLIN },
+        { .fd = cancel_fd, .events = POLLIN }
+    };
+
+    int result;
+    while ((result = poll(fds, 2, -1)) < 0 && errno == EINTR) { }
+
+    if (result < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to wait for the timer: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        return false;
+    }
+
+    if (fds[0].revents & POLLIN) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Failed to read the timer: %s\n",
+                    __FUNCTION__, __LINE__, strerrorname_np(errno));
+        }
+    }
+
+    return true;
+}
+
+// Waits until the deadline unless the post is canceled first. Returns false if it was canceled.
+static bool wait_until(int timer_fd, uint64_t deadline) {
+    uint64_t now = get_monotonic_ns();
+
+    if (deadline > now + SPIN_NS) {
+        uint64_t wake_up = deadline - SPIN_NS;
+
+        if (!wait_for_timer(timer_fd, wake_up)) {
+            // Spinning for the whole wait would keep a core busy, so the rest of it is slept through instead.
+            sleep_until(wake_up);
+        }
+
+        if (is_canceled()) {
+            return false;
+        }
+    }
+
+    // Reading the monotonic clock doesn't enter the kernel, so spinning on it is cheap enough for this long.
+    while (get_monotonic_ns() < deadline) { }
+
+    return !is_canceled();
+}
+
+static void *timed_post_proc(void *arg) {
+    timed_post *post = (timed_post *) arg;
+
+    uint64_t start = get_monotonic_ns();
+    uint64_t first_time = post->events[0].time;
+    uint64_t previous_offset = 0;
+
+    int status = UIOHOOK_SUCCESS;
+    uint32_t posted = 0;
+
+    while (posted < post->size && status == UIOHOOK_SUCCESS) {
+        uint64_t time = post->events[posted].time;
+
+        // An event which is older than the one before it is posted right after it.
+        uint64_t offset = time > first_time ? (time - first_time) * NS_PER_MS : 0;
+        if (offset < previous_offset) {
+            offset = previous_offset;
+        }
+
+        previous_offset = offset;
+
+        // Events which are due at the same time are posted together.
+        uint32_t count = 1;
+        while (posted + count < post->size && post->events[posted + count].time == time) {
+            count++;
+        }
+
+        if (!wait_until(post->timer_fd, start + offset)) {
+            status = UIOHOOK_ERROR_CANCELED;
+            break;
+        }
+
+        uint32_t batch_posted = 0;
+        status = post_events_on(VIRTUAL_DEVICE_SET_DEFAULT, post->events + posted, count, &batch_posted);
+        posted += batch_posted;
+
+        if (post->progress_proc != NULL && status == UIOHOOK_SUCCESS) {
+            post->progress_proc(posted, post->size, status, post->user_data);
+        }
+    }
+
+    if (status != UIOHOOK_SUCCESS) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Stopped posting after %u of %u events. (%#X)\n",
+                __FUNCTION__, __LINE__, posted, post->size, status);
+
+        if (post->progress_proc != NULL) {
+            post->progress_proc(posted, post->size, status, post->user_data);
+        }
+    }
+
+    pthread_mutex_lock(&timed_post_mutex);
+    timed_post_active = false;
+    pthread_mutex_unlock(&timed_post_mutex);
+
+    close(post->timer_fd);
+    free(post->events);
+    free(post);
+
+    return NULL;
+}
+
+int start_timed_post(uiohook_event *events, uint32_t size, post_progress_t progress_proc, void *user_data) {
+    pthread_mutex_lock(&timed_post_mutex);
+
+    if (timed_post_active) {
+        pthread_mutex_unlock(&timed_post_mutex);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Other events are already being posted!\n",
+                __FUNCTION__, __LINE__);
+
+        free(events);
+        return UIOHOOK_FAILURE;
+    }
+
+    // The previous thread has already finished, so this doesn't block.
+    if (timed_post_joinable) {
+        pthread_join(timed_post_thread, NULL);
+        timed_post_joinable = false;
+    }
+
+    if (cancel_fd < 0) {
+        cancel_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    } else {
+        // Forget a cancellation which came after the previous post had already finished.
+        uint64_t value;
+        if (read(cancel_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Failed to reset the cancellation: %s\n",
+                    __FUNCTION__, __LINE__, strerrorname_np(errno));
+        }
+    }
+
+    timed_post *post = malloc(sizeof(timed_post));
+    if (post == NULL) {
+        pthread_mutex_unlock(&timed_post_mutex);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the events!\n",
+                __FUNCTION__, __LINE__);
+
+        free(events);
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    *post = (timed_post) {
+        .events = events,
+        .size = size,
+        .progress_proc = progress_proc,
+        .user_data = user_data,
+        .timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)
+    };
+
+    if (cancel_fd < 0 || post->timer_fd < 0) {
+        pthread_mutex_unlock(&timed_post_mutex);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the timer: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        if (post->timer_fd >= 0) {
+            close(post->timer_fd);
+        }
+
+        free(post);
+        free(events);
+        return UIOHOOK_FAILURE;
+    }
+
+    int result = pthread_create(&timed_post_thread, NULL, timed_post_proc, post);
+    if (result != 0) {
+        pthread_mutex_unlock(&timed_post_mutex);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to start the posting thread: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(result));
+
+        close(post->timer_fd);
+        free(post);
+        free(events);
+        return UIOHOOK_FAILURE;
+    }
+
+    timed_post_joinable = true;
+    timed_post_active = true;
+
+    pthread_mutex_unlock(&timed_post_mutex);
+
+    return UIOHOOK_SUCCESS;
+}
+
+int hook_post_events_timed(uiohook_event * const events, uint32_t size, post_progress_t progress_proc,
+        void *user_data) {
+    if (events == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Not simulating any events as the events are null.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_NULL;
+    }
+
+    if (size == 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Not simulating any events as the size is 0.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_SUCCESS;
+    }
+
+    uiohook_event *copy = malloc(sizeof(uiohook_event) * size);
+    if (copy == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the events!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    memcpy(copy, events, sizeof(uiohook_event) * size);
+
+    return start_timed_post(copy, size, progress_proc, user_data);
+}
+
+int hook_cancel_post_events_timed() {
+    pthread_mutex_lock(&timed_post_mutex);
+
+    bool active = timed_post_active;
+    bool signaled = active && signal_cancel();
+
+    pthread_mutex_unlock(&timed_post_mutex);
+
+    if (!active) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: No events are being posted.\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_FAILURE;
+    }
+
+    return signaled ? UIOHOOK_SUCCESS : UIOHOOK_FAILURE;
+}
+
+bool is_timed_post_active() {
+    pthread_mutex_lock(&timed_post_mutex);
+    bool active = timed_post_active;
+    pthread_mutex_unlock(&timed_post_mutex);
+
+    return active;
+}
+
+void stop_timed_post() {
+    pthread_mutex_lock(&timed_post_mutex);
+
+    if (timed_post_active) {
+        signal_cancel();
+    }
+
+    bool joinable = timed_post_joinable;
+    timed_post_joinable = false;
+
+    pthread_mutex_unlock(&timed_post_mutex);
+
+    if (joinable) {
+        pthread_join(timed_post_thread, NULL);
+    }
+
+    if (cancel_fd >= 0) {
+        close(cancel_fd);
+        cancel_fd = -1;
+    }
+}
+
+__attribute__ ((destructor))
+static void on_library_unload() {
+    stop_timed_post();
+}
@@ -0,0 +1,19 @@
+#ifndef TIMED_POST_H
+#define TIMED_POST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <uiohook.h>
+
+/* Starts posting the events on the posting thread, keeping the intervals between their times. It takes over the
+ * events, which have to be allocated with malloc, and frees them even if it fails. */
+int start_timed_post(uiohook_event *events, uint32_t size, post_progress_t progress_proc, void *user_data);
+
+/* Checks whether events are being posted on the posting thread. */
+bool is_timed_post_active();
+
+/* Cancels the events which are being posted and joins the posting thread. */
+void stop_timed_post();
+
+#endif
@@ -1,16 +1,20 @@
 #define _GNU_SOURCE
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
 
 #include <libudev.h>
@@ -24,12 +28,9 @@
 #include "uinput_helper.h"
 
 #define UINPUT_PATH                 "/dev/uinput"
+#define INPUT_DEVICE_PATH           "/dev/input"
 #define VIRTUAL_INPUT_PATH          "/sys/devices/virtual/input/"
 
-// 0x7569 is 'ui' in ASCII.
-#define VIRTUAL_DEVICE_VENDOR       0x7569
-#define VIRTUAL_DEVICE_VERSION      0x0001
-
 #define VIRTUAL_KEYBOARD_TYPE       "virtual keyboard"
 #define VIRTUAL_KEYBOARD_PRODUCT    0x0001
 
@@ -41,45 +42,95 @@
 #define APPLICATION_NAME_MAX        ((int) (UINPUT_MAX_NAME_SIZE - sizeof(" " VIRTUAL_KEYBOARD_TYPE)))
 
 #define DEVICE_INIT_TIMEOUT_MS      2000
-#define DEVICE_INIT_POLL_MS         10
+
+// How long to wait for someone to open the event nodes once udev has announced them.
+#define DEVICE_OPEN_TIMEOUT_MS      100
 
 #define DEVICE_SETTLE_MS            100
 
+#define EVENT_NODE_PREFIX           "event"
+#define EVENT_NODE_NAME_MAX         32
+
+
 typedef struct _uinput_device {
     const char *type;
     uint16_t product;
     bool (*configure)(int fd);
+    pthread_mutex_t lock;
     int fd;
     char name[UINPUT_MAX_NAME_SIZE];
 } uinput_device;
 
+// Watches for the event nodes of the virtual devices to be announced by udev and then opened by their readers.
+// It has to be started before the devices are created, so that none of the notifications are missed.
+typedef struct _device_watch {
+    struct udev *udev;
+    struct udev_monitor *monitor;
+    int inotify_fd;
+} device_watch;
+
+// The default devices and each of the sets which are created on top of them have their own uinput devices and locks.
+struct _device_set {
+    uint8_t id;
+    bool created;
+    unsigned int reference_count;
+    uinput_device devices[VIRTUAL_DEVICE_COUNT];
+
+    // The procs which the devices were opened with, so that they're closed with the same ones. They're taken before
+    // the set can be locked, so posting never sees them change.
+    device_procs procs;
+
+    // Guarded by the lock of the virtual pointer of the set.
+    int32_t wheel_remainder[2];
+    double motion_remainder[2];
+};
+
+typedef struct _device_readiness {
+    char event_node[EVENT_NODE_NAME_MAX];
+    bool announced;
+    // How many times the node is open. udev closes the node again before it announces it, while a reader keeps it
+    // open, so this tells whether a reader has it no matter how the notifications of both are read.
+    int open_count;
+} device_readiness;
+
 static bool configure_keyboard(int fd);
 static bool configure_pointer(int fd);
 
-static uinput_device devices[] = {
-    [VIRTUAL_DEVICE_KEYBOARD] = {
-        .type = VIRTUAL_KEYBOARD_TYPE,
-        .product = VIRTUAL_KEYBOARD_PRODUCT,
-        .configure = configure_keyboard,
-        .fd = -1,
-        .name = DEFAULT_APPLICATION_NAME " " VIRTUAL_KEYBOARD_TYPE
-    },
-    [VIRTUAL_DEVICE_POINTER] = {
-        .type = VIRTUAL_POINTER_TYPE,
-        .product = VIRTUAL_POINTER_PRODUCT,
-        .configure = configure_pointer,
-        .fd = -1,
-        .name = DEFAULT_APPLICATION_NAME " " VIRTUAL_POINTER_TYPE
+static device_set default_set = {
+    .id = VIRTUAL_DEVICE_SET_DEFAULT,
+    .devices = {
+        [VIRTUAL_DEVICE_KEYBOARD] = {
+            .type = VIRTUAL_KEYBOARD_TYPE,
+            .product = VIRTUAL_KEYBOARD_PRODUCT,
+            .configure = configure_keyboard,
+            .lock = PTHREAD_MUTEX_INITIALIZER,
+            .fd = -1,
+            .name = DEFAULT_APPLICATION_NAME " " VIRTUAL_KEYBOARD_TYPE
+        },
+        [VIRTUAL_DEVICE_POINTER] = {
+            .type = VIRTUAL_POINTER_TYPE,
+            .product = VIRTUAL_POINTER_PRODUCT,
+            .configure = configure_pointer,
+            .lock = PTHREAD_MUTEX_INITIALIZER,
+            .fd = -1,
+            .name = DEFAULT_APPLICATION_NAME " " VIRTUAL_POINTER_TYPE
+        }
     }
 };
 
-#define DEVICE_COUNT (sizeof(devices) / sizeof(devices[0]))
-
-static pthread_mutex_t device_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Posting only needs a read lock, and each device has its own lock on top of it, so posting to different devices
+// doesn't block. Changing the sets needs the write lock, but creating the devices, which waits for their readers,
+// happens outside of it.
+static pthread_rwlock_t device_lock = PTHREAD_RWLOCK_INITIALIZER;
 
-static unsigned int reference_count = 0;
+// Guards the reference count of the default set while its devices are created or destroyed. It's taken before the
+// device lock.
+static pthread_mutex_t default_set_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static device_procs procs;
+// A set which is still being created is already here, so that its ID isn't taken twice, but it can't be posted to.
+static device_set *sets[VIRTUAL_DEVICE_SET_MAX + 1] = {
+    [VIRTUAL_DEVICE_SET_DEFAULT] = &default_set
+};
 
 static void sleep_ms(unsigned int milliseconds) {
     struct timespec ts = {
@@ -90,6 +141,13 @@ static void sleep_ms(unsigned int milliseconds) {
     nanosleep(&ts, NULL);
 }
 
+static uint64_t get_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 static bool configure_keyboard(int fd) {
     if (ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0
             || ioctl(fd, UI_SET_EVBIT, EV_MSC) < 0
@@ -145,11 +203,11 @@ static bool configure_pointer(int fd) {
     return true;
 }
 
-static int create_device(uinput_device *device, const char * const application_name) {
+static int create_device(const device_set *set, uinput_device *device, const char * const application_name) {
     snprintf(device->name, sizeof(device->name), "%.*s %s",
             APPLICATION_NAME_MAX, application_name, device->type);
 
-    int fd = open_device(&procs, UINPUT_PATH, O_WRONLY | O_NONBLOCK);
+    int fd = open_device(&set->procs, UINPUT_PATH, O_WRONLY | O_NONBLOCK);
 
     if (fd < 0) {
         if (-fd == EACCES) {
@@ -169,7 +227,7 @@ static int create_device(uinput_device *device, const char * const application_n
             .bustype = BUS_VIRTUAL,
             .vendor = VIRTUAL_DEVICE_VENDOR,
             .product = device->product,
-            .version = VIRTUAL_DEVICE_VERSION
+            .version = VIRTUAL_DEVICE_SET_VERSION(set->id)
         }
     };
 
@@ -179,7 +237,7 @@ static int create_device(uinput_device *device, const char * const application_n
         logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the %s: %s\n",
                 __FUNCTION__, __LINE__, device->name, strerrorname_np(errno));
 
-        close_device(&procs, fd);
+        close_device(&set->procs, fd);
         return UIOHOOK_ERROR_LINUX_CREATE_UINPUT_DEVICE;
     }
 
@@ -191,7 +249,7 @@ static int create_device(uinput_device *device, const char * const application_n
     return UIOHOOK_SUCCESS;
 }
 
-static void destroy_device(uinput_device *device) {
+static void destroy_device(const device_set *set, uinput_device *device) {
     if (device->fd < 0) {
         return;
     }
@@ -201,86 +259,320 @@ static void destroy_device(uinput_device *device) {
                 __FUNCTION__, __LINE__, device->name, strerrorname_np(errno));
     }
 
-    close_device(&procs, device->fd);
+    close_device(&set->procs, device->fd);
     device->fd = -1;
 
     logger(LOG_LEVEL_DEBUG, "%s [%u]: Destroyed the %s.\n",
             __FUNCTION__, __LINE__, device->name);
 }
 
-static void wait_for_device(struct udev *udev, const uinput_device *device) {
+static void start_device_watch(device_watch *watch) {
+    *watch = (device_watch) { .inotify_fd = -1 };
+
+    watch->udev = udev_new();
+    if (watch->udev == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to create a udev context!\n",
+                __FUNCTION__, __LINE__);
+
+        return;
+    }
+
+    watch->monitor = udev_monitor_new_from_netlink(watch->udev, "udev");
+    if (watch->monitor == NULL
+            || udev_monitor_filter_add_match_subsystem_devtype(watch->monitor, "input", NULL) < 0
+            || udev_monitor_enable_receiving(watch->monitor) < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to monitor udev for the virtual devices!\n",
+                __FUNCTION__, __LINE__);
+
+        if (watch->monitor != NULL) {
+            udev_monitor_unref(watch->monitor);
+            watch->monitor = NULL;
+        }
+
+        return;
+    }
+
+    // Watching the directory reports the nodes which are opened and closed in it, including the ones which don't exist
+    // yet.
+    watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->inotify_fd >= 0 && inotify_add_watch(watch->inotify_fd, INPUT_DEVICE_PATH, IN_OPEN | IN_CLOSE) < 0) {
+        close(watch->inotify_fd);
+        watch->inotify_fd = -1;
+    }
+
+    if (watch->inotify_fd < 0) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Cannot watch %s, so the devices won't be checked for readers: %s\n",
+                __FUNCTION__, __LINE__, INPUT_DEVICE_PATH, strerrorname_np(errno));
+    }
+}
+
+static void stop_device_watch(device_watch *watch) {
+    if (watch->inotify_fd >= 0) {
+        close(watch->inotify_fd);
+    }
+
+    if (watch->monitor != NULL) {
+        udev_monitor_unref(watch->monitor);
+    }
+
+    if (watch->udev != NULL) {
+        udev_unref(watch->udev);
+    }
+
+    *watch = (device_watch) { .inotify_fd = -1 };
+}
+
+// The kernel creates the event node as a part of creating the device, so it's already in sysfs.
+static bool find_event_node(const uinput_device *device, char *event_node) {
     char sysname[32] = {};
 
     if (ioctl(device->fd, UI_GET_SYSNAME(sizeof(sysname) - 1), sysname) < 0) {
         logger(LOG_LEVEL_WARN, "%s [%u]: Failed to get the sys name of the %s: %s\n",
                 __FUNCTION__, __LINE__, device->name, strerrorname_np(errno));
 
-        return;
+        return false;
     }
 
     char syspath[sizeof(VIRTUAL_INPUT_PATH) + sizeof(sysname)];
     snprintf(syspath, sizeof(syspath), "%s%s", VIRTUAL_INPUT_PATH, sysname);
 
-    for (unsigned int elapsed = 0; elapsed < DEVICE_INIT_TIMEOUT_MS; elapsed += DEVICE_INIT_POLL_MS) {
-        struct udev_device *udev_device = udev_device_new_from_syspath(udev, syspath);
-        bool initialized = udev_device != NULL && udev_device_get_is_initialized(udev_device);
+    DIR *dir = opendir(syspath);
+    if (dir == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to open %s: %s\n",
+                __FUNCTION__, __LINE__, syspath, strerrorname_np(errno));
 
-        if (udev_device != NULL) {
-            udev_device_unref(udev_device);
+        return false;
+    }
+
+    bool found = false;
+
+    struct dirent *entry;
+    while (!found && (entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, EVENT_NODE_PREFIX, sizeof(EVENT_NODE_PREFIX) - 1) == 0
+                && strlen(entry->d_name) < EVENT_NODE_NAME_MAX) {
+            strcpy(event_node, entry->d_name);
+            found = true;
         }
+    }
 
-        if (initialized) {
-            return;
+    closedir(dir);
+
+    if (!found) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: The %s has no event node!\n",
+                __FUNCTION__, __LINE__, device->name);
+    }
+
+    return found;
+}
+
+static device_readiness *find_readiness(device_readiness *readiness, const char *event_node) {
+    for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+        if (strcmp(readiness[i].event_node, event_node) == 0) {
+            return &readiness[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void receive_announcements(device_watch *watch, device_readiness *readiness) {
+    struct udev_device *udev_device;
+
+    while ((udev_device = udev_monitor_receive_device(watch->monitor)) != NULL) {
+        const char *action = udev_device_get_action(udev_device);
+        const char *sysname = udev_device_get_sysname(udev_device);
+
+        if (action != NULL && sysname != NULL && strcmp(action, "add") == 0) {
+            device_readiness *device = find_readiness(readiness, sysname);
+            if (device != NULL) {
+                device->announced = true;
+            }
         }
 
-        sleep_ms(DEVICE_INIT_POLL_MS);
+        udev_device_unref(udev_device);
     }
+}
 
-    logger(LOG_LEVEL_WARN, "%s [%u]: Timed out waiting for udev to initialize the %s.\n",
-            __FUNCTION__, __LINE__, device->name);
+static void receive_opens(device_watch *watch, device_readiness *readiness) {
+    if (watch->inotify_fd < 0) {
+        return;
+    }
+
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    ssize_t length;
+    while ((length = read(watch->inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *position = buffer; position < buffer + length; ) {
+            struct inotify_event *event = (struct inotify_event *) position;
+
+            device_readiness *device = event->len > 0 ? find_readiness(readiness, event->name) : NULL;
+            if (device != NULL) {
+                if (event->mask & IN_OPEN) {
+                    device->open_count++;
+                }
+
+                // A node whose name is reused may still be closed by a reader of the device which had it before.
+                if ((event->mask & IN_CLOSE) && device->open_count > 0) {
+                    device->open_count--;
+                }
+            }
+
+            position += sizeof(struct inotify_event) + event->len;
+        }
+    }
 }
 
-static void wait_for_devices() {
-    struct udev *udev = udev_new();
+static void wait_for_devices(device_watch *watch, const device_set *set) {
+    if (watch->monitor == NULL) {
+        // Nothing tells when the devices are ready, so give their readers some time to pick them up.
+        sleep_ms(DEVICE_SETTLE_MS);
+        return;
+    }
+
+    device_readiness readiness[VIRTUAL_DEVICE_COUNT] = {};
+
+    uint64_t start = get_time_ms();
+    uint64_t settle_deadline = 0;
+
+    for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+        if (!find_event_node(&set->devices[i], readiness[i].event_node)) {
+            // There's nothing to match the notifications against, so the readers are given the same time as
+            // when nothing tells when the devices are ready.
+            readiness[i].announced = true;
+            readiness[i].open_count = 1;
+            settle_deadline = start + DEVICE_SETTLE_MS;
+        }
+    }
+
+    uint64_t announce_deadline = start + DEVICE_INIT_TIMEOUT_MS;
+    uint64_t open_deadline = 0;
+
+    while (true) {
+        bool announced = true;
+        bool opened = true;
+
+        for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+            announced = announced && readiness[i].announced;
+            opened = opened && readiness[i].open_count > 0;
+        }
+
+        uint64_t now = get_time_ms();
+
+        // Without the inotify watch, the readers are just given until the deadline to open the nodes.
+        if (announced && opened) {
+            if (now < settle_deadline) {
+                sleep_ms((unsigned int) (settle_deadline - now));
+            }
+
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: The virtual devices are ready.\n",
+                    __FUNCTION__, __LINE__);
+
+            return;
+        }
+
+        if (announced && open_deadline == 0) {
+            open_deadline = now + DEVICE_OPEN_TIMEOUT_MS;
+        }
+
+        uint64_t deadline = announced ? open_deadline : announce_deadline;
+        if (now >= deadline) {
+            if (announced) {
+                logger(LOG_LEVEL_DEBUG, "%s [%u]: Nothing has opened the virtual devices yet.\n",
+                        __FUNCTION__, __LINE__);
+            } else {
+                logger(LOG_LEVEL_WARN, "%s [%u]: Timed out waiting for udev to initialize the virtual devices.\n",
+                        __FUNCTION__, __LINE__);
+            }
+
+            return;
+        }
+
+        struct pollfd fds[] = {
+            { .fd = udev_monitor_get_fd(watch->monitor), .events = POLLIN },
+            { .fd = watch->inotify_fd, .events = POLLIN }
+        };
+
+        // A negative descriptor is ignored by poll.
+        if (poll(fds, sizeof(fds) / sizeof(fds[0]), (int) (deadline - now)) < 0 && errno != EINTR) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Failed to wait for the virtual devices: %s\n",
+                    __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            receive_announcements(watch, readiness);
+        }
 
-    if (udev != NULL) {
-        for (unsigned int i = 0; i < DEVICE_COUNT; i++) {
-            wait_for_device(udev, &devices[i]);
+        if (fds[1].revents & POLLIN) {
+            receive_opens(watch, readiness);
         }
+    }
+}
 
-        udev_unref(udev);
+// Creates the devices of a set which can't be locked yet, so the device lock isn't needed.
+static int create_set_devices(device_set *set, const char * const application_name) {
+    const char *name = application_name != NULL && application_name[0] != '\0'
+        ? application_name
+        : DEFAULT_APPLICATION_NAME;
+
+    set->procs = get_device_procs();
+
+    device_watch watch;
+    start_device_watch(&watch);
+
+    int status = UIOHOOK_SUCCESS;
+
+    for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT && status == UIOHOOK_SUCCESS; i++) {
+        status = create_device(set, &set->devices[i], name);
+    }
+
+    if (status == UIOHOOK_SUCCESS) {
+        wait_for_devices(&watch, set);
     } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to create a udev context!\n",
-                __FUNCTION__, __LINE__);
+        for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+            destroy_device(set, &set->devices[i]);
+        }
+    }
+
+    stop_device_watch(&watch);
+
+    return status;
+}
+
+static void destroy_set_devices(device_set *set) {
+    for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+        destroy_device(set, &set->devices[i]);
+    }
+}
+
+static void free_set(device_set *set) {
+    for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+        pthread_mutex_destroy(&set->devices[i].lock);
     }
 
-    sleep_ms(DEVICE_SETTLE_MS);
+    free(set);
 }
 
 int create_virtual_devices(const char * const application_name) {
-    pthread_mutex_lock(&device_mutex);
+    pthread_mutex_lock(&default_set_mutex);
 
     int status = UIOHOOK_SUCCESS;
 
-    if (reference_count == 0) {
-        const char *name = application_name != NULL && application_name[0] != '\0'
-            ? application_name
-            : DEFAULT_APPLICATION_NAME;
+    if (default_set.reference_count == 0) {
+        // The new devices don't carry over what the previous ones hadn't posted yet. Nothing can lock the set until
+        // it's created, so the devices are created without the device lock, which would block the other sets.
+        memset(default_set.wheel_remainder, 0, sizeof(default_set.wheel_remainder));
+        memset(default_set.motion_remainder, 0, sizeof(default_set.motion_remainder));
 
-        procs = get_device_procs();
-
-        for (unsigned int i = 0; i < DEVICE_COUNT && status == UIOHOOK_SUCCESS; i++) {
-            status = create_device(&devices[i], name);
-        }
+        status = create_set_devices(&default_set, application_name);
 
         if (status == UIOHOOK_SUCCESS) {
-            wait_for_devices();
-        } else {
-            for (unsigned int i = 0; i < DEVICE_COUNT; i++) {
-                destroy_device(&devices[i]);
-            }
+            pthread_rwlock_wrlock(&device_lock);
+            default_set.created = true;
+            pthread_rwlock_unlock(&device_lock);
         }
-    } else if (reference_count == UINT_MAX) {
+    } else if (default_set.reference_count == UINT_MAX) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Virtual device reference count overflow detected!\n",
                 __FUNCTION__, __LINE__);
 
@@ -288,52 +580,245 @@ int create_virtual_devices(const char * const application_name) {
     }
 
     if (status == UIOHOOK_SUCCESS) {
-        reference_count++;
+        default_set.reference_count++;
     }
 
-    pthread_mutex_unlock(&device_mutex);
+    pthread_mutex_unlock(&default_set_mutex);
 
     return status;
 }
 
 int destroy_virtual_devices() {
-    pthread_mutex_lock(&device_mutex);
+    pthread_mutex_lock(&default_set_mutex);
 
-    if (reference_count > 0) {
-        reference_count--;
+    if (default_set.reference_count > 0) {
+        default_set.reference_count--;
 
-        if (reference_count == 0) {
-            for (unsigned int i = 0; i < DEVICE_COUNT; i++) {
-                destroy_device(&devices[i]);
-            }
+        if (default_set.reference_count == 0) {
+            pthread_rwlock_wrlock(&device_lock);
+            default_set.created = false;
+            pthread_rwlock_unlock(&device_lock);
+
+            // Everyone who had locked the set has unlocked it before the write lock was taken.
+            destroy_set_devices(&default_set);
         }
     }
 
-    pthread_mutex_unlock(&device_mutex);
+    pthread_mutex_unlock(&default_set_mutex);
 
     return UIOHOOK_SUCCESS;
 }
 
-int lock_virtual_devices() {
-    pthread_mutex_lock(&device_mutex);
+int create_virtual_device_set(const char * const application_name, uint8_t *set_id) {
+    pthread_rwlock_wrlock(&device_lock);
+
+    // The lowest free ID is taken.
+    uint8_t id = VIRTUAL_DEVICE_SET_DEFAULT;
+    for (unsigned int i = VIRTUAL_DEVICE_SET_MAX; i > VIRTUAL_DEVICE_SET_DEFAULT; i--) {
+        if (sets[i] == NULL) {
+            id = (uint8_t) i;
+        }
+    }
+
+    if (id == VIRTUAL_DEVICE_SET_DEFAULT) {
+        pthread_rwlock_unlock(&device_lock);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: All of the %u virtual device sets are in use!\n",
+                __FUNCTION__, __LINE__, VIRTUAL_DEVICE_SET_MAX);
+
+        return UIOHOOK_FAILURE;
+    }
 
-    if (reference_count == 0) {
-        pthread_mutex_unlock(&device_mutex);
+    device_set *set = malloc(sizeof(device_set));
+    if (set == NULL) {
+        pthread_rwlock_unlock(&device_lock);
 
-        logger(LOG_LEVEL_ERROR, "%s [%u]: The virtual devices are not initialized!\n",
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the virtual device set!\n",
                 __FUNCTION__, __LINE__);
 
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    *set = (device_set) { .id = id };
+
+    for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+        set->devices[i] = (uinput_device) {
+            .type = default_set.devices[i].type,
+            .product = default_set.devices[i].product,
+            .configure = default_set.devices[i].configure,
+            .fd = -1
+        };
+
+        pthread_mutex_init(&set->devices[i].lock, NULL);
+    }
+
+    sets[id] = set;
+
+    pthread_rwlock_unlock(&device_lock);
+
+    // Creating the devices waits for their readers, so the other sets are not locked in the meantime.
+    int status = create_set_devices(set, application_name);
+
+    pthread_rwlock_wrlock(&device_lock);
+
+    if (status == UIOHOOK_SUCCESS) {
+        set->created = true;
+    } else {
+        sets[id] = NULL;
+    }
+
+    pthread_rwlock_unlock(&device_lock);
+
+    if (status != UIOHOOK_SUCCESS) {
+        free_set(set);
+        return status;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Created the virtual device set %u.\n",
+            __FUNCTION__, __LINE__, id);
+
+    *set_id = id;
+
+    return UIOHOOK_SUCCESS;
+}
+
+int destroy_virtual_device_set(uint8_t set_id) {
+    if (set_id == VIRTUAL_DEVICE_SET_DEFAULT) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: The default virtual devices are not a set which can be destroyed!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_FAILURE;
+    }
+
+    pthread_rwlock_wrlock(&device_lock);
+
+    device_set *set = sets[set_id];
+    if (set == NULL || !set->created) {
+        pthread_rwlock_unlock(&device_lock);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: The virtual device set %u does not exist!\n",
+                __FUNCTION__, __LINE__, set_id);
+
         return UIOHOOK_ERROR_LINUX_VIRTUAL_DEVICES_NOT_INITIALIZED;
     }
 
+    sets[set_id] = NULL;
+
+    pthread_rwlock_unlock(&device_lock);
+
+    // The set can't be locked any more, and everyone who had locked it has unlocked it before the write lock was taken.
+    destroy_set_devices(set);
+    free_set(set);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Destroyed the virtual device set %u.\n",
+            __FUNCTION__, __LINE__, set_id);
+
+    return UIOHOOK_SUCCESS;
+}
+
+int lock_virtual_devices(virtual_devices_lock *lock, uint8_t set_id, uint32_t device_mask) {
+    pthread_rwlock_rdlock(&device_lock);
+
+    device_set *set = sets[set_id];
+    if (set == NULL || !set->created) {
+        pthread_rwlock_unlock(&device_lock);
+
+        if (set_id == VIRTUAL_DEVICE_SET_DEFAULT) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: The virtual devices are not initialized!\n",
+                    __FUNCTION__, __LINE__);
+        } else {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: The virtual device set %u does not exist!\n",
+                    __FUNCTION__, __LINE__, set_id);
+        }
+
+        return UIOHOOK_ERROR_LINUX_VIRTUAL_DEVICES_NOT_INITIALIZED;
+    }
+
+    // The devices are always locked in the same order, so callers which lock both of them can't deadlock.
+    for (unsigned int i = 0; i < VIRTUAL_DEVICE_COUNT; i++) {
+        if (device_mask & VIRTUAL_DEVICE_MASK(i)) {
+            pthread_mutex_lock(&set->devices[i].lock);
+        }
+    }
+
+    lock->set = set;
+    lock->device_mask = device_mask;
+    lock->queue_count = 0;
+    lock->queue_capacity = VIRTUAL_QUEUE_INLINE;
+    lock->queue = lock->queue_inline;
+
     return UIOHOOK_SUCCESS;
 }
 
-void unlock_virtual_devices() {
-    pthread_mutex_unlock(&device_mutex);
+void unlock_virtual_devices(virtual_devices_lock *lock) {
+    if (lock->queue_count > 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Dropping %zu queued events which were not written.\n",
+                __FUNCTION__, __LINE__, lock->queue_count);
+
+        lock->queue_count = 0;
+    }
+
+    if (lock->queue != lock->queue_inline) {
+        free(lock->queue);
+        lock->queue = lock->queue_inline;
+        lock->queue_capacity = VIRTUAL_QUEUE_INLINE;
+    }
+
+    for (unsigned int i = VIRTUAL_DEVICE_COUNT; i > 0; i--) {
+        if (lock->device_mask & VIRTUAL_DEVICE_MASK(i - 1)) {
+            pthread_mutex_unlock(&lock->set->devices[i - 1].lock);
+        }
+    }
+
+    lock->set = NULL;
+    lock->device_mask = 0;
+
+    pthread_rwlock_unlock(&device_lock);
+}
+
+int32_t *get_virtual_wheel_remainder(virtual_devices_lock *lock) {
+    return lock->set->wheel_remainder;
+}
+
+double *get_virtual_motion_remainder(virtual_devices_lock *lock) {
+    return lock->set->motion_remainder;
 }
 
-int post_virtual_events(virtual_device device, const virtual_event *events, size_t count) {
+// Makes room for more events in the queue, and returns false if it can't grow.
+static bool grow_virtual_queue(virtual_devices_lock *lock, size_t count) {
+    if (lock->queue_count + count <= lock->queue_capacity) {
+        return true;
+    }
+
+    size_t capacity = lock->queue_capacity * 2;
+    while (capacity < lock->queue_count + count) {
+        capacity *= 2;
+    }
+
+    struct input_event *queue;
+    if (lock->queue == lock->queue_inline) {
+        queue = malloc(sizeof(struct input_event) * capacity);
+        if (queue != NULL) {
+            memcpy(queue, lock->queue, sizeof(struct input_event) * lock->queue_count);
+        }
+    } else {
+        queue = realloc(lock->queue, sizeof(struct input_event) * capacity);
+    }
+
+    if (queue == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to grow the queue to %zu events, so it's written out first.\n",
+                __FUNCTION__, __LINE__, capacity);
+
+        return false;
+    }
+
+    lock->queue = queue;
+    lock->queue_capacity = capacity;
+
+    return true;
+}
+
+int queue_virtual_events(virtual_devices_lock *lock, virtual_device device, const virtual_event *events, size_t count) {
     if (count > VIRTUAL_EVENT_MAX) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Cannot write %zu events as a single report!\n",
                 __FUNCTION__, __LINE__, count);
@@ -341,52 +826,142 @@ int post_virtual_events(virtual_device device, const virtual_event *events, size
         return UIOHOOK_FAILURE;
     }
 
-    struct input_event input_events[VIRTUAL_EVENT_MAX + 1] = {};
+    if (!(lock->device_mask & VIRTUAL_DEVICE_MASK(device))) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: The %s is not locked!\n",
+                __FUNCTION__, __LINE__, lock->set->devices[device].name);
 
-    for (size_t i = 0; i < count; i++) {
-        input_events[i].type = events[i].type;
-        input_events[i].code = events[i].code;
-        input_events[i].value = events[i].value;
+        return UIOHOOK_FAILURE;
     }
 
-    input_events[count].type = EV_SYN;
-    input_events[count].code = SYN_REPORT;
-
-    size_t size = sizeof(struct input_event) * (count + 1);
+    // A report is never split between writes, and the reports for both devices have to be written in order.
+    if (lock->queue_count > 0 && (lock->queue_device != device || !grow_virtual_queue(lock, count + 1))) {
+        int status = flush_virtual_events(lock);
+        if (status != UIOHOOK_SUCCESS) {
+            return status;
+        }
+    }
 
-    if (write(devices[device].fd, input_events, size) != (ssize_t) size) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to write to the %s: %s\n",
-                __FUNCTION__, __LINE__, devices[device].name, strerrorname_np(errno));
+    lock->queue_device = device;
 
-        return UIOHOOK_ERROR_LINUX_WRITE_UINPUT;
+    for (size_t i = 0; i < count; i++) {
+        lock->queue[lock->queue_count++] = (struct input_event) {
+            .type = events[i].type,
+            .code = events[i].code,
+            .value = events[i].value
+        };
     }
 
+    lock->queue[lock->queue_count++] = (struct input_event) {
+        .type = EV_SYN,
+        .code = SYN_REPORT
+    };
+
     return UIOHOOK_SUCCESS;
 }
 
-int post_virtual_key(uint16_t evdev_code, bool pressed) {
+int queue_virtual_key(virtual_devices_lock *lock, uint16_t evdev_code, bool pressed) {
     virtual_event events[] = {
         { .type = EV_MSC, .code = MSC_SCAN, .value = evdev_code },
         { .type = EV_KEY, .code = evdev_code, .value = pressed ? 1 : 0 }
     };
 
-    return post_virtual_events(VIRTUAL_DEVICE_KEYBOARD, events, sizeof(events) / sizeof(events[0]));
+    return queue_virtual_events(lock, VIRTUAL_DEVICE_KEYBOARD, events, sizeof(events) / sizeof(events[0]));
 }
 
-__attribute__((destructor))
-static void unload_virtual_devices() {
-    pthread_mutex_lock(&device_mutex);
+bool virtual_events_queued(const virtual_devices_lock *lock) {
+    return lock->queue_count > 0;
+}
+
+int flush_virtual_events(virtual_devices_lock *lock) {
+    if (lock->queue_count == 0) {
+        return UIOHOOK_SUCCESS;
+    }
+
+    const uinput_device *device = &lock->set->devices[lock->queue_device];
+
+    size_t size = sizeof(struct input_event) * lock->queue_count;
+    ssize_t written = write(device->fd, lock->queue, size);
+
+    // The queue is dropped even if the write fails, so that a broken device doesn't fail every later post.
+    lock->queue_count = 0;
+
+    if (written != (ssize_t) size) {
+        if (written < 0) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to write to the %s: %s\n",
+                    __FUNCTION__, __LINE__, device->name, strerrorname_np(errno));
+        } else {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Only %zu of %zu bytes were written to the %s!\n",
+                    __FUNCTION__, __LINE__, (size_t) written, size, device->name);
+        }
+
+        return UIOHOOK_ERROR_LINUX_WRITE_UINPUT;
+    }
+
+    return UIOHOOK_SUCCESS;
+}
+
+int post_virtual_events(virtual_devices_lock *lock, virtual_device device, const virtual_event *events, size_t count) {
+    int status = queue_virtual_events(lock, device, events, count);
+    if (status == UIOHOOK_SUCCESS) {
+        status = flush_virtual_events(lock);
+    }
+
+    return status;
+}
+
+int post_virtual_key(virtual_devices_lock *lock, uint16_t evdev_code, bool pressed) {
+    int status = queue_virtual_key(lock, evdev_code, pressed);
+    if (status == UIOHOOK_SUCCESS) {
+        status = flush_virtual_events(lock);
+    }
 
-    if (reference_count > 0) {
+    return status;
+}
+
+bool virtual_device_sets_exist() {
+    pthread_rwlock_rdlock(&device_lock);
+
+    bool exist = false;
+    for (unsigned int i = VIRTUAL_DEVICE_SET_DEFAULT + 1; i <= VIRTUAL_DEVICE_SET_MAX && !exist; i++) {
+        exist = sets[i] != NULL;
+    }
+
+    pthread_rwlock_unlock(&device_lock);
+
+    return exist;
+}
+
+void destroy_all_virtual_devices() {
+    pthread_mutex_lock(&default_set_mutex);
+    pthread_rwlock_wrlock(&device_lock);
+
+    if (default_set.reference_count > 0) {
         logger(LOG_LEVEL_WARN, "%s [%u]: The virtual devices were not destroyed!\n",
                 __FUNCTION__, __LINE__);
 
-        reference_count = 0;
+        default_set.reference_count = 0;
+        default_set.created = false;
+
+        destroy_set_devices(&default_set);
+    }
+
+    for (unsigned int i = VIRTUAL_DEVICE_SET_DEFAULT + 1; i <= VIRTUAL_DEVICE_SET_MAX; i++) {
+        // A set which is still being created belongs to the thread which creates it.
+        if (sets[i] != NULL && sets[i]->created) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: The virtual device set %u was not destroyed!\n",
+                    __FUNCTION__, __LINE__, i);
 
-        for (unsigned int i = 0; i < DEVICE_COUNT; i++) {
-            destroy_device(&devices[i]);
+            destroy_set_devices(sets[i]);
+            free_set(sets[i]);
+            sets[i] = NULL;
         }
     }
 
-    pthread_mutex_unlock(&device_mutex);
+    pthread_rwlock_unlock(&device_lock);
+    pthread_mutex_unlock(&default_set_mutex);
+}
+
+__attribute__((destructor))
+static void unload_virtual_devices() {
+    destroy_all_virtual_devices();
 }
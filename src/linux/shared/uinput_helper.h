@@ -5,20 +5,55 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <linux/input.h>
+
 #define VIRTUAL_EVENT_MAX 4
 #define ABSOLUTE_AXIS_MAX 65535
 
+// The queued reports of a device are written with a single write. evdev hands them to its readers at every SYN_REPORT
+// either way, so splitting them up wouldn't keep a slow reader from dropping events, and would only cost more writes.
+// The queue starts out in the lock, which covers a single event, and only a larger batch moves it to the heap.
+#define VIRTUAL_QUEUE_INLINE 16
+
+// 0x7569 is 'ui' in ASCII.
+#define VIRTUAL_DEVICE_VENDOR       0x7569
+#define VIRTUAL_DEVICE_VERSION      0x0001
+
+#define VIRTUAL_DEVICE_SET_DEFAULT  0
+#define VIRTUAL_DEVICE_SET_MAX      UINT8_MAX
+
+// The set of a virtual device is stored in the high byte of its version, so that the hook can tell the sets apart.
+#define VIRTUAL_DEVICE_SET_VERSION(set_id)  ((uint16_t) ((set_id) << 8 | VIRTUAL_DEVICE_VERSION))
+#define VIRTUAL_DEVICE_VERSION_SET(version) ((uint8_t) ((version) >> 8))
+
 typedef enum _virtual_device {
     VIRTUAL_DEVICE_KEYBOARD,
-    VIRTUAL_DEVICE_POINTER
+    VIRTUAL_DEVICE_POINTER,
+    VIRTUAL_DEVICE_COUNT
 } virtual_device;
 
+#define VIRTUAL_DEVICE_MASK(device) (1u << (device))
+#define VIRTUAL_DEVICES_ALL (VIRTUAL_DEVICE_MASK(VIRTUAL_DEVICE_KEYBOARD) | VIRTUAL_DEVICE_MASK(VIRTUAL_DEVICE_POINTER))
+
 typedef struct _virtual_event {
     uint16_t type;
     uint16_t code;
     int32_t value;
 } virtual_event;
 
+typedef struct _device_set device_set;
+
+/* The devices which a caller has locked, and the reports which it has queued for them. */
+typedef struct _virtual_devices_lock {
+    device_set *set;
+    uint32_t device_mask;
+    virtual_device queue_device;
+    size_t queue_count;
+    size_t queue_capacity;
+    struct input_event *queue;
+    struct input_event queue_inline[VIRTUAL_QUEUE_INLINE];
+} virtual_devices_lock;
+
 /* Creates the virtual devices if they don't exist yet, and increments their reference count.
  * The application name is only used when the devices are actually created. */
 int create_virtual_devices(const char * const application_name);
@@ -26,16 +61,50 @@ int create_virtual_devices(const char * const application_name);
 /* Decrements the reference count of the virtual devices, and destroys them when it reaches zero. */
 int destroy_virtual_devices();
 
-/* Locks the virtual devices for posting, and fails if they are not initialized. */
-int lock_virtual_devices();
+/* Creates a set of virtual devices which is independent of the default ones, and returns its ID. */
+int create_virtual_device_set(const char * const application_name, uint8_t *set_id);
+
+/* Destroys a set of virtual devices. It waits for the set to be unlocked first. */
+int destroy_virtual_device_set(uint8_t set_id);
+
+/* Checks whether any sets other than the default one exist. */
+bool virtual_device_sets_exist();
+
+/* Destroys the default virtual devices and every set, no matter how many times they were created. */
+void destroy_all_virtual_devices();
+
+/* Locks the virtual devices of a set in the mask for posting, and fails if the set is not initialized.
+ * Posting to a device which isn't locked fails. */
+int lock_virtual_devices(virtual_devices_lock *lock, uint8_t set_id, uint32_t device_mask);
+
+/* Unlocks the virtual devices and frees the queue. Reports which are still queued are dropped. */
+void unlock_virtual_devices(virtual_devices_lock *lock);
+
+/* Writes events to a virtual device, followed by a report. */
+int post_virtual_events(virtual_devices_lock *lock, virtual_device device, const virtual_event *events, size_t count);
+
+/* Presses or releases a key on the virtual keyboard. */
+int post_virtual_key(virtual_devices_lock *lock, uint16_t evdev_code, bool pressed);
+
+/* Queues events for a virtual device, followed by a report. Queued reports are written together, but they are
+ * written out first when a report for the other device is queued, or when the queue can't grow. */
+int queue_virtual_events(virtual_devices_lock *lock, virtual_device device, const virtual_event *events, size_t count);
+
+/* Queues a key press or release for the virtual keyboard. */
+int queue_virtual_key(virtual_devices_lock *lock, uint16_t evdev_code, bool pressed);
+
+/* Checks whether any reports are queued and not written yet. */
+bool virtual_events_queued(const virtual_devices_lock *lock);
 
-/* Unlocks the virtual devices. */
-void unlock_virtual_devices();
+/* Writes the queued reports. */
+int flush_virtual_events(virtual_devices_lock *lock);
 
-/* Writes events to a virtual device, followed by a report. The devices must be locked. */
-int post_virtual_events(virtual_device device, const virtual_event *events, size_t count);
+/* Gets the vertical and horizontal wheel rotation which the locked set has not posted as a whole click yet.
+ * It is guarded by the lock of the virtual pointer. */
+int32_t *get_virtual_wheel_remainder(virtual_devices_lock *lock);
 
-/* Presses or releases a key on the virtual keyboard. The devices must be locked. */
-int post_virtual_key(uint16_t evdev_code, bool pressed);
+/* Gets the horizontal and vertical movement which the locked set has not posted as a whole pixel yet.
+ * It is guarded by the lock of the virtual pointer. */
+double *get_virtual_motion_remainder(virtual_devices_lock *lock);
 
 #endif
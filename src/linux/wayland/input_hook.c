@@ -5,36 +5,104 @@
 #include <uiohook.h>
 
 #include "backend.h"
+#include "input_helper.h"
 #include "input_loop.h"
+#include "keymap_helper.h"
 #include "monitor_helper.h"
 #include "wayland_helper.h"
 
 size_t backend_key_to_unicode(uint16_t evdev_code, uint16_t modifier_mask, uint16_t *buffer, size_t length) {
-    // Key typed events are not supported by this back-end.
-    return 0;
+    return keymap_helper_key_to_unicode(evdev_code, modifier_mask, buffer, length);
+}
+
+void backend_update_key_state(uint16_t evdev_code, bool pressed) {
+    keymap_helper_update_key(evdev_code, pressed, get_modifiers());
+}
+
+// Wayland exposes no way to query the pointer position, so it's estimated from the motion which the hook sees.
+// The estimate is only used on the hook thread.
+static double pointer_x = 0.0;
+static double pointer_y = 0.0;
+static bool pointer_estimated = false;
+
+static int16_t round_to_int16(double value) {
+    return (int16_t) (value + (value >= 0 ? 0.5 : -0.5));
+}
+
+static bool start_pointer_estimate() {
+    uint16_t width, height;
+    if (wayland_helper_get_state() != WAYLAND_HELPER_READY || !monitor_helper_get_desktop_bounds(&width, &height)) {
+        return false;
+    }
+
+    // Compositors usually start with the pointer in the middle, and the first absolute event corrects it anyway.
+    pointer_x = width / 2.0;
+    pointer_y = height / 2.0;
+    monitor_helper_clamp_position(&pointer_x, &pointer_y);
+
+    pointer_estimated = true;
+
+    return true;
 }
 
 bool backend_get_pointer_position(int16_t *x, int16_t *y) {
-    // Wayland exposes no way to query the pointer position.
-    return false;
+    if (!pointer_estimated && !start_pointer_estimate()) {
+        return false;
+    }
+
+    *x = round_to_int16(pointer_x);
+    *y = round_to_int16(pointer_y);
+
+    return true;
 }
 
-bool backend_get_desktop_bounds(uint16_t *width, uint16_t *height) {
-    return wayland_helper_init() && monitor_helper_get_desktop_bounds(width, height);
+void backend_track_pointer_motion(double dx, double dy) {
+    if (!pointer_estimated && !start_pointer_estimate()) {
+        return;
+    }
+
+    // The motion is accelerated with the default settings of libinput, which the compositor may have changed,
+    // so the estimate drifts until it's reset by an absolute event.
+    pointer_x += dx;
+    pointer_y += dy;
+
+    monitor_helper_clamp_position(&pointer_x, &pointer_y);
 }
 
-void backend_adjust_absolute_position(int16_t *x, int16_t *y) {
-    // Absolute positions are already in the coordinate space which Wayland reports.
+void backend_track_pointer_position(int16_t x, int16_t y) {
+    // Absolute events include the moves which are posted through the virtual absolute pointer.
+    pointer_x = x;
+    pointer_y = y;
+    pointer_estimated = true;
 }
 
-void backend_restore_absolute_position(int16_t *x, int16_t *y) {
+bool backend_get_desktop_geometry(desktop_geometry *geometry, bool wait) {
     // Absolute positions are already in the coordinate space which Wayland reports.
+    geometry->origin_x = 0;
+    geometry->origin_y = 0;
+
+    bool ready = wait ? wayland_helper_init() : wayland_helper_get_state() == WAYLAND_HELPER_READY;
+
+    return ready && monitor_helper_get_desktop_bounds(&geometry->width, &geometry->height);
+}
+
+int backend_get_event_fd() {
+    // The Wayland helper dispatches its events on its own thread.
+    return -1;
+}
+
+void backend_handle_events() {
+    // The Wayland helper dispatches its events on its own thread.
 }
 
 static int run(bool keyboard, bool mouse) {
-    if (mouse) {
-        wayland_helper_init();
-    }
+    // The helper receives the keymap for key typed events and the screen layout for absolute motion.
+    // It reads them on its own thread, so the hook doesn't wait for the compositor to start.
+    wayland_helper_start();
+
+    // Whatever was held down when the hook stopped, and wherever the pointer was, is unknown by now.
+    keymap_helper_reset_state();
+    pointer_estimated = false;
 
     return run_libinput(keyboard, mouse);
 }
@@ -0,0 +1,344 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include <logger.h>
+#include <uiohook.h>
+
+#include "keymap_helper.h"
+
+#define EVDEV_KEYCODE_OFFSET    8
+
+// The keys which type characters all have evdev codes below this, so only they are kept in the table.
+#define KEY_TABLE_SIZE          256
+
+// The table has a row for every combination of the modifiers which usually pick the level of a key.
+#define TABLE_MODIFIER_COUNT    4
+#define KEY_TABLE_LEVELS        (1 << TABLE_MODIFIER_COUNT)
+
+#define UTF16_UNITS_MAX         2
+
+#define FNV_OFFSET_BASIS        0xCBF29CE484222325ULL
+#define FNV_PRIME               0x100000001B3ULL
+
+typedef struct _key_chars {
+    uint16_t units[UTF16_UNITS_MAX];
+    uint8_t length;
+} key_chars;
+
+// The keymap is received on the thread of the Wayland helper and picked up by the hook thread.
+static pthread_mutex_t keymap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct xkb_context *context = NULL;
+static struct xkb_keymap *keymap = NULL;
+static uint32_t keymap_version = 0;
+static size_t keymap_length = 0;
+static uint64_t keymap_hash = 0;
+
+// The state and the table are only used on the hook thread.
+static struct xkb_keymap *state_keymap = NULL;
+static struct xkb_state *state = NULL;
+static uint32_t state_version = 0;
+
+static const char *table_modifier_names[TABLE_MODIFIER_COUNT] = {
+    XKB_MOD_NAME_SHIFT,
+    XKB_MOD_NAME_CAPS,
+    XKB_MOD_NAME_NUM,
+    "Mod5" // Level 3, i.e. AltGr.
+};
+
+static xkb_mod_mask_t table_modifiers[TABLE_MODIFIER_COUNT];
+static xkb_mod_mask_t table_mask = 0;
+static xkb_layout_index_t table_layout = 0;
+static bool table_built = false;
+static key_chars key_table[KEY_TABLE_LEVELS][KEY_TABLE_SIZE];
+
+// The row of the table for the current state, or -1 if a modifier which the table doesn't cover is active.
+static int current_level = -1;
+
+static uint64_t hash_keymap(const char *text, size_t length) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t) text[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+void keymap_helper_set_keymap(uint32_t format, int fd, uint32_t size) {
+    if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Ignoring a keymap in the unknown format %u.\n",
+                __FUNCTION__, __LINE__, format);
+
+        close(fd);
+        return;
+    }
+
+    // The keymap is compiled straight from the memory which the compositor shares, so it's never copied.
+    char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (text == MAP_FAILED) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to map the keymap: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        return;
+    }
+
+    size_t length = strnlen(text, size);
+    uint64_t hash = hash_keymap(text, length);
+
+    // Compositors may send the same keymap again, e.g. when a keyboard is plugged in, so it's only compiled once.
+    pthread_mutex_lock(&keymap_mutex);
+    bool unchanged = keymap != NULL && length == keymap_length && hash == keymap_hash;
+    pthread_mutex_unlock(&keymap_mutex);
+
+    if (unchanged) {
+        munmap(text, size);
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: The keymap hasn't changed.\n",
+                __FUNCTION__, __LINE__);
+
+        return;
+    }
+
+    // Only the helper thread compiles keymaps, so the context doesn't need the lock.
+    if (context == NULL) {
+        context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    }
+
+    struct xkb_keymap *compiled = context != NULL
+        ? xkb_keymap_new_from_buffer(context, text, length, XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS)
+        : NULL;
+
+    munmap(text, size);
+
+    if (compiled == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to compile the keymap!\n",
+                __FUNCTION__, __LINE__);
+
+        return;
+    }
+
+    pthread_mutex_lock(&keymap_mutex);
+
+    xkb_keymap_unref(keymap);
+    keymap = compiled;
+    keymap_length = length;
+    keymap_hash = hash;
+    keymap_version++;
+
+    pthread_mutex_unlock(&keymap_mutex);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Compiled a new keymap.\n",
+            __FUNCTION__, __LINE__);
+}
+
+bool keymap_helper_has_keymap() {
+    pthread_mutex_lock(&keymap_mutex);
+    bool result = keymap != NULL;
+    pthread_mutex_unlock(&keymap_mutex);
+
+    return result;
+}
+
+static key_chars encode_utf16(uint32_t code_point) {
+    if (code_point == 0) {
+        return (key_chars) { .length = 0 };
+    }
+
+    if (code_point < 0x10000) {
+        return (key_chars) { .units = { (uint16_t) code_point }, .length = 1 };
+    }
+
+    code_point -= 0x10000;
+
+    return (key_chars) {
+        .units = { (uint16_t) (0xD800 + (code_point >> 10)), (uint16_t) (0xDC00 + (code_point & 0x3FF)) },
+        .length = 2
+    };
+}
+
+static xkb_mod_mask_t get_modifier_mask(const char *name) {
+    xkb_mod_index_t index = xkb_keymap_mod_get_index(state_keymap, name);
+    return index != XKB_MOD_INVALID ? (xkb_mod_mask_t) 1 << index : 0;
+}
+
+static void build_table(xkb_layout_index_t layout) {
+    table_layout = layout;
+    table_built = false;
+
+    struct xkb_state *table_state = xkb_state_new(state_keymap);
+    if (table_state == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to create a keyboard state for the key table!\n",
+                __FUNCTION__, __LINE__);
+
+        return;
+    }
+
+    for (unsigned int level = 0; level < KEY_TABLE_LEVELS; level++) {
+        xkb_mod_mask_t modifiers = 0;
+        for (unsigned int i = 0; i < TABLE_MODIFIER_COUNT; i++) {
+            if (level & (1 << i)) {
+                modifiers |= table_modifiers[i];
+            }
+        }
+
+        xkb_state_update_mask(table_state, modifiers, 0, 0, 0, 0, layout);
+
+        for (unsigned int evdev_code = 0; evdev_code < KEY_TABLE_SIZE; evdev_code++) {
+            key_table[level][evdev_code] =
+                encode_utf16(xkb_state_key_get_utf32(table_state, evdev_code + EVDEV_KEYCODE_OFFSET));
+        }
+    }
+
+    xkb_state_unref(table_state);
+    table_built = true;
+}
+
+// Finds the row of the table for the current state, which only changes when a modifier or the layout does.
+static void update_level() {
+    xkb_mod_mask_t modifiers = xkb_state_serialize_mods(state, XKB_STATE_MODS_EFFECTIVE);
+    xkb_layout_index_t layout = xkb_state_serialize_layout(state, XKB_STATE_LAYOUT_EFFECTIVE);
+
+    if (!table_built || layout != table_layout) {
+        build_table(layout);
+    }
+
+    if (!table_built || (modifiers & ~table_mask) != 0) {
+        current_level = -1;
+        return;
+    }
+
+    current_level = 0;
+    for (unsigned int i = 0; i < TABLE_MODIFIER_COUNT; i++) {
+        if (modifiers & table_modifiers[i]) {
+            current_level |= 1 << i;
+        }
+    }
+}
+
+static void release_state() {
+    xkb_state_unref(state);
+    state = NULL;
+
+    xkb_keymap_unref(state_keymap);
+    state_keymap = NULL;
+
+    table_built = false;
+    current_level = -1;
+}
+
+// Picks up a new keymap if the compositor has sent one. Returns false if there is no keymap to translate with.
+static bool sync_state(uint16_t modifier_mask) {
+    pthread_mutex_lock(&keymap_mutex);
+
+    if (keymap == NULL || (state != NULL && state_version == keymap_version)) {
+        pthread_mutex_unlock(&keymap_mutex);
+        return state != NULL;
+    }
+
+    struct xkb_keymap *latest = xkb_keymap_ref(keymap);
+    uint32_t version = keymap_version;
+
+    pthread_mutex_unlock(&keymap_mutex);
+
+    struct xkb_state *latest_state = xkb_state_new(latest);
+    if (latest_state == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to create a keyboard state for the new keymap!\n",
+                __FUNCTION__, __LINE__);
+
+        xkb_keymap_unref(latest);
+        return state != NULL;
+    }
+
+    release_state();
+
+    state = latest_state;
+    state_keymap = latest;
+    state_version = version;
+
+    table_mask = 0;
+    for (unsigned int i = 0; i < TABLE_MODIFIER_COUNT; i++) {
+        table_modifiers[i] = get_modifier_mask(table_modifier_names[i]);
+        table_mask |= table_modifiers[i];
+    }
+
+    // The keys which are held down can't be known, but the locks can be taken over from the keyboards.
+    xkb_mod_mask_t locked = 0;
+
+    if (modifier_mask & MASK_CAPS_LOCK) {
+        locked |= get_modifier_mask(XKB_MOD_NAME_CAPS);
+    }
+
+    if (modifier_mask & MASK_NUM_LOCK) {
+        locked |= get_modifier_mask(XKB_MOD_NAME_NUM);
+    }
+
+    xkb_state_update_mask(state, 0, 0, locked, 0, 0, 0);
+    update_level();
+
+    return true;
+}
+
+void keymap_helper_reset_state() {
+    release_state();
+    state_version = 0;
+}
+
+void keymap_helper_update_key(uint16_t evdev_code, bool pressed, uint16_t modifier_mask) {
+    if (!sync_state(modifier_mask)) {
+        return;
+    }
+
+    enum xkb_state_component changed =
+        xkb_state_update_key(state, evdev_code + EVDEV_KEYCODE_OFFSET, pressed ? XKB_KEY_DOWN : XKB_KEY_UP);
+
+    if (changed & (XKB_STATE_MODS_EFFECTIVE | XKB_STATE_LAYOUT_EFFECTIVE)) {
+        update_level();
+    }
+}
+
+size_t keymap_helper_key_to_unicode(uint16_t evdev_code, uint16_t modifier_mask, uint16_t *buffer, size_t length) {
+    if (!sync_state(modifier_mask)) {
+        return 0;
+    }
+
+    // Most keys are typed with the common modifiers, so they are translated with a single lookup.
+    key_chars chars = current_level >= 0 && evdev_code < KEY_TABLE_SIZE
+        ? key_table[current_level][evdev_code]
+        : encode_utf16(xkb_state_key_get_utf32(state, evdev_code + EVDEV_KEYCODE_OFFSET));
+
+    size_t count = chars.length < length ? chars.length : length;
+    memcpy(buffer, chars.units, sizeof(uint16_t) * count);
+
+    return count;
+}
+
+void keymap_helper_destroy() {
+    release_state();
+    state_version = 0;
+
+    pthread_mutex_lock(&keymap_mutex);
+
+    xkb_keymap_unref(keymap);
+    keymap = NULL;
+    keymap_length = 0;
+    keymap_hash = 0;
+
+    xkb_context_unref(context);
+    context = NULL;
+
+    pthread_mutex_unlock(&keymap_mutex);
+}
@@ -0,0 +1,29 @@
+#ifndef KEYMAP_HELPER_H
+#define KEYMAP_HELPER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Compiles the keymap which the compositor has sent, unless it's the same as the current one.
+ * Takes ownership of the file descriptor. */
+void keymap_helper_set_keymap(uint32_t format, int fd, uint32_t size);
+
+/* Checks whether a keymap has been received, so that keys can be translated. */
+bool keymap_helper_has_keymap();
+
+/* Forgets the keyboard state of the hook thread, so that it's started anew from the locks of the keyboards. */
+void keymap_helper_reset_state();
+
+/* Updates the keyboard state of the hook thread after a key has been pressed or released.
+ * The uiohook modifier mask is only used for the locks when the state is started for a new keymap. */
+void keymap_helper_update_key(uint16_t evdev_code, bool pressed, uint16_t modifier_mask);
+
+/* Translates an evdev key code to UTF-16 with the keyboard state of the hook thread.
+ * Returns the number of code units which were written to the buffer. */
+size_t keymap_helper_key_to_unicode(uint16_t evdev_code, uint16_t modifier_mask, uint16_t *buffer, size_t length);
+
+/* Drops the keymap and the keyboard state. */
+void keymap_helper_destroy();
+
+#endif
@@ -1,4 +1,3 @@
-#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -10,6 +9,8 @@
 #include <uiohook.h>
 
 #include "monitor_helper.h"
+#include "screen_info.h"
+#include "screen_layout.h"
 #include "wayland-xdg-output-unstable-v1-client-protocol.h"
 
 #define WL_OUTPUT_DONE_VERSION      2
@@ -46,12 +47,6 @@ static monitor *monitors = NULL;
 static struct zxdg_output_manager_v1 *output_manager = NULL;
 static uint32_t output_manager_name = 0;
 
-static pthread_mutex_t layout_mutex = PTHREAD_MUTEX_INITIALIZER;
-static screen_data *layout = NULL;
-static uint8_t layout_count = 0;
-static uint16_t layout_width = 0;
-static uint16_t layout_height = 0;
-
 static bool fallback_geometry_logged = false;
 static bool out_of_range_logged = false;
 
@@ -115,21 +110,18 @@ static void publish_layout() {
         resolved_count = UINT8_MAX;
     }
 
-    screen_data *new_layout = NULL;
-    uint8_t new_count = 0;
-    uint16_t new_width = 0;
-    uint16_t new_height = 0;
-
-    if (resolved_count > 0) {
-        new_layout = malloc(sizeof(screen_data) * resolved_count);
+    // The layout is built anew and published whole, so that the hook thread never waits for the dispatch thread.
+    screen_layout *new_layout = screen_layout_create((uint8_t) resolved_count);
+    if (new_layout == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the screen layout!\n",
+                __FUNCTION__, __LINE__);
 
-        if (new_layout == NULL) {
-            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the screen layout!\n",
-                    __FUNCTION__, __LINE__);
+        return;
+    }
 
-            return;
-        }
+    uint8_t new_count = 0;
 
+    if (resolved_count > 0) {
         int32_t min_x = INT32_MAX, min_y = INT32_MAX, max_x = INT32_MIN, max_y = INT32_MIN;
 
         for (monitor *current = monitors; current != NULL && new_count < resolved_count; current = current->next) {
@@ -137,7 +129,7 @@ static void publish_layout() {
                 continue;
             }
 
-            new_layout[new_count] = (screen_data) {
+            new_layout->screens[new_count] = (screen_data) {
                 .number = 0,
                 .x = clamp_to_int16(current->x),
                 .y = clamp_to_int16(current->y),
@@ -166,29 +158,20 @@ static void publish_layout() {
 
         // The registry announces globals in no particular order, so the layout is numbered by
         // position instead, which is the same on every run.
-        qsort(new_layout, new_count, sizeof(screen_data), compare_screens);
+        qsort(new_layout->screens, new_count, sizeof(screen_data), compare_screens);
 
         for (uint8_t i = 0; i < new_count; i++) {
-            new_layout[i].number = i + 1;
+            new_layout->screens[i].number = i + 1;
         }
 
-        new_width = clamp_to_uint16(max_x - min_x);
-        new_height = clamp_to_uint16(max_y - min_y);
+        new_layout->width = clamp_to_uint16(max_x - min_x);
+        new_layout->height = clamp_to_uint16(max_y - min_y);
     }
 
     logger(LOG_LEVEL_DEBUG, "%s [%u]: Resolved %u screen(s) over %u x %u.\n",
-            __FUNCTION__, __LINE__, new_count, new_width, new_height);
-
-    pthread_mutex_lock(&layout_mutex);
-
-    free(layout);
+            __FUNCTION__, __LINE__, new_count, new_layout->width, new_layout->height);
 
-    layout = new_layout;
-    layout_count = new_count;
-    layout_width = new_width;
-    layout_height = new_height;
-
-    pthread_mutex_unlock(&layout_mutex);
+    screen_layout_publish(new_layout);
 }
 
 // Applies whichever geometry the compositor has provided for a monitor.
@@ -439,30 +422,22 @@ void monitor_helper_destroy() {
         output_manager = NULL;
     }
 
-    pthread_mutex_lock(&layout_mutex);
-
-    free(layout);
-
-    layout = NULL;
-    layout_count = 0;
-    layout_width = 0;
-    layout_height = 0;
-
-    pthread_mutex_unlock(&layout_mutex);
+    // An empty layout is published rather than none, so that callers still see the version change.
+    publish_layout();
 }
 
 screen_data *monitor_helper_create_screen_info(unsigned char *count) {
     *count = 0;
     screen_data *result = NULL;
 
-    pthread_mutex_lock(&layout_mutex);
+    screen_layout *layout = screen_layout_acquire();
 
-    if (layout_count > 0) {
-        result = malloc(sizeof(screen_data) * layout_count);
+    if (layout != NULL && layout->count > 0) {
+        result = malloc(sizeof(screen_data) * layout->count);
 
         if (result != NULL) {
-            memcpy(result, layout, sizeof(screen_data) * layout_count);
-            *count = layout_count;
+            memcpy(result, layout->screens, sizeof(screen_data) * layout->count);
+            *count = layout->count;
         } else {
             logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the screen information!\n",
                     __FUNCTION__, __LINE__);
@@ -472,21 +447,65 @@ screen_data *monitor_helper_create_screen_info(unsigned char *count) {
                 __FUNCTION__, __LINE__);
     }
 
-    pthread_mutex_unlock(&layout_mutex);
+    screen_layout_release(layout);
 
     return result;
 }
 
+uint8_t monitor_helper_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *version) {
+    screen_layout *layout = screen_layout_acquire();
+
+    uint8_t count = copy_layout(buf, capacity, version,
+            layout != NULL ? layout->screens : NULL, layout != NULL ? layout->count : 0,
+            layout != NULL ? layout->version : 0);
+
+    screen_layout_release(layout);
+
+    return count;
+}
+
 bool monitor_helper_get_desktop_bounds(uint16_t *width, uint16_t *height) {
-    pthread_mutex_lock(&layout_mutex);
+    screen_layout *layout = screen_layout_acquire();
 
-    bool available = layout_count > 0;
+    bool available = layout != NULL && layout->count > 0;
     if (available) {
-        *width = layout_width;
-        *height = layout_height;
+        *width = layout->width;
+        *height = layout->height;
     }
 
-    pthread_mutex_unlock(&layout_mutex);
+    screen_layout_release(layout);
 
     return available;
 }
+
+bool monitor_helper_clamp_position(double *x, double *y) {
+    screen_layout *layout = screen_layout_acquire();
+
+    uint8_t count = layout != NULL ? layout->count : 0;
+    double nearest_x = *x, nearest_y = *y, nearest_distance = -1;
+
+    // The pointer can't leave the screens, so it's moved onto the nearest one, which is where it is if it's inside.
+    for (uint8_t i = 0; i < count && nearest_distance != 0; i++) {
+        const screen_data *screen = &layout->screens[i];
+
+        double right = screen->x + (screen->width > 0 ? screen->width - 1 : 0);
+        double bottom = screen->y + (screen->height > 0 ? screen->height - 1 : 0);
+
+        double clamped_x = *x < screen->x ? screen->x : *x > right ? right : *x;
+        double clamped_y = *y < screen->y ? screen->y : *y > bottom ? bottom : *y;
+
+        double distance = (clamped_x - *x) * (clamped_x - *x) + (clamped_y - *y) * (clamped_y - *y);
+        if (nearest_distance < 0 || distance < nearest_distance) {
+            nearest_x = clamped_x;
+            nearest_y = clamped_y;
+            nearest_distance = distance;
+        }
+    }
+
+    screen_layout_release(layout);
+
+    *x = nearest_x;
+    *y = nearest_y;
+
+    return count > 0;
+}
@@ -26,7 +26,13 @@ void monitor_helper_destroy();
 /* Copies the current layout for the caller, who takes ownership of it. */
 screen_data *monitor_helper_create_screen_info(unsigned char *count);
 
+/* Copies the current layout into the buffer unless it's too small or the version is already current. */
+uint8_t monitor_helper_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *version);
+
 /* Gets the size of the bounding box of every output. Returns false if no layout is known yet. */
 bool monitor_helper_get_desktop_bounds(uint16_t *width, uint16_t *height);
 
+/* Moves a position onto the nearest screen. Returns false if no layout is known yet, in which case it's left alone. */
+bool monitor_helper_clamp_position(double *x, double *y);
+
 #endif
@@ -1,16 +1,270 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <xkbcommon/xkbcommon.h>
+
 #include <logger.h>
 #include <uiohook.h>
 
-int hook_post_text(const uint16_t * const text) {
-    logger(LOG_LEVEL_WARN, "%s [%u]: hook_post_text is not supported on Wayland.\n",
-            __FUNCTION__, __LINE__);
+#include "wayland_helper.h"
 
-    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
-}
+#define EVDEV_KEYCODE_OFFSET    8
+
+// X clients can't use key codes above 255, so a string which has more distinct characters than the keymap has keys
+// is typed through several keymaps.
+#define KEYMAP_KEYCODE_MIN      (EVDEV_KEYCODE_OFFSET + 1)
+#define KEYMAP_KEYCODE_MAX      255
+#define KEYMAP_KEY_COUNT        (KEYMAP_KEYCODE_MAX - KEYMAP_KEYCODE_MIN + 1)
+
+#define KEYSYM_NAME_MAX         64
+
+// The virtual keyboard sends the keys as fast as the compositor takes them unless a delay is set.
+static uint64_t post_text_delay = 0;
 
 uint64_t hook_get_post_text_delay_linux() {
-    return 0;
+    return post_text_delay;
 }
 
 void hook_set_post_text_delay_linux(uint64_t delay) {
+    post_text_delay = delay;
+}
+
+static bool is_high_surrogate(uint16_t uc) {
+    return (uc & 0xFC00) == 0xD800;
+}
+
+static bool is_low_surrogate(uint16_t uc) {
+    return (uc & 0xFC00) == 0xDC00;
+}
+
+static uint32_t map_to_keysym(uint32_t code_point) {
+    // Text is expected to break lines with a new line, but that's typed with the return key.
+    if (code_point == '\n') {
+        return XKB_KEY_Return;
+    }
+
+    return xkb_utf32_to_keysym(code_point);
+}
+
+// Maps the text to a key sym per character, and skips the characters which can't be typed.
+static size_t map_to_keysyms(const uint16_t * const text, xkb_keysym_t *keysyms) {
+    size_t count = 0;
+
+    for (size_t i = 0; text[i] != 0; i++) {
+        uint32_t code_point = text[i];
+
+        if (is_high_surrogate(text[i]) && is_low_surrogate(text[i + 1])) {
+            code_point = 0x10000 + ((text[i] - 0xD800) << 10) + (text[i + 1] - 0xDC00);
+            i++;
+        } else if (is_high_surrogate(text[i]) || is_low_surrogate(text[i])) {
+            code_point = 0xFFFD;
+        }
+
+        xkb_keysym_t keysym = map_to_keysym(code_point);
+        if (keysym == XKB_KEY_NoSymbol) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Could not map character %04X to a key sym!\n",
+                    __FUNCTION__, __LINE__, code_point);
+
+            continue;
+        }
+
+        keysyms[count++] = keysym;
+    }
+
+    return count;
+}
+
+// Assigns a key to every distinct key sym from the start until the keymap is full, and returns where it stopped.
+static size_t assign_keys(const xkb_keysym_t *keysyms, size_t start, size_t count,
+        xkb_keysym_t *key_keysyms, size_t *key_count, uint32_t *keys) {
+    *key_count = 0;
+
+    size_t end = start;
+
+    for (; end < count; end++) {
+        size_t key = 0;
+        while (key < *key_count && key_keysyms[key] != keysyms[end]) {
+            key++;
+        }
+
+        if (key == *key_count) {
+            if (*key_count == KEYMAP_KEY_COUNT) {
+                break;
+            }
+
+            key_keysyms[(*key_count)++] = keysyms[end];
+        }
+
+        keys[end - start] = KEYMAP_KEYCODE_MIN + key - EVDEV_KEYCODE_OFFSET;
+    }
+
+    return end;
+}
+
+// Generates a keymap where every key types a single key sym on every level, so that modifiers don't matter.
+static char *generate_keymap(const xkb_keysym_t *key_keysyms, size_t key_count, size_t *size) {
+    char *keymap = NULL;
+
+    FILE *stream = open_memstream(&keymap, size);
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    fprintf(stream, "xkb_keymap {\n");
+    fprintf(stream, "xkb_keycodes \"uiohook\" {\n");
+    fprintf(stream, "minimum = %d;\n", EVDEV_KEYCODE_OFFSET);
+    fprintf(stream, "maximum = %d;\n", KEYMAP_KEYCODE_MAX);
+
+    for (size_t i = 0; i < key_count; i++) {
+        fprintf(stream, "<K%zu> = %zu;\n", i, KEYMAP_KEYCODE_MIN + i);
+    }
+
+    fprintf(stream, "};\n");
+    fprintf(stream, "xkb_types \"uiohook\" { include \"complete\" };\n");
+    fprintf(stream, "xkb_compatibility \"uiohook\" { include \"complete\" };\n");
+    fprintf(stream, "xkb_symbols \"uiohook\" {\n");
+
+    for (size_t i = 0; i < key_count; i++) {
+        char name[KEYSYM_NAME_MAX];
+        if (xkb_keysym_get_name(key_keysyms[i], name, sizeof(name)) < 0) {
+            snprintf(name, sizeof(name), "%#x", key_keysyms[i]);
+        }
+
+        fprintf(stream, "key <K%zu> { [ %s ] };\n", i, name);
+    }
+
+    fprintf(stream, "};\n");
+    fprintf(stream, "};\n");
+
+    // The compositor expects the keymap to be null-terminated.
+    fputc('\0', stream);
+
+    if (fclose(stream) != 0) {
+        free(keymap);
+        return NULL;
+    }
+
+    return keymap;
+}
+
+// Puts the keymap into a sealed memory file, so that the compositor can map it without copying it,
+// and without having to trust that it won't change under it.
+static int create_keymap_file(const char *keymap, size_t size) {
+    int fd = memfd_create("uiohook-keymap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create a memory file for the keymap: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        return -1;
+    }
+
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = write(fd, keymap + written, size - written);
+
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (result <= 0) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to write the keymap: %s\n",
+                    __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+            close(fd);
+            return -1;
+        }
+
+        written += (size_t) result;
+    }
+
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to seal the keymap: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+    }
+
+    return fd;
+}
+
+static int type_keys(const xkb_keysym_t *key_keysyms, size_t key_count, const uint32_t *keys, size_t count) {
+    size_t size = 0;
+    char *keymap = generate_keymap(key_keysyms, key_count, &size);
+
+    if (keymap == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to generate a keymap for the text!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    int fd = create_keymap_file(keymap, size);
+    free(keymap);
+
+    if (fd < 0) {
+        return UIOHOOK_FAILURE;
+    }
+
+    int status = wayland_helper_type_keys(fd, (uint32_t) size, keys, count, post_text_delay);
+    close(fd);
+
+    return status;
+}
+
+int hook_post_text(const uint16_t * const text) {
+    if (text == NULL) {
+        return UIOHOOK_ERROR_NULL;
+    }
+
+    size_t length = 0;
+    while (text[length] != 0) {
+        length++;
+    }
+
+    if (length == 0) {
+        return UIOHOOK_SUCCESS;
+    }
+
+    xkb_keysym_t *keysyms = malloc(sizeof(xkb_keysym_t) * length);
+    uint32_t *keys = malloc(sizeof(uint32_t) * length);
+
+    if (keysyms == NULL || keys == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the text!\n",
+                __FUNCTION__, __LINE__);
+
+        free(keysyms);
+        free(keys);
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    size_t count = map_to_keysyms(text, keysyms);
+
+    xkb_keysym_t key_keysyms[KEYMAP_KEY_COUNT];
+    size_t key_count = 0;
+
+    int status = UIOHOOK_SUCCESS;
+
+    // Most text fits into a single keymap, so it's uploaded once and then the whole text is typed through it.
+    for (size_t start = 0; start < count && status == UIOHOOK_SUCCESS; ) {
+        size_t end = assign_keys(keysyms, start, count, key_keysyms, &key_count, keys);
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Typing %zu characters through %zu keys.\n",
+                __FUNCTION__, __LINE__, end - start, key_count);
+
+        status = type_keys(key_keysyms, key_count, keys, end - start);
+        start = end;
+    }
+
+    free(keysyms);
+    free(keys);
+
+    return status;
 }
@@ -0,0 +1,81 @@
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <uiohook.h>
+
+#include "screen_info.h"
+#include "screen_layout.h"
+
+static _Atomic(screen_layout *) current_layout = NULL;
+
+// Readers count themselves in the slot of the generation which they've seen, so that a publisher knows when nobody can
+// still be about to take a reference to the layout which it has just replaced.
+static atomic_uint generation = 0;
+static atomic_uint readers[2];
+
+screen_layout *screen_layout_create(uint8_t count) {
+    screen_layout *layout = malloc(sizeof(screen_layout) + sizeof(screen_data) * count);
+    if (layout == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&layout->refs, 1);
+    layout->version = 0;
+    layout->width = 0;
+    layout->height = 0;
+    layout->count = count;
+
+    return layout;
+}
+
+void screen_layout_publish(screen_layout *layout) {
+    // Only the publisher replaces the layout, so it can look at the current one without a reference.
+    screen_layout *previous = atomic_load(&current_layout);
+
+    layout->version = previous != NULL ? previous->version : 0;
+    const screen_data *previous_screens = previous != NULL ? previous->screens : NULL;
+    uint8_t previous_count = previous != NULL ? previous->count : 0;
+    if (!screens_equal(layout->screens, layout->count, previous_screens, previous_count)) {
+        layout->version = next_layout_version(layout->version);
+    }
+
+    atomic_store(&current_layout, layout);
+
+    // Readers which come after this see the new layout, so only the ones in the slot of the old generation are waited
+    // for, and they only hold it for as long as it takes to count a reference.
+    unsigned int old_generation = atomic_fetch_add(&generation, 1);
+    while (atomic_load(&readers[old_generation & 1]) != 0) {
+        sched_yield();
+    }
+
+    screen_layout_release(previous);
+}
+
+screen_layout *screen_layout_acquire() {
+    while (true) {
+        unsigned int seen_generation = atomic_load(&generation);
+        atomic_fetch_add(&readers[seen_generation & 1], 1);
+
+        // If a layout was published in the meantime, the publisher may not have seen this reader, so it starts over.
+        if (atomic_load(&generation) == seen_generation) {
+            screen_layout *layout = atomic_load(&current_layout);
+            if (layout != NULL) {
+                atomic_fetch_add_explicit(&layout->refs, 1, memory_order_relaxed);
+            }
+
+            atomic_fetch_sub(&readers[seen_generation & 1], 1);
+            return layout;
+        }
+
+        atomic_fetch_sub(&readers[seen_generation & 1], 1);
+    }
+}
+
+void screen_layout_release(screen_layout *layout) {
+    if (layout != NULL && atomic_fetch_sub_explicit(&layout->refs, 1, memory_order_acq_rel) == 1) {
+        free(layout);
+    }
+}
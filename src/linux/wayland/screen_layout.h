@@ -0,0 +1,38 @@
+#ifndef SCREEN_LAYOUT_H
+#define SCREEN_LAYOUT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <uiohook.h>
+
+/* An immutable snapshot of the screen layout, which stays valid for as long as a reference to it is held. */
+typedef struct _screen_layout {
+    atomic_uint refs;
+
+    // Changes whenever a published layout differs from the one before it. Zero means that there was no layout yet.
+    uint32_t version;
+
+    // The size of the bounding box of every screen.
+    uint16_t width;
+    uint16_t height;
+
+    uint8_t count;
+    screen_data screens[];
+} screen_layout;
+
+/* Creates a layout with room for the screens, which the caller fills in and then publishes. */
+screen_layout *screen_layout_create(uint8_t count);
+
+/* Makes the layout the current one and takes ownership of it. Readers which still hold the previous one keep it until
+ * they release it. Only one thread may publish at a time, and it waits for readers which are just acquiring. */
+void screen_layout_publish(screen_layout *layout);
+
+/* Gets a reference to the current layout, or NULL if none has been published. Never blocks. */
+screen_layout *screen_layout_acquire();
+
+/* Releases a reference which was acquired, and frees the layout if it was the last one. Accepts NULL. */
+void screen_layout_release(screen_layout *layout);
+
+#endif
@@ -1,11 +1,27 @@
 #include <logger.h>
 #include <uiohook.h>
 
+#include "backend_lifecycle.h"
+#include "keymap_helper.h"
 #include "monitor_helper.h"
+#include "preload_thread.h"
+#include "timed_post.h"
+#include "uinput_helper.h"
 #include "wayland_helper.h"
 
 uint32_t hook_get_optional_feature_support() {
-    return 0;
+    uint32_t features = 0;
+
+    if (wayland_helper_can_type_keys()) {
+        features |= UIOHOOK_FEATURE_POST_TEXT;
+    }
+
+    // The keymap is only sent once the helper is connected, which checking for virtual keyboards ensures.
+    if (keymap_helper_has_keymap()) {
+        features |= UIOHOOK_FEATURE_KEY_TYPED_EVENTS;
+    }
+
+    return features;
 }
 
 screen_data* hook_create_screen_info(unsigned char *count) {
@@ -17,6 +33,14 @@ screen_data* hook_create_screen_info(unsigned char *count) {
     return monitor_helper_create_screen_info(count);
 }
 
+uint8_t hook_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *layout_version) {
+    if (!wayland_helper_init()) {
+        return 0;
+    }
+
+    return monitor_helper_get_screen_info(buf, capacity, layout_version);
+}
+
 long int hook_get_auto_repeat_rate() {
     int32_t rate = wayland_helper_get_repeat_rate();
     return rate > 0 ? 1000 / rate : -1;
@@ -52,3 +76,39 @@ long int hook_get_multi_click_time() {
     // Not supported by Wayland, so return the default value for GNOME, KDE, and GTK.
     return 400;
 }
+
+static int preload_helper() {
+    // Waits for the helper to read the keymap and the screen layout from the compositor.
+    return wayland_helper_init() ? UIOHOOK_SUCCESS : UIOHOOK_ERROR_LINUX_OPEN_WAYLAND_DISPLAY;
+}
+
+#ifdef UIOHOOK_STATIC_BACKEND
+// Built into libuiohook, the back-end has no loader which calls this on a thread of its own.
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    return start_preload_thread(preload_helper, done_proc, user_data);
+}
+#else
+// The loader already calls this on a thread of its own, so the helpers are opened right here.
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    int status = preload_helper();
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Preloaded the back-end. (%#X)\n",
+            __FUNCTION__, __LINE__, status);
+
+    if (done_proc != NULL) {
+        done_proc(status, user_data);
+    }
+
+    return status;
+}
+#endif
+
+bool backend_is_busy() {
+    return is_timed_post_active() || virtual_device_sets_exist();
+}
+
+void backend_release() {
+    stop_timed_post();
+    destroy_all_virtual_devices();
+    wayland_helper_stop();
+}
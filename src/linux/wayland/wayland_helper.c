@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <sys/eventfd.h>
@@ -15,15 +16,32 @@
 #include <logger.h>
 #include <uiohook.h>
 
+#include "dispatch_event.h"
+#include "keymap_helper.h"
 #include "monitor_helper.h"
+#include "wayland-virtual-keyboard-unstable-v1-client-protocol.h"
 #include "wayland-xdg-output-unstable-v1-client-protocol.h"
 #include "wayland_helper.h"
 
 #define WL_SEAT_REPEAT_INFO_VERSION  4
 #define WL_KEYBOARD_RELEASE_VERSION  3
 
-static pthread_once_t init_once = PTHREAD_ONCE_INIT;
-static bool initialized = false;
+// The globals are announced in the first roundtrip, the xdg-outputs are requested after it,
+// and the outputs report their geometry in the ones which follow.
+#define STARTUP_ROUNDTRIP_COUNT      3
+
+// How long the callers which need the state of the compositor wait for it when the helper has only just started.
+#define READY_TIMEOUT_MS             1000
+
+// Serializes starting and stopping the helper, which is started again if it's used after it has been stopped.
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool started = false;
+
+static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t state_cond = PTHREAD_COND_INITIALIZER;
+static wayland_helper_state state = WAYLAND_HELPER_STOPPED;
+
+static unsigned int startup_roundtrips = 0;
 
 static struct wl_display *display = NULL;
 static struct wl_event_queue *queue = NULL;
@@ -33,6 +51,14 @@ static struct wl_seat *seat = NULL;
 static uint32_t seat_name = 0;
 static struct wl_keyboard *keyboard = NULL;
 
+// The seat and the virtual keyboard manager are used by the threads which post text, so they are guarded together.
+static pthread_mutex_t virtual_keyboard_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct zwp_virtual_keyboard_manager_v1 *virtual_keyboard_manager = NULL;
+static uint32_t virtual_keyboard_manager_name = 0;
+
+// Text is posted on its own queue, so that waiting for the compositor doesn't dispatch the events of the helper.
+static struct wl_event_queue *post_queue = NULL;
+
 static pthread_mutex_t repeat_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int32_t repeat_rate = -1;
 static int32_t repeat_delay = -1;
@@ -42,8 +68,8 @@ static bool dispatch_thread_running = false;
 static int stop_fd = -1;
 
 static void keyboard_keymap(void *data, struct wl_keyboard *wl_keyboard, uint32_t format, int32_t fd, uint32_t size) {
-    // The keymap is of no use without key typed events, so close the descriptor.
-    close(fd);
+    // The hook translates the keys for key typed events with the keymap of the compositor.
+    keymap_helper_set_keymap(format, fd, size);
 }
 
 static void keyboard_repeat_info(void *data, struct wl_keyboard *wl_keyboard, int32_t rate, int32_t delay) {
@@ -52,10 +78,22 @@ static void keyboard_repeat_info(void *data, struct wl_keyboard *wl_keyboard, in
 
     pthread_mutex_lock(&repeat_mutex);
 
+    // The first event only reports the initial settings.
+    uint32_t changed = 0;
+    if (repeat_rate >= 0 && repeat_rate != rate) {
+        changed |= UIOHOOK_SETTING_AUTO_REPEAT_RATE;
+    }
+
+    if (repeat_delay >= 0 && repeat_delay != delay) {
+        changed |= UIOHOOK_SETTING_AUTO_REPEAT_DELAY;
+    }
+
     repeat_rate = rate;
     repeat_delay = delay;
 
     pthread_mutex_unlock(&repeat_mutex);
+
+    dispatch_settings_changed(changed);
 }
 
 // Key events are only ever sent to a focused client, and this connection is never focused.
@@ -125,10 +163,14 @@ static const struct wl_seat_listener seat_listener = {
 static void destroy_seat() {
     destroy_keyboard();
 
+    pthread_mutex_lock(&virtual_keyboard_mutex);
+
     if (seat != NULL) {
         wl_seat_destroy(seat);
         seat = NULL;
     }
+
+    pthread_mutex_unlock(&virtual_keyboard_mutex);
 }
 
 static void add_seat(struct wl_registry *wl_registry, uint32_t name, uint32_t version) {
@@ -143,16 +185,52 @@ static void add_seat(struct wl_registry *wl_registry, uint32_t name, uint32_t ve
                 __FUNCTION__, __LINE__);
     }
 
-    seat = wl_registry_bind(wl_registry, name, &wl_seat_interface, bind_version);
-    if (seat == NULL) {
+    struct wl_seat *bound_seat = wl_registry_bind(wl_registry, name, &wl_seat_interface, bind_version);
+    if (bound_seat == NULL) {
         logger(LOG_LEVEL_WARN, "%s [%u]: Failed to bind the seat!\n",
                 __FUNCTION__, __LINE__);
 
         return;
     }
 
+    wl_seat_add_listener(bound_seat, &seat_listener, NULL);
+
+    pthread_mutex_lock(&virtual_keyboard_mutex);
+    seat = bound_seat;
     seat_name = name;
-    wl_seat_add_listener(seat, &seat_listener, NULL);
+    pthread_mutex_unlock(&virtual_keyboard_mutex);
+}
+
+static void destroy_virtual_keyboard_manager() {
+    pthread_mutex_lock(&virtual_keyboard_mutex);
+
+    if (virtual_keyboard_manager != NULL) {
+        zwp_virtual_keyboard_manager_v1_destroy(virtual_keyboard_manager);
+        virtual_keyboard_manager = NULL;
+    }
+
+    pthread_mutex_unlock(&virtual_keyboard_mutex);
+}
+
+static void add_virtual_keyboard_manager(struct wl_registry *wl_registry, uint32_t name, uint32_t version) {
+    if (virtual_keyboard_manager != NULL) {
+        return;
+    }
+
+    struct zwp_virtual_keyboard_manager_v1 *manager =
+        wl_registry_bind(wl_registry, name, &zwp_virtual_keyboard_manager_v1_interface, 1);
+
+    if (manager == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to bind the virtual keyboard manager!\n",
+                __FUNCTION__, __LINE__);
+
+        return;
+    }
+
+    pthread_mutex_lock(&virtual_keyboard_mutex);
+    virtual_keyboard_manager = manager;
+    virtual_keyboard_manager_name = name;
+    pthread_mutex_unlock(&virtual_keyboard_mutex);
 }
 
 typedef struct _global_binding {
@@ -161,9 +239,10 @@ typedef struct _global_binding {
 } global_binding;
 
 static const global_binding global_bindings[] = {
-    { &wl_output_interface,               monitor_helper_add_output         },
-    { &zxdg_output_manager_v1_interface,  monitor_helper_add_output_manager },
-    { &wl_seat_interface,                 add_seat                          }
+    { &wl_output_interface,                        monitor_helper_add_output         },
+    { &zxdg_output_manager_v1_interface,           monitor_helper_add_output_manager },
+    { &wl_seat_interface,                          add_seat                          },
+    { &zwp_virtual_keyboard_manager_v1_interface,  add_virtual_keyboard_manager      }
 };
 
 static void registry_global(void *data, struct wl_registry *wl_registry, uint32_t name, const char *interface, uint32_t version) {
@@ -181,6 +260,11 @@ static void registry_global_remove(void *data, struct wl_registry *wl_registry,
         return;
     }
 
+    if (virtual_keyboard_manager != NULL && name == virtual_keyboard_manager_name) {
+        destroy_virtual_keyboard_manager();
+        return;
+    }
+
     monitor_helper_remove_global(name);
 }
 
@@ -189,7 +273,67 @@ static const struct wl_registry_listener registry_listener = {
     .global_remove = registry_global_remove
 };
 
-static void *dispatch_thread_proc(void *arg) {
+static void set_state(wayland_helper_state new_state) {
+    pthread_mutex_lock(&state_mutex);
+    state = new_state;
+    pthread_cond_broadcast(&state_cond);
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static bool request_startup_roundtrip();
+
+static void startup_roundtrip_done(void *data, struct wl_callback *callback, uint32_t callback_data) {
+    wl_callback_destroy(callback);
+
+    if (++startup_roundtrips == 1) {
+        monitor_helper_bind_xdg_outputs();
+    }
+
+    if (startup_roundtrips < STARTUP_ROUNDTRIP_COUNT) {
+        if (!request_startup_roundtrip()) {
+            set_state(WAYLAND_HELPER_FAILED);
+        }
+
+        return;
+    }
+
+    set_state(WAYLAND_HELPER_READY);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: The Wayland helper is ready.\n",
+            __FUNCTION__, __LINE__);
+}
+
+static const struct wl_callback_listener startup_roundtrip_listener = {
+    .done = startup_roundtrip_done
+};
+
+// The roundtrips of the startup are answered on the dispatch thread like any other event, so nothing waits for them.
+static bool request_startup_roundtrip() {
+    struct wl_display *wrapped_display = wl_proxy_create_wrapper(display);
+    if (wrapped_display == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the Wayland display wrapper!\n",
+                __FUNCTION__, __LINE__);
+
+        return false;
+    }
+
+    wl_proxy_set_queue((struct wl_proxy *) wrapped_display, queue);
+    struct wl_callback *callback = wl_display_sync(wrapped_display);
+    wl_proxy_wrapper_destroy(wrapped_display);
+
+    if (callback == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to request a Wayland roundtrip!\n",
+                __FUNCTION__, __LINE__);
+
+        return false;
+    }
+
+    wl_callback_add_listener(callback, &startup_roundtrip_listener, NULL);
+
+    return true;
+}
+
+static void dispatch_events() {
     struct pollfd fds[2];
 
     fds[0].fd = wl_display_get_fd(display);
@@ -206,7 +350,7 @@ static void *dispatch_thread_proc(void *arg) {
                 logger(LOG_LEVEL_WARN, "%s [%u]: Failed to dispatch the Wayland event queue: %s\n",
                         __FUNCTION__, __LINE__, strerrorname_np(errno));
 
-                return NULL;
+                return;
             }
         }
 
@@ -215,7 +359,7 @@ static void *dispatch_thread_proc(void *arg) {
                     __FUNCTION__, __LINE__, strerrorname_np(errno));
 
             wl_display_cancel_read(display);
-            return NULL;
+            return;
         }
 
         fds[0].revents = 0;
@@ -231,7 +375,7 @@ static void *dispatch_thread_proc(void *arg) {
             logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to poll for Wayland events: %s\n",
                     __FUNCTION__, __LINE__, strerrorname_np(errno));
 
-            return NULL;
+            return;
         }
 
         if (fds[1].revents & POLLIN) {
@@ -246,7 +390,7 @@ static void *dispatch_thread_proc(void *arg) {
                 logger(LOG_LEVEL_WARN, "%s [%u]: The connection to the compositor was lost!\n",
                         __FUNCTION__, __LINE__);
 
-                return NULL;
+                return;
             }
 
             continue;
@@ -256,34 +400,44 @@ static void *dispatch_thread_proc(void *arg) {
             logger(LOG_LEVEL_WARN, "%s [%u]: Failed to read the Wayland events: %s\n",
                     __FUNCTION__, __LINE__, strerrorname_np(errno));
 
-            return NULL;
+            return;
         }
 
         if (wl_display_dispatch_queue_pending(display, queue) < 0) {
             logger(LOG_LEVEL_WARN, "%s [%u]: Failed to dispatch the Wayland event queue: %s\n",
                     __FUNCTION__, __LINE__, strerrorname_np(errno));
 
-            return NULL;
+            return;
         }
     }
-
-    return NULL;
 }
 
-static int roundtrip() {
-    int result = wl_display_roundtrip_queue(display, queue);
+static void *dispatch_thread_proc(void *arg) {
+    dispatch_events();
 
-    if (result < 0) {
-        logger(LOG_LEVEL_WARN, "%s [%u]: The Wayland roundtrip has failed: %s\n",
-                __FUNCTION__, __LINE__, strerrorname_np(errno));
+    // Whatever waits for the helper shouldn't wait any longer if the connection is lost before it's ready.
+    pthread_mutex_lock(&state_mutex);
+
+    if (state == WAYLAND_HELPER_CONNECTING) {
+        state = WAYLAND_HELPER_FAILED;
+        pthread_cond_broadcast(&state_cond);
     }
 
-    return result;
+    pthread_mutex_unlock(&state_mutex);
+
+    return NULL;
 }
 
 static void disconnect() {
     monitor_helper_destroy();
+    destroy_virtual_keyboard_manager();
     destroy_seat();
+    keymap_helper_destroy();
+
+    if (post_queue != NULL) {
+        wl_event_queue_destroy(post_queue);
+        post_queue = NULL;
+    }
 
     if (registry != NULL) {
         wl_registry_destroy(registry);
@@ -301,7 +455,7 @@ static void disconnect() {
     }
 }
 
-static void init_helper() {
+static void connect_helper() {
     display = wl_display_connect(NULL);
     if (display == NULL) {
         logger(LOG_LEVEL_WARN, "%s [%u]: Failed to connect to the Wayland display!\n",
@@ -311,7 +465,9 @@ static void init_helper() {
     }
 
     queue = wl_display_create_queue(display);
-    if (queue == NULL) {
+    post_queue = wl_display_create_queue(display);
+
+    if (queue == NULL || post_queue == NULL) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the Wayland event queue!\n",
                 __FUNCTION__, __LINE__);
 
@@ -342,14 +498,7 @@ static void init_helper() {
 
     wl_registry_add_listener(registry, &registry_listener, NULL);
 
-    if (roundtrip() < 0) {
-        disconnect();
-        return;
-    }
-
-    monitor_helper_bind_xdg_outputs();
-
-    if (roundtrip() < 0 || roundtrip() < 0) {
+    if (!request_startup_roundtrip()) {
         disconnect();
         return;
     }
@@ -375,15 +524,69 @@ static void init_helper() {
     }
 
     dispatch_thread_running = true;
-    initialized = true;
 
     logger(LOG_LEVEL_DEBUG, "%s [%u]: Connected to the Wayland display.\n",
             __FUNCTION__, __LINE__);
 }
 
+static void start_helper() {
+    set_state(WAYLAND_HELPER_CONNECTING);
+
+    connect_helper();
+
+    if (!dispatch_thread_running) {
+        set_state(WAYLAND_HELPER_FAILED);
+    }
+}
+
+void wayland_helper_start() {
+    pthread_mutex_lock(&start_mutex);
+
+    if (!started) {
+        started = true;
+        start_helper();
+    }
+
+    pthread_mutex_unlock(&start_mutex);
+}
+
+wayland_helper_state wayland_helper_get_state() {
+    wayland_helper_start();
+
+    pthread_mutex_lock(&state_mutex);
+    wayland_helper_state result = state;
+    pthread_mutex_unlock(&state_mutex);
+
+    return result;
+}
+
 bool wayland_helper_init() {
-    pthread_once(&init_once, init_helper);
-    return initialized;
+    wayland_helper_start();
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    uint64_t deadline_ns = (uint64_t) deadline.tv_nsec + READY_TIMEOUT_MS * 1000000ULL;
+    deadline.tv_sec += deadline_ns / 1000000000;
+    deadline.tv_nsec = deadline_ns % 1000000000;
+
+    pthread_mutex_lock(&state_mutex);
+
+    int result = 0;
+    while (state == WAYLAND_HELPER_CONNECTING && result == 0) {
+        result = pthread_cond_timedwait(&state_cond, &state_mutex, &deadline);
+    }
+
+    bool ready = state == WAYLAND_HELPER_READY;
+
+    pthread_mutex_unlock(&state_mutex);
+
+    if (result != 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: The compositor hasn't answered in %u ms!\n",
+                __FUNCTION__, __LINE__, READY_TIMEOUT_MS);
+    }
+
+    return ready;
 }
 
 int32_t wayland_helper_get_repeat_rate() {
@@ -410,8 +613,95 @@ int32_t wayland_helper_get_repeat_delay() {
     return delay;
 }
 
-__attribute__ ((destructor))
-static void wayland_helper_destroy() {
+bool wayland_helper_can_type_keys() {
+    if (!wayland_helper_init()) {
+        return false;
+    }
+
+    pthread_mutex_lock(&virtual_keyboard_mutex);
+    bool result = seat != NULL && virtual_keyboard_manager != NULL;
+    pthread_mutex_unlock(&virtual_keyboard_mutex);
+
+    return result;
+}
+
+static uint32_t get_key_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+int wayland_helper_type_keys(int keymap_fd, uint32_t keymap_size, const uint32_t *keys, size_t count,
+        uint64_t delay) {
+    if (!wayland_helper_init()) {
+        return UIOHOOK_ERROR_LINUX_OPEN_WAYLAND_DISPLAY;
+    }
+
+    pthread_mutex_lock(&virtual_keyboard_mutex);
+
+    if (seat == NULL || virtual_keyboard_manager == NULL) {
+        pthread_mutex_unlock(&virtual_keyboard_mutex);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: The compositor doesn't support virtual keyboards!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+    }
+
+    // The virtual keyboard is a device of its own, so its keymap never replaces the one of the real keyboards.
+    struct zwp_virtual_keyboard_v1 *virtual_keyboard =
+        zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(virtual_keyboard_manager, seat);
+
+    if (virtual_keyboard == NULL) {
+        pthread_mutex_unlock(&virtual_keyboard_mutex);
+
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create a virtual keyboard!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_FAILURE;
+    }
+
+    // The compositor maps the keymap from the same memory, so it's only sent once for all of the keys.
+    zwp_virtual_keyboard_v1_keymap(virtual_keyboard, WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keymap_fd, keymap_size);
+    zwp_virtual_keyboard_v1_modifiers(virtual_keyboard, 0, 0, 0, 0);
+
+    struct timespec ts = {
+        .tv_sec = delay / 1000000000,
+        .tv_nsec = delay % 1000000000
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t time = get_key_time();
+
+        zwp_virtual_keyboard_v1_key(virtual_keyboard, time, keys[i], WL_KEYBOARD_KEY_STATE_PRESSED);
+        zwp_virtual_keyboard_v1_key(virtual_keyboard, time, keys[i], WL_KEYBOARD_KEY_STATE_RELEASED);
+
+        // Without a delay, the keys are sent in bulk when the requests are flushed.
+        if (delay > 0) {
+            wl_display_flush(display);
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    zwp_virtual_keyboard_v1_destroy(virtual_keyboard);
+
+    pthread_mutex_unlock(&virtual_keyboard_mutex);
+
+    // The roundtrip flushes the requests and waits until the compositor has handled all of them.
+    if (wl_display_roundtrip_queue(display, post_queue) < 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to type the keys: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(wl_display_get_error(display)));
+
+        return UIOHOOK_FAILURE;
+    }
+
+    return UIOHOOK_SUCCESS;
+}
+
+void wayland_helper_stop() {
+    pthread_mutex_lock(&start_mutex);
+
     if (dispatch_thread_running) {
         uint64_t value = 1;
         if (write(stop_fd, &value, sizeof(value)) < 0) {
@@ -429,5 +719,14 @@ static void wayland_helper_destroy() {
     }
 
     disconnect();
-    initialized = false;
+    set_state(WAYLAND_HELPER_STOPPED);
+
+    started = false;
+
+    pthread_mutex_unlock(&start_mutex);
+}
+
+__attribute__ ((destructor))
+static void wayland_helper_destroy() {
+    wayland_helper_stop();
 }
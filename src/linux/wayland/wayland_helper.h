@@ -2,9 +2,28 @@
 #define WAYLAND_HELPER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-/* Connects to the compositor and starts keeping track of the state which is read from it. */
+typedef enum _wayland_helper_state {
+    WAYLAND_HELPER_STOPPED,
+    WAYLAND_HELPER_CONNECTING,
+    WAYLAND_HELPER_READY,
+    WAYLAND_HELPER_FAILED
+} wayland_helper_state;
+
+/* Connects to the compositor unless that's already been done, and leaves the roundtrips which read its state to
+ * the dispatch thread. Never waits for the compositor, so it's safe to call on the hook thread. */
+void wayland_helper_start();
+
+/* Disconnects from the compositor and joins the dispatch thread. The helper is started again when it's used next. */
+void wayland_helper_stop();
+
+/* Starts the helper if needed and gets whether it has read the state of the compositor yet, without waiting. */
+wayland_helper_state wayland_helper_get_state();
+
+/* Starts the helper if needed and waits a bounded time until it has read the state of the compositor.
+ * Returns true if it's ready. This must not be called on the hook thread. */
 bool wayland_helper_init();
 
 /* Gets the key repeat rate in repeats per second, or -1 if the compositor didn't report one. */
@@ -13,4 +32,12 @@ int32_t wayland_helper_get_repeat_rate();
 /* Gets the key repeat delay in milliseconds, or -1 if the compositor didn't report one. */
 int32_t wayland_helper_get_repeat_delay();
 
+/* Checks whether the compositor lets this connection create virtual keyboards to type with. */
+bool wayland_helper_can_type_keys();
+
+/* Presses and releases the evdev keys one after another on a new virtual keyboard with the keymap in the file.
+ * The delay between the keys is in nanoseconds. Returns when the compositor has handled all of them. */
+int wayland_helper_type_keys(int keymap_fd, uint32_t keymap_size, const uint32_t *keys, size_t count,
+        uint64_t delay);
+
 #endif
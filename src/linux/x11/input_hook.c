@@ -1,7 +1,6 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#include <X11/XKBlib.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
@@ -12,21 +11,17 @@
 #include "input_helper.h"
 #include "input_loop.h"
 #include "system_properties.h"
+#include "xkb_state.h"
 
 static Display *hook_disp = NULL;
 static XIM hook_xim = NULL;
 static XIC hook_xic = NULL;
 
-static int xkb_event_base = 0;
-static bool xkb_events_selected = false;
-
 static bool pointer_position_unavailable_logged = false;
 
 // The input context is only needed for key typed events.
 static bool input_context_loaded = false;
 
-static void select_keyboard_mapping_events();
-
 static void load_input_context() {
     if (input_context_loaded) {
         return;
@@ -34,7 +29,11 @@ static void load_input_context() {
 
     input_context_loaded = true;
 
-    select_keyboard_mapping_events();
+    if (!xkb_state_init(hook_disp)) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Cannot track the keyboard state! "
+                "Key typed events will not follow a change of the keyboard layout.\n",
+                __FUNCTION__, __LINE__);
+    }
 
     XSetLocaleModifiers("");
     hook_xim = XOpenIM(hook_disp, NULL, NULL, NULL);
@@ -76,7 +75,7 @@ static void unload_input_context() {
     }
 
     input_context_loaded = false;
-    xkb_events_selected = false;
+    xkb_state_reset();
 }
 
 // Converts a uiohook modifier mask into the state mask of an X11 key event.
@@ -95,44 +94,19 @@ static unsigned int get_x11_modifier_mask(uint16_t modifier_mask) {
 
 // Gets the state mask of an X11 key event, along with the currently active layout group.
 static unsigned int get_x11_key_state(uint16_t modifier_mask) {
-    XkbStateRec state;
-
-    if (XkbGetState(hook_disp, XkbUseCoreKbd, &state) == Success) {
-        return XkbBuildCoreState(state.mods, state.group);
+    if (xkb_state_is_tracked()) {
+        return xkb_state_get_core_state();
     }
 
-    logger(LOG_LEVEL_WARN, "%s [%u]: XkbGetState() failed!\n",
-            __FUNCTION__, __LINE__);
-
     return get_x11_modifier_mask(modifier_mask);
 }
 
-static void select_keyboard_mapping_events() {
-    int opcode = 0, error_base = 0;
-    int major = XkbMajorVersion, minor = XkbMinorVersion;
+static void handle_x_events(int mode) {
+    XEvent event;
 
-    xkb_events_selected = XkbQueryExtension(hook_disp, &opcode, &xkb_event_base, &error_base, &major, &minor)
-        && XkbSelectEvents(hook_disp, XkbUseCoreKbd,
-                XkbMapNotifyMask | XkbNewKeyboardNotifyMask,
-                XkbMapNotifyMask | XkbNewKeyboardNotifyMask);
-
-    if (!xkb_events_selected) {
-        logger(LOG_LEVEL_WARN, "%s [%u]: Cannot watch for keyboard mapping changes! "
-                "Key typed events will not follow a change of the keyboard layout.\n",
-                __FUNCTION__, __LINE__);
-    }
-}
-
-static void refresh_keyboard_mapping() {
-    if (!xkb_events_selected) {
-        return;
-    }
-
-    XkbEvent event;
-    while (XCheckTypedEvent(hook_disp, xkb_event_base, &event.core)) {
-        if (event.any.xkb_type == XkbMapNotify) {
-            XkbRefreshKeyboardMapping(&event.map);
-        }
+    while (XEventsQueued(hook_disp, mode) > 0) {
+        XNextEvent(hook_disp, &event);
+        xkb_state_handle_event(&event);
     }
 }
 
@@ -142,7 +116,9 @@ size_t backend_key_to_unicode(uint16_t evdev_code, uint16_t modifier_mask, uint1
     }
 
     load_input_context();
-    refresh_keyboard_mapping();
+
+    // Other requests on the hook display may have queued events without the connection becoming readable.
+    handle_x_events(QueuedAlready);
 
     Window root = XDefaultRootWindow(hook_disp);
 
@@ -172,6 +148,20 @@ size_t backend_key_to_unicode(uint16_t evdev_code, uint16_t modifier_mask, uint1
     return event_to_unicode(&x_event, hook_xic, buffer, length);
 }
 
+void backend_update_key_state(uint16_t evdev_code, bool pressed) {
+    // The keyboard state follows the XKB events of the hook display instead.
+}
+
+int backend_get_event_fd() {
+    return hook_disp != NULL ? ConnectionNumber(hook_disp) : -1;
+}
+
+void backend_handle_events() {
+    if (hook_disp != NULL) {
+        handle_x_events(QueuedAfterReading);
+    }
+}
+
 bool backend_get_pointer_position(int16_t *x, int16_t *y) {
     if (hook_disp == NULL) {
         return false;
@@ -205,32 +195,30 @@ bool backend_get_pointer_position(int16_t *x, int16_t *y) {
     return true;
 }
 
-bool backend_get_desktop_bounds(uint16_t *width, uint16_t *height) {
-    return get_desktop_bounds(width, height);
+// The pointer is queried from the X server instead of being followed.
+
+void backend_track_pointer_motion(double dx, double dy) {
 }
 
-void backend_adjust_absolute_position(int16_t *x, int16_t *y) {
-    int16_t origin_x, origin_y;
-    if (get_screen_origin(&origin_x, &origin_y)) {
-        *x -= origin_x;
-        *y -= origin_y;
-    }
+void backend_track_pointer_position(int16_t x, int16_t y) {
 }
 
-void backend_restore_absolute_position(int16_t *x, int16_t *y) {
-    int16_t origin_x, origin_y;
-    if (get_screen_origin(&origin_x, &origin_y)) {
-        *x += origin_x;
-        *y += origin_y;
-    }
+bool backend_get_desktop_geometry(desktop_geometry *geometry, bool wait) {
+    return get_desktop_geometry(&geometry->width, &geometry->height, &geometry->origin_x, &geometry->origin_y);
 }
 
 static int run(bool keyboard, bool mouse) {
+    // The screen layout is kept for as long as the hook runs, so that absolute positions can be adjusted.
+    if (!acquire_helper(HELPER_SCREENS)) {
+        return UIOHOOK_ERROR_X_OPEN_DISPLAY;
+    }
+
     hook_disp = XOpenDisplay(XDisplayName(NULL));
     if (hook_disp == NULL) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: XOpenDisplay failure!\n",
                 __FUNCTION__, __LINE__);
 
+        release_helper(HELPER_SCREENS);
         return UIOHOOK_ERROR_X_OPEN_DISPLAY;
     }
 
@@ -246,6 +234,8 @@ static int run(bool keyboard, bool mouse) {
     XCloseDisplay(hook_disp);
     hook_disp = NULL;
 
+    release_helper(HELPER_SCREENS);
+
     return status;
 }
 
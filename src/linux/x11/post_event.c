@@ -9,6 +9,7 @@
 
 #include "input_helper.h"
 #include "logger.h"
+#include "system_properties.h"
 #include "uinput_helper.h"
 
 #define BORROWED_KEYCODES_MAX 32
@@ -147,12 +148,12 @@ static int unmap_keysym(KeyCode keycode) {
     return UIOHOOK_SUCCESS;
 }
 
-static int press_keycode(KeyCode keycode) {
+static int press_keycode(virtual_devices_lock *lock, KeyCode keycode) {
     uint16_t evdev_code = keycode - EVDEV_KEYCODE_OFFSET;
 
-    int status = post_virtual_key(evdev_code, true);
+    int status = post_virtual_key(lock, evdev_code, true);
     if (status == UIOHOOK_SUCCESS) {
-        status = post_virtual_key(evdev_code, false);
+        status = post_virtual_key(lock, evdev_code, false);
     }
 
     return status;
@@ -172,13 +173,16 @@ int hook_post_text(const uint16_t * const text) {
         return UIOHOOK_ERROR_NULL;
     }
 
-    if (helper_disp == NULL) {
+    if (!retain_helper(HELPER_POST)) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: XDisplay helper_disp is unavailable!\n",
                 __FUNCTION__, __LINE__);
         return UIOHOOK_ERROR_X_OPEN_DISPLAY;
     }
 
-    int lock_status = lock_virtual_devices();
+    // Text is only typed on the keyboard, so the pointer can still be used while it's posted.
+    virtual_devices_lock lock;
+    int lock_status = lock_virtual_devices(&lock, VIRTUAL_DEVICE_SET_DEFAULT,
+            VIRTUAL_DEVICE_MASK(VIRTUAL_DEVICE_KEYBOARD));
     if (lock_status != UIOHOOK_SUCCESS) {
         return lock_status;
     }
@@ -201,7 +205,7 @@ int hook_post_text(const uint16_t * const text) {
                 __FUNCTION__, __LINE__);
 
         XUnlockDisplay(helper_disp);
-        unlock_virtual_devices();
+        unlock_virtual_devices(&lock);
         return UIOHOOK_FAILURE;
     }
 
@@ -258,7 +262,7 @@ int hook_post_text(const uint16_t * const text) {
 
         for (size_t i = index; i < end && status == UIOHOOK_SUCCESS; i++) {
             if (press_keycodes[i] != 0) {
-                status = press_keycode(press_keycodes[i]);
+                status = press_keycode(&lock, press_keycodes[i]);
                 wait_for_delay();
             }
         }
@@ -281,7 +285,7 @@ int hook_post_text(const uint16_t * const text) {
 
     XSync(helper_disp, True);
     XUnlockDisplay(helper_disp);
-    unlock_virtual_devices();
+    unlock_virtual_devices(&lock);
 
     return status;
 }
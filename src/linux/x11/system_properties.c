@@ -1,29 +1,78 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/XKBlib.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/Intrinsic.h>
+#include <xcb/randr.h>
+#include <xcb/xkb.h>
 
 #include <uiohook.h>
 
+#include "backend_lifecycle.h"
+#include "dispatch_event.h"
 #include "input_helper.h"
 #include "logger.h"
+#include "preload_thread.h"
+#include "screen_info.h"
 #include "system_properties.h"
+#include "timed_post.h"
+#include "uinput_helper.h"
+
+// X11 doesn't report changes of the pointer control, so the settings thread polls for them.
+#define SETTINGS_POLL_MS 1000
+
+static XtAppContext xt_context = NULL;
+static Display *xt_disp = NULL;
 
-static XtAppContext xt_context;
-static Display *xt_disp;
+static pthread_mutex_t helper_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int helper_references[HELPER_CAPABILITY_COUNT];
+
+typedef struct _settings_thread_state {
+    pthread_t thread;
+    int stop_fd;
+    struct _settings_thread_state *next;
+} settings_thread_state;
+
+// The settings thread may be calling the settings changed callback, which may call back into the API and take the
+// helper mutex, so threads which were told to stop are only joined once the mutex is released.
+static settings_thread_state *settings_thread = NULL;
+static settings_thread_state *stopped_settings_threads = NULL;
 
 static pthread_mutex_t screen_mutex = PTHREAD_MUTEX_INITIALIZER;
 static screen_data *screens = NULL;
 static uint8_t screen_count = 0;
+static uint32_t screen_layout_version = 0;
 static uint16_t desktop_width = 0;
 static uint16_t desktop_height = 0;
 
+typedef struct {
+    bool repeat_valid;
+    uint16_t repeat_delay;
+    uint16_t repeat_interval;
+
+    bool pointer_valid;
+    uint16_t accel_numerator;
+    uint16_t accel_denominator;
+    uint16_t threshold;
+} settings_snapshot;
+
+// The settings which the getters report, kept up to date by the settings thread while they're in use.
+static pthread_mutex_t settings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static settings_snapshot settings = { 0 };
+static bool settings_watched = false;
+
 uint32_t hook_get_optional_feature_support() {
     return UIOHOOK_FEATURE_KEY_TYPED_EVENTS
         | UIOHOOK_FEATURE_POST_TEXT
@@ -35,6 +84,10 @@ uint32_t hook_get_optional_feature_support() {
 static void publish_screens(screen_data *new_screens, uint8_t new_count, uint16_t width, uint16_t height) {
     pthread_mutex_lock(&screen_mutex);
 
+    if (!screens_equal(new_screens, new_count, screens, screen_count)) {
+        screen_layout_version = next_layout_version(screen_layout_version);
+    }
+
     free(screens);
 
     screens = new_screens;
@@ -46,9 +99,39 @@ static void publish_screens(screen_data *new_screens, uint8_t new_count, uint16_
 }
 
 static void refresh_screens(Display *disp, Window root, bool poll_hardware) {
-    XRRScreenResources *resources = poll_hardware
-        ? XRRGetScreenResources(disp, root)
-        : XRRGetScreenResourcesCurrent(disp, root);
+    xcb_connection_t *connection = XGetXCBConnection(disp);
+    xcb_generic_error_t *error = NULL;
+
+    void *resources = NULL;
+    xcb_randr_crtc_t *crtcs = NULL;
+    int crtc_count = 0;
+    xcb_timestamp_t config_timestamp = XCB_CURRENT_TIME;
+
+    if (poll_hardware) {
+        xcb_randr_get_screen_resources_reply_t *reply = xcb_randr_get_screen_resources_reply(connection,
+                xcb_randr_get_screen_resources(connection, (xcb_window_t) root), &error);
+
+        if (reply != NULL) {
+            crtcs = xcb_randr_get_screen_resources_crtcs(reply);
+            crtc_count = xcb_randr_get_screen_resources_crtcs_length(reply);
+            config_timestamp = reply->config_timestamp;
+        }
+
+        resources = reply;
+    } else {
+        xcb_randr_get_screen_resources_current_reply_t *reply = xcb_randr_get_screen_resources_current_reply(
+                connection, xcb_randr_get_screen_resources_current(connection, (xcb_window_t) root), &error);
+
+        if (reply != NULL) {
+            crtcs = xcb_randr_get_screen_resources_current_crtcs(reply);
+            crtc_count = xcb_randr_get_screen_resources_current_crtcs_length(reply);
+            config_timestamp = reply->config_timestamp;
+        }
+
+        resources = reply;
+    }
+
+    free(error);
 
     if (resources == NULL) {
         logger(LOG_LEVEL_WARN, "%s [%u]: XRandR could not get screen resources!\n",
@@ -58,38 +141,56 @@ static void refresh_screens(Display *disp, Window root, bool poll_hardware) {
     }
 
     screen_data *new_screens = NULL;
+    xcb_randr_get_crtc_info_cookie_t *cookies = NULL;
     uint8_t new_count = 0;
 
     int32_t min_x = INT32_MAX, min_y = INT32_MAX, max_x = INT32_MIN, max_y = INT32_MIN;
 
-    if (resources->ncrtc > 0) {
-        new_screens = malloc(sizeof(screen_data) * resources->ncrtc);
-        if (new_screens == NULL) {
+    if (crtc_count > 0) {
+        new_screens = malloc(sizeof(screen_data) * crtc_count);
+        cookies = malloc(sizeof(xcb_randr_get_crtc_info_cookie_t) * crtc_count);
+
+        if (new_screens == NULL || cookies == NULL) {
             logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the screen layout!\n",
                     __FUNCTION__, __LINE__);
 
-            XRRFreeScreenResources(resources);
+            free(cookies);
+            free(new_screens);
+            free(resources);
             return;
         }
     }
 
-    for (int i = 0; i < resources->ncrtc; i++) {
-        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(disp, resources, resources->crtcs[i]);
+    // Send every crtc request up front, so the whole layout costs a single round trip.
+    for (int i = 0; i < crtc_count; i++) {
+        cookies[i] = xcb_randr_get_crtc_info(connection, crtcs[i], config_timestamp);
+    }
+
+    for (int i = 0; i < crtc_count; i++) {
+        xcb_randr_get_crtc_info_reply_t *crtc_info = xcb_randr_get_crtc_info_reply(connection, cookies[i], &error);
 
         if (crtc_info == NULL) {
-            logger(LOG_LEVEL_WARN, "%s [%u]: XRandR failed to return crtc information! (%#lX)\n",
-                    __FUNCTION__, __LINE__, resources->crtcs[i]);
+            logger(LOG_LEVEL_WARN, "%s [%u]: XRandR failed to return crtc information! (%#X)\n",
+                    __FUNCTION__, __LINE__, crtcs[i]);
 
+            free(error);
+            error = NULL;
             continue;
         }
 
         // Disabled crtcs report no mode and a zero size, so ignore them.
-        if (crtc_info->mode != None && crtc_info->width > 0 && crtc_info->height > 0) {
+        if (crtc_info->mode != XCB_NONE && crtc_info->width > 0 && crtc_info->height > 0) {
             if (new_count == UINT8_MAX) {
                 logger(LOG_LEVEL_WARN, "%s [%u]: Screen count overflow detected!\n",
                         __FUNCTION__, __LINE__);
 
-                XRRFreeCrtcInfo(crtc_info);
+                free(crtc_info);
+
+                // The remaining replies are already on their way, so drop them instead of waiting.
+                for (int j = i + 1; j < crtc_count; j++) {
+                    xcb_discard_reply(connection, cookies[j].sequence);
+                }
+
                 break;
             }
 
@@ -120,9 +221,11 @@ static void refresh_screens(Display *disp, Window root, bool poll_hardware) {
             }
         }
 
-        XRRFreeCrtcInfo(crtc_info);
+        free(crtc_info);
     }
 
+    free(cookies);
+
     if (new_count == 0) {
         free(new_screens);
         new_screens = NULL;
@@ -137,66 +240,492 @@ static void refresh_screens(Display *disp, Window root, bool poll_hardware) {
         new_count > 0 ? (uint16_t) (max_x - min_x) : 0,
         new_count > 0 ? (uint16_t) (max_y - min_y) : 0);
 
-    XRRFreeScreenResources(resources);
+    free(resources);
+}
+
+// Sends the keyboard and pointer settings requests together and only then waits for their replies.
+static void query_settings(Display *disp, settings_snapshot *settings) {
+    *settings = (settings_snapshot) { 0 };
+
+    xcb_connection_t *connection = XGetXCBConnection(disp);
+    xcb_generic_error_t *error = NULL;
+
+    // Xlib has already enabled XKB for the connection when the display was opened.
+    xcb_xkb_get_controls_cookie_t controls_cookie = xcb_xkb_get_controls(connection, XCB_XKB_ID_USE_CORE_KBD);
+    xcb_get_pointer_control_cookie_t pointer_cookie = xcb_get_pointer_control(connection);
+
+    xcb_xkb_get_controls_reply_t *controls = xcb_xkb_get_controls_reply(connection, controls_cookie, &error);
+    if (controls != NULL) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: XkbGetControls: %u, %u.\n",
+                __FUNCTION__, __LINE__, controls->repeatDelay, controls->repeatInterval);
+
+        settings->repeat_valid = true;
+        settings->repeat_delay = controls->repeatDelay;
+        settings->repeat_interval = controls->repeatInterval;
+
+        free(controls);
+    } else {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XkbGetControls failed!\n",
+                __FUNCTION__, __LINE__);
+
+        free(error);
+        error = NULL;
+    }
+
+    xcb_get_pointer_control_reply_t *pointer = xcb_get_pointer_control_reply(connection, pointer_cookie, &error);
+    if (pointer != NULL) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: GetPointerControl: %u / %u, %u.\n",
+                __FUNCTION__, __LINE__, pointer->acceleration_numerator, pointer->acceleration_denominator,
+                pointer->threshold);
+
+        settings->pointer_valid = true;
+        settings->accel_numerator = pointer->acceleration_numerator;
+        settings->accel_denominator = pointer->acceleration_denominator;
+        settings->threshold = pointer->threshold;
+
+        free(pointer);
+    } else {
+        logger(LOG_LEVEL_WARN, "%s [%u]: GetPointerControl failed!\n",
+                __FUNCTION__, __LINE__);
+
+        free(error);
+    }
+}
+
+static uint32_t compare_settings(const settings_snapshot *old, const settings_snapshot *new) {
+    uint32_t changed = 0;
+
+    if (old->repeat_valid != new->repeat_valid || old->repeat_interval != new->repeat_interval) {
+        changed |= UIOHOOK_SETTING_AUTO_REPEAT_RATE;
+    }
+
+    if (old->repeat_valid != new->repeat_valid || old->repeat_delay != new->repeat_delay) {
+        changed |= UIOHOOK_SETTING_AUTO_REPEAT_DELAY;
+    }
+
+    if (old->pointer_valid != new->pointer_valid || old->accel_denominator != new->accel_denominator) {
+        changed |= UIOHOOK_SETTING_POINTER_ACCELERATION_MULTIPLIER;
+    }
+
+    if (old->pointer_valid != new->pointer_valid || old->threshold != new->threshold) {
+        changed |= UIOHOOK_SETTING_POINTER_ACCELERATION_THRESHOLD;
+    }
+
+    if (old->pointer_valid != new->pointer_valid || old->accel_numerator != new->accel_numerator) {
+        changed |= UIOHOOK_SETTING_POINTER_SENSITIVITY;
+    }
+
+    return changed;
 }
 
-static void settings_cleanup_proc(void *arg) {
-    if (arg != NULL) {
-        XCloseDisplay((Display *) arg);
+static void refresh_settings(Display *disp, bool notify) {
+    settings_snapshot snapshot;
+    query_settings(disp, &snapshot);
+
+    pthread_mutex_lock(&settings_mutex);
+
+    uint32_t changed = compare_settings(&settings, &snapshot);
+    settings = snapshot;
+
+    pthread_mutex_unlock(&settings_mutex);
+
+    if (notify) {
+        dispatch_settings_changed(changed);
     }
 }
 
+static bool is_settings_watched() {
+    pthread_mutex_lock(&settings_mutex);
+    bool watched = settings_watched;
+    pthread_mutex_unlock(&settings_mutex);
+
+    return watched;
+}
+
+static void set_settings_watched(bool watched) {
+    pthread_mutex_lock(&settings_mutex);
+
+    settings_watched = watched;
+    if (!watched) {
+        settings = (settings_snapshot) { 0 };
+    }
+
+    pthread_mutex_unlock(&settings_mutex);
+}
+
+static void handle_settings_event(Display *settings_disp, Window root, int randr_event_base, int xkb_event_base, XEvent *ev) {
+    if (ev->type == randr_event_base + RRScreenChangeNotify) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Received XRRScreenChangeNotifyEvent.\n",
+                __FUNCTION__, __LINE__);
+
+        XRRUpdateConfiguration(ev);
+        refresh_screens(settings_disp, root, true);
+    } else if (ev->type == xkb_event_base && ((XkbEvent *) ev)->any.xkb_type == XkbControlsNotify) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Received XkbControlsNotifyEvent.\n",
+                __FUNCTION__, __LINE__);
+
+        if (is_settings_watched()) {
+            refresh_settings(settings_disp, true);
+        }
+    }
+}
+
+static int select_controls_events(Display *settings_disp) {
+    int opcode = 0, event_base = 0, error_base = 0;
+    int major = XkbMajorVersion, minor = XkbMinorVersion;
+
+    // The key repeat settings are part of the RepeatKeys control.
+    if (!XkbQueryExtension(settings_disp, &opcode, &event_base, &error_base, &major, &minor)
+            || !XkbSelectEventDetails(settings_disp, XkbUseCoreKbd, XkbControlsNotify,
+                    XkbRepeatKeysMask, XkbRepeatKeysMask)) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Cannot watch for keyboard control changes!\n",
+                __FUNCTION__, __LINE__);
+
+        return -1;
+    }
+
+    return event_base;
+}
+
 static void *settings_thread_proc(void *arg) {
+    settings_thread_state *state = arg;
+
     Display *settings_disp = XOpenDisplay(XDisplayName(NULL));
-    if (settings_disp != NULL) {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
-                __FUNCTION__, __LINE__, "XOpenDisplay success.");
+    if (settings_disp == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: XOpenDisplay failure!\n",
+                __FUNCTION__, __LINE__);
+
+        return NULL;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
+            __FUNCTION__, __LINE__, "XOpenDisplay success.");
+
+    int event_base = 0;
+    int error_base = 0;
+    if (XRRQueryExtension(settings_disp, &event_base, &error_base)) {
+        Window root = XDefaultRootWindow(settings_disp);
+        XRRSelectInput(settings_disp, root, RRScreenChangeNotifyMask);
 
-        pthread_cleanup_push(settings_cleanup_proc, settings_disp);
+        int xkb_event_base = select_controls_events(settings_disp);
 
-        int event_base = 0;
-        int error_base = 0;
-        if (XRRQueryExtension(settings_disp, &event_base, &error_base)) {
-            Window root = XDefaultRootWindow(settings_disp);
-            XRRSelectInput(settings_disp, root, RRScreenChangeNotifyMask);
+        refresh_screens(settings_disp, root, false);
 
-            refresh_screens(settings_disp, root, false);
+        struct pollfd fds[2];
 
-            XEvent ev;
+        fds[0].fd = ConnectionNumber(settings_disp);
+        fds[0].events = POLLIN;
 
-            while (true) {
+        fds[1].fd = state->stop_fd;
+        fds[1].events = POLLIN;
+
+        XEvent ev;
+
+        while (true) {
+            // XPending also reads whatever has arrived on the connection, so drain it before waiting.
+            while (XPending(settings_disp) > 0) {
                 XNextEvent(settings_disp, &ev);
+                handle_settings_event(settings_disp, root, event_base, xkb_event_base, &ev);
+            }
+
+            fds[0].revents = 0;
+            fds[1].revents = 0;
+
+            bool watched = is_settings_watched();
 
-                if (ev.type == event_base + RRScreenChangeNotify) {
-                    logger(LOG_LEVEL_DEBUG, "%s [%u]: Received XRRScreenChangeNotifyEvent.\n",
-                            __FUNCTION__, __LINE__);
+            int result = poll(fds, 2, watched ? SETTINGS_POLL_MS : -1);
+            if (result == 0) {
+                refresh_settings(settings_disp, true);
+                continue;
+            }
 
-                    XRRUpdateConfiguration(&ev);
-                    refresh_screens(settings_disp, root, true);
+            if (result < 0) {
+                if (errno == EINTR) { // We don't care about interruptions here.
+                    continue;
                 }
+
+                logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to poll for X events: %s\n",
+                        __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+                break;
             }
-        } else {
-            logger(LOG_LEVEL_WARN, "%s [%u]: XRandR is not currently available!\n",
-                    __FUNCTION__, __LINE__);
-        }
 
-        // Execute the thread cleanup handler.
-        pthread_cleanup_pop(1);
+            if (fds[1].revents & POLLIN) {
+                break;
+            }
+
+            if (fds[0].revents & (POLLERR | POLLHUP)) {
+                logger(LOG_LEVEL_WARN, "%s [%u]: The connection to the X server was lost!\n",
+                        __FUNCTION__, __LINE__);
+
+                break;
+            }
+        }
     } else {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: XOpenDisplay failure!\n",
+        logger(LOG_LEVEL_WARN, "%s [%u]: XRandR is not currently available!\n",
                 __FUNCTION__, __LINE__);
     }
 
+    XCloseDisplay(settings_disp);
+
     return NULL;
 }
 
-bool get_desktop_bounds(uint16_t *width, uint16_t *height) {
+static void start_settings_thread() {
+    if (settings_thread != NULL) {
+        return;
+    }
+
+    settings_thread_state *state = malloc(sizeof(settings_thread_state));
+    if (state == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the settings thread!\n",
+                __FUNCTION__, __LINE__);
+
+        return;
+    }
+
+    state->next = NULL;
+    state->stop_fd = eventfd(0, EFD_NONBLOCK);
+    if (state->stop_fd < 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the settings thread stop event: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        free(state);
+        return;
+    }
+
+    if (pthread_create(&state->thread, NULL, settings_thread_proc, state) == 0) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Successfully created settings thread.\n",
+                __FUNCTION__, __LINE__);
+
+        settings_thread = state;
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create settings thread!\n",
+                __FUNCTION__, __LINE__);
+
+        close(state->stop_fd);
+        free(state);
+    }
+}
+
+// Tells the settings thread to stop, and leaves it to be joined once the helper mutex is released. Called under it.
+static void stop_settings_thread() {
+    if (settings_thread == NULL) {
+        return;
+    }
+
+    uint64_t value = 1;
+    if (write(settings_thread->stop_fd, &value, sizeof(value)) < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to signal the settings thread to stop: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+    }
+
+    settings_thread->next = stopped_settings_threads;
+    stopped_settings_threads = settings_thread;
+    settings_thread = NULL;
+}
+
+// Takes the settings threads which were stopped, so that they can be joined once the helper mutex is released.
+static settings_thread_state *take_stopped_settings_threads_locked() {
+    settings_thread_state *stopped = stopped_settings_threads;
+    stopped_settings_threads = NULL;
+
+    return stopped;
+}
+
+static void join_settings_threads(settings_thread_state *stopped) {
+    while (stopped != NULL) {
+        settings_thread_state *next = stopped->next;
+
+        pthread_join(stopped->thread, NULL);
+        close(stopped->stop_fd);
+        free(stopped);
+
+        stopped = next;
+    }
+}
+
+static void open_xt_display() {
+    XtToolkitInitialize();
+    xt_context = XtCreateApplicationContext();
+
+    int argc = 0;
+    char ** argv = { NULL };
+    xt_disp = XtOpenDisplay(xt_context, NULL, "UIOHook", "libuiohook", NULL, 0, &argc, argv);
+    if (xt_disp == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XtOpenDisplay failure!\n",
+                __FUNCTION__, __LINE__);
+    }
+}
+
+static void close_xt_display() {
+    if (xt_disp != NULL) {
+        XtCloseDisplay(xt_disp);
+        xt_disp = NULL;
+    }
+
+    if (xt_context != NULL) {
+        XtDestroyApplicationContext(xt_context);
+        xt_context = NULL;
+    }
+}
+
+static bool is_helper_unused() {
+    for (int i = 0; i < HELPER_CAPABILITY_COUNT; i++) {
+        if (helper_references[i] > 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool activate_helper(helper_capability capability) {
+    // Every capability goes through the helper display, so it's opened along with the first one.
+    if (helper_disp == NULL) {
+        helper_disp = XOpenDisplay(XDisplayName(NULL));
+        if (helper_disp == NULL) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: %s\n",
+                    __FUNCTION__, __LINE__, "XOpenDisplay failure!");
+
+            return false;
+        }
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
+                __FUNCTION__, __LINE__, "XOpenDisplay success.");
+    }
+
+    switch (capability) {
+        case HELPER_SCREENS:
+            // Refresh screens right away, so we don't wait for the settings thread to initialize.
+            refresh_screens(helper_disp, XDefaultRootWindow(helper_disp), false);
+            start_settings_thread();
+            break;
+
+        case HELPER_SETTINGS:
+            refresh_settings(helper_disp, false);
+            set_settings_watched(true);
+
+            // A thread which only watches the screens waits without a timeout, so restart it to poll as well.
+            stop_settings_thread();
+            start_settings_thread();
+            break;
+
+        case HELPER_XT:
+            open_xt_display();
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+static void deactivate_helper(helper_capability capability) {
+    switch (capability) {
+        case HELPER_SCREENS:
+            if (helper_references[HELPER_SETTINGS] == 0) {
+                stop_settings_thread();
+            }
+
+            publish_screens(NULL, 0, 0, 0);
+            break;
+
+        case HELPER_SETTINGS:
+            if (helper_references[HELPER_SCREENS] == 0) {
+                stop_settings_thread();
+            }
+
+            set_settings_watched(false);
+            break;
+
+        case HELPER_XT:
+            close_xt_display();
+            break;
+
+        default:
+            break;
+    }
+
+    if (is_helper_unused() && helper_disp != NULL) {
+        XCloseDisplay(helper_disp);
+        helper_disp = NULL;
+    }
+}
+
+static bool acquire_helper_locked(helper_capability capability) {
+    if (helper_references[capability] == 0 && !activate_helper(capability)) {
+        return false;
+    }
+
+    helper_references[capability]++;
+
+    return true;
+}
+
+bool acquire_helper(helper_capability capability) {
+    pthread_mutex_lock(&helper_mutex);
+    bool available = acquire_helper_locked(capability);
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
+    pthread_mutex_unlock(&helper_mutex);
+
+    join_settings_threads(stopped);
+
+    return available;
+}
+
+void release_helper(helper_capability capability) {
+    pthread_mutex_lock(&helper_mutex);
+
+    if (helper_references[capability] > 0) {
+        helper_references[capability]--;
+
+        if (helper_references[capability] == 0) {
+            deactivate_helper(capability);
+        }
+    }
+
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
+
+    pthread_mutex_unlock(&helper_mutex);
+
+    join_settings_threads(stopped);
+}
+
+bool retain_helper(helper_capability capability) {
+    pthread_mutex_lock(&helper_mutex);
+
+    bool available = helper_references[capability] > 0;
+    if (!available) {
+        // The reference taken here is only released when the library is unloaded.
+        available = acquire_helper_locked(capability);
+    }
+
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
+
+    pthread_mutex_unlock(&helper_mutex);
+
+    join_settings_threads(stopped);
+
+    return available;
+}
+
+bool get_desktop_geometry(uint16_t *width, uint16_t *height, int16_t *origin_x, int16_t *origin_y) {
+    if (!retain_helper(HELPER_SCREENS)) {
+        return false;
+    }
+
     pthread_mutex_lock(&screen_mutex);
 
     bool available = screen_count > 0;
     if (available) {
         *width = desktop_width;
         *height = desktop_height;
+
+        // Coordinates are relative to the first screen's origin on multi-monitor layouts only.
+        *origin_x = screen_count > 1 ? screens[0].x : 0;
+        *origin_y = screen_count > 1 ? screens[0].y : 0;
     }
 
     pthread_mutex_unlock(&screen_mutex);
@@ -205,6 +734,10 @@ bool get_desktop_bounds(uint16_t *width, uint16_t *height) {
 }
 
 bool get_screen_origin(int16_t *x, int16_t *y) {
+    if (!retain_helper(HELPER_SCREENS)) {
+        return false;
+    }
+
     pthread_mutex_lock(&screen_mutex);
 
     // Coordinates are relative to the first screen's origin on multi-monitor layouts only.
@@ -223,6 +756,10 @@ screen_data* hook_create_screen_info(unsigned char *count) {
     *count = 0;
     screen_data *result = NULL;
 
+    if (!retain_helper(HELPER_SCREENS)) {
+        return NULL;
+    }
+
     pthread_mutex_lock(&screen_mutex);
 
     if (screen_count > 0) {
@@ -245,123 +782,89 @@ screen_data* hook_create_screen_info(unsigned char *count) {
     return result;
 }
 
-long int hook_get_auto_repeat_rate() {
-    bool successful = false;
-    long int value = -1;
-    unsigned int delay = 0, rate = 0;
+uint8_t hook_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *layout_version) {
+    if (!retain_helper(HELPER_SCREENS)) {
+        return 0;
+    }
 
-    // Check and make sure we could connect to the X server.
-    if (helper_disp != NULL) {
-        // Attempt to acquire the keyboard auto repeat rate using the XKB extension.
-        if (!successful) {
-            successful = XkbGetAutoRepeatRate(helper_disp, XkbUseCoreKbd, &delay, &rate);
+    pthread_mutex_lock(&screen_mutex);
 
-            if (successful) {
-                logger(LOG_LEVEL_DEBUG, "%s [%u]: XkbGetAutoRepeatRate: %u.\n",
-                        __FUNCTION__, __LINE__, rate);
-            }
-        }
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: XDisplay helper_disp is unavailable!\n",
-                __FUNCTION__, __LINE__);
-    }
+    uint8_t count = copy_layout(buf, capacity, layout_version, screens, screen_count, screen_layout_version);
 
-    if (successful) {
-        value = (long int) rate;
-    }
+    pthread_mutex_unlock(&screen_mutex);
 
-    return value;
+    return count;
 }
 
-long int hook_get_auto_repeat_delay() {
-    bool successful = false;
-    long int value = -1;
-    unsigned int delay = 0, rate = 0;
+static bool get_settings(settings_snapshot *snapshot) {
+    // Don't touch the helper lock if the settings are already watched, so that the settings changed proc can call
+    // the getters while the settings thread is being stopped.
+    pthread_mutex_lock(&settings_mutex);
+    if (settings_watched) {
+        *snapshot = settings;
+        pthread_mutex_unlock(&settings_mutex);
+        return true;
+    }
+    pthread_mutex_unlock(&settings_mutex);
 
     // Check and make sure we could connect to the X server.
-    if (helper_disp != NULL) {
-        // Attempt to acquire the keyboard auto repeat rate using the XKB extension.
-        if (!successful) {
-            successful = XkbGetAutoRepeatRate(helper_disp, XkbUseCoreKbd, &delay, &rate);
-
-            if (successful) {
-                logger(LOG_LEVEL_DEBUG, "%s [%u]: XkbGetAutoRepeatRate: %u.\n",
-                        __FUNCTION__, __LINE__, delay);
-            }
-        }
-    } else {
+    if (!retain_helper(HELPER_SETTINGS)) {
         logger(LOG_LEVEL_WARN, "%s [%u]: XDisplay helper_disp is unavailable!\n",
                 __FUNCTION__, __LINE__);
-    }
 
-    if (successful) {
-        value = (long int) delay;
+        return false;
     }
 
-    return value;
+    pthread_mutex_lock(&settings_mutex);
+    *snapshot = settings;
+    pthread_mutex_unlock(&settings_mutex);
+
+    return true;
 }
 
-long int hook_get_pointer_acceleration_multiplier() {
-    long int value = -1;
-    int accel_numerator, accel_denominator, threshold;
+long int hook_get_auto_repeat_rate() {
+    settings_snapshot snapshot;
+    if (get_settings(&snapshot) && snapshot.repeat_valid) {
+        return (long int) snapshot.repeat_interval;
+    }
 
-    // Check and make sure we could connect to the x server.
-    if (helper_disp != NULL) {
-        XGetPointerControl(helper_disp, &accel_numerator, &accel_denominator, &threshold);
-        if (accel_denominator >= 0) {
-            logger(LOG_LEVEL_DEBUG, "%s [%u]: XGetPointerControl: %i.\n",
-                    __FUNCTION__, __LINE__, accel_denominator);
+    return -1;
+}
 
-            value = (long int) accel_denominator;
-        }
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: XDisplay helper_disp is unavailable!\n",
-                __FUNCTION__, __LINE__);
+long int hook_get_auto_repeat_delay() {
+    settings_snapshot snapshot;
+    if (get_settings(&snapshot) && snapshot.repeat_valid) {
+        return (long int) snapshot.repeat_delay;
     }
 
-    return value;
+    return -1;
 }
 
-long int hook_get_pointer_acceleration_threshold() {
-    long int value = -1;
-    int accel_numerator, accel_denominator, threshold;
+long int hook_get_pointer_acceleration_multiplier() {
+    settings_snapshot snapshot;
+    if (get_settings(&snapshot) && snapshot.pointer_valid) {
+        return (long int) snapshot.accel_denominator;
+    }
 
-    // Check and make sure we could connect to the x server.
-    if (helper_disp != NULL) {
-        XGetPointerControl(helper_disp, &accel_numerator, &accel_denominator, &threshold);
-        if (threshold >= 0) {
-            logger(LOG_LEVEL_DEBUG, "%s [%u]: XGetPointerControl: %i.\n",
-                    __FUNCTION__, __LINE__, threshold);
+    return -1;
+}
 
-            value = (long int) threshold;
-        }
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: XDisplay helper_disp is unavailable!\n",
-                __FUNCTION__, __LINE__);
+long int hook_get_pointer_acceleration_threshold() {
+    settings_snapshot snapshot;
+    if (get_settings(&snapshot) && snapshot.pointer_valid) {
+        return (long int) snapshot.threshold;
     }
 
-    return value;
+    return -1;
 }
 
 long int hook_get_pointer_sensitivity() {
-    long int value = -1;
-    int accel_numerator, accel_denominator, threshold;
-
-    // Check and make sure we could connect to the x server.
-    if (helper_disp != NULL) {
-        XGetPointerControl(helper_disp, &accel_numerator, &accel_denominator, &threshold);
-        if (accel_numerator >= 0) {
-            logger(LOG_LEVEL_DEBUG, "%s [%u]: XGetPointerControl: %i.\n",
-                    __FUNCTION__, __LINE__, accel_numerator);
-
-            value = (long int) accel_numerator;
-        }
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: XDisplay helper_disp is unavailable!\n",
-                __FUNCTION__, __LINE__);
+    settings_snapshot snapshot;
+    if (get_settings(&snapshot) && snapshot.pointer_valid) {
+        return (long int) snapshot.accel_numerator;
     }
 
-    return value;
+    return -1;
 }
 
 long int hook_get_multi_click_time() {
@@ -369,6 +872,8 @@ long int hook_get_multi_click_time() {
     int click_time;
     bool successful = false;
 
+    retain_helper(HELPER_XT);
+
     // Check and make sure we could connect to the X server.
     if (xt_disp != NULL) {
         // Try and use the Xt extention to get the current multi-click.
@@ -424,62 +929,74 @@ long int hook_get_multi_click_time() {
 // Create a shared object constructor.
 __attribute__ ((constructor))
 void on_library_load() {
-    // Make sure we are initialized for threading.
+    // Xlib has to be initialized for threading before any other call into it, so this can't wait for the first display.
     XInitThreads();
+}
 
-    // Open local display.
-    helper_disp = XOpenDisplay(XDisplayName(NULL));
-    if (helper_disp == NULL) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: %s\n",
-                __FUNCTION__, __LINE__, "XOpenDisplay failure!");
-    } else {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
-                __FUNCTION__, __LINE__, "XOpenDisplay success.");
-
-        // Refresh screens right away, so we don't wait for the settings thread to initialize.
-        refresh_screens(helper_disp, XDefaultRootWindow(helper_disp), false);
-    }
-
-    // Create the thread attribute.
-    pthread_attr_t settings_thread_attr;
-    pthread_attr_init(&settings_thread_attr);
+void release_helpers() {
+    pthread_mutex_lock(&helper_mutex);
 
-    pthread_t settings_thread_id;
-    if (pthread_create(&settings_thread_id, &settings_thread_attr, settings_thread_proc, NULL) == 0) {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: Successfully created settings thread.\n",
-                __FUNCTION__, __LINE__);
-    } else {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create settings thread!\n",
-                __FUNCTION__, __LINE__);
+    for (int i = 0; i < HELPER_CAPABILITY_COUNT; i++) {
+        if (helper_references[i] > 0) {
+            helper_references[i] = 0;
+            deactivate_helper((helper_capability) i);
+        }
     }
 
-    // Make sure the thread attribute is removed.
-    pthread_attr_destroy(&settings_thread_attr);
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
 
-    // Open XT display.
-    XtToolkitInitialize();
-    xt_context = XtCreateApplicationContext();
+    pthread_mutex_unlock(&helper_mutex);
 
-    int argc = 0;
-    char ** argv = { NULL };
-    xt_disp = XtOpenDisplay(xt_context, NULL, "UIOHook", "libuiohook", NULL, 0, &argc, argv);
+    join_settings_threads(stopped);
 }
 
 // Create a shared object destructor.
 __attribute__ ((destructor))
 void on_library_unload() {
-    publish_screens(NULL, 0, 0, 0);
+    release_helpers();
+}
 
-    if (xt_disp != NULL) {
-        XtCloseDisplay(xt_disp);
-    }
+static int preload_helpers() {
+    // The helpers are kept like the getters keep them, until the library is unloaded.
+    static const helper_capability capabilities[] = { HELPER_SCREENS, HELPER_SETTINGS, HELPER_XT, HELPER_POST };
 
-    if (xt_context != NULL) {
-        XtDestroyApplicationContext(xt_context);
+    int status = UIOHOOK_SUCCESS;
+    for (size_t i = 0; i < sizeof(capabilities) / sizeof(capabilities[0]); i++) {
+        if (!retain_helper(capabilities[i])) {
+            status = UIOHOOK_ERROR_X_OPEN_DISPLAY;
+        }
     }
 
-    if (helper_disp != NULL) {
-        XCloseDisplay(helper_disp);
-        helper_disp = NULL;
+    return status;
+}
+
+#ifdef UIOHOOK_STATIC_BACKEND
+// Built into libuiohook, the back-end has no loader which calls this on a thread of its own.
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    return start_preload_thread(preload_helpers, done_proc, user_data);
+}
+#else
+// The loader already calls this on a thread of its own, so the helpers are opened right here.
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    int status = preload_helpers();
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Preloaded the back-end. (%#X)\n",
+            __FUNCTION__, __LINE__, status);
+
+    if (done_proc != NULL) {
+        done_proc(status, user_data);
     }
+
+    return status;
+}
+#endif
+
+bool backend_is_busy() {
+    return is_timed_post_active() || virtual_device_sets_exist();
+}
+
+void backend_release() {
+    stop_timed_post();
+    destroy_all_virtual_devices();
+    release_helpers();
 }
@@ -4,8 +4,32 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-/* Gets the size of the bounding box of every enabled screen. */
-bool get_desktop_bounds(uint16_t *width, uint16_t *height);
+/* The helper resources which are initialised on first use, each with its own reference count. */
+typedef enum {
+    HELPER_SCREENS,   // The screen layout cache and the thread which keeps it up to date.
+    HELPER_SETTINGS,  // The keyboard and pointer settings queries.
+    HELPER_XT,        // The X Toolkit display which the multi-click time is read from.
+    HELPER_POST,      // The keyboard remapping which text is typed through.
+    HELPER_CAPABILITY_COUNT
+} helper_capability;
+
+/* Acquires a reference to a helper capability, initialising it if it isn't in use yet. */
+bool acquire_helper(helper_capability capability);
+
+/* Releases a reference to a helper capability, freeing it once it isn't in use anymore. */
+void release_helper(helper_capability capability);
+
+/* Makes sure a helper capability is initialised, keeping it until the library is unloaded unless
+ * something else already holds it. Used by the getters which can be called at any time. */
+bool retain_helper(helper_capability capability);
+
+/* Drops every helper reference and frees the helpers, joining their threads. They are opened again when
+ * something acquires them later on. */
+void release_helpers();
+
+/* Gets the size of the bounding box of every enabled screen, and the origin which pointer coordinates are
+ * relative to within it. */
+bool get_desktop_geometry(uint16_t *width, uint16_t *height, int16_t *origin_x, int16_t *origin_y);
 
 /* Gets the origin which pointer coordinates are relative to. */
 bool get_screen_origin(int16_t *x, int16_t *y);
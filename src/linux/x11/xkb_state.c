@@ -0,0 +1,99 @@
+#include <stdbool.h>
+
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+
+#include "logger.h"
+#include "xkb_state.h"
+
+#define XKB_STATE_EVENTS (XkbMapNotifyMask | XkbNewKeyboardNotifyMask | XkbStateNotifyMask)
+#define XKB_STATE_DETAILS (XkbModifierStateMask | XkbGroupStateMask)
+
+static bool tracked = false;
+static int event_base = 0;
+
+static unsigned char effective_mods = 0;
+static int effective_group = 0;
+
+bool xkb_state_init(Display *disp) {
+    int opcode = 0, error_base = 0;
+    int major = XkbMajorVersion, minor = XkbMinorVersion;
+
+    tracked = false;
+
+    if (!XkbQueryExtension(disp, &opcode, &event_base, &error_base, &major, &minor)) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: The XKB extension is unavailable!\n",
+                __FUNCTION__, __LINE__);
+
+        return false;
+    }
+
+    // Only modifier and group changes are interesting, not every pointer button or compatibility change.
+    if (!XkbSelectEvents(disp, XkbUseCoreKbd, XKB_STATE_EVENTS, XKB_STATE_EVENTS)
+            || !XkbSelectEventDetails(disp, XkbUseCoreKbd, XkbStateNotify, XKB_STATE_DETAILS, XKB_STATE_DETAILS)) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to select the XKB events!\n",
+                __FUNCTION__, __LINE__);
+
+        return false;
+    }
+
+    // Any change after this request is delivered as an event, so nothing is missed in between.
+    XkbStateRec state;
+    if (XkbGetState(disp, XkbUseCoreKbd, &state) != Success) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XkbGetState() failed!\n",
+                __FUNCTION__, __LINE__);
+
+        return false;
+    }
+
+    effective_mods = state.mods;
+    effective_group = state.group;
+    tracked = true;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Tracking the XKB state, starting with group %i and modifiers %#X.\n",
+            __FUNCTION__, __LINE__, effective_group, effective_mods);
+
+    return true;
+}
+
+void xkb_state_reset() {
+    tracked = false;
+    effective_mods = 0;
+    effective_group = 0;
+}
+
+bool xkb_state_handle_event(XEvent *event) {
+    if (!tracked || event->type != event_base) {
+        return false;
+    }
+
+    XkbEvent *xkb_event = (XkbEvent *) event;
+
+    switch (xkb_event->any.xkb_type) {
+        case XkbStateNotify:
+            effective_mods = xkb_event->state.mods;
+            effective_group = xkb_event->state.group;
+            break;
+
+        case XkbMapNotify:
+            XkbRefreshKeyboardMapping(&xkb_event->map);
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+bool xkb_state_is_tracked() {
+    return tracked;
+}
+
+int xkb_state_get_group() {
+    return effective_group;
+}
+
+unsigned int xkb_state_get_core_state() {
+    return XkbBuildCoreState(effective_mods, effective_group);
+}
@@ -0,0 +1,28 @@
+#ifndef X11_XKB_STATE_H
+#define X11_XKB_STATE_H
+
+#include <stdbool.h>
+
+#include <X11/Xlib.h>
+
+/* Selects the XKB events which keep the keyboard state up to date on the display and seeds the state
+ * from the X server. This is the only call which waits for the X server. */
+bool xkb_state_init(Display *disp);
+
+/* Forgets the tracked keyboard state. */
+void xkb_state_reset();
+
+/* Updates the tracked keyboard state from an event of the display which xkb_state_init was called with.
+ * Returns false if the event isn't an XKB event. */
+bool xkb_state_handle_event(XEvent *event);
+
+/* Returns true if the keyboard state is being tracked. */
+bool xkb_state_is_tracked();
+
+/* Gets the effective layout group. */
+int xkb_state_get_group();
+
+/* Gets the state mask of an X11 key event which matches the effective modifiers and layout group. */
+unsigned int xkb_state_get_core_state();
+
+#endif
@@ -3,11 +3,18 @@
 #include <wchar.h>
 
 #include "dispatch_event.h"
+#include "hook_stats.h"
 #include "input_helper.h"
 #include "logger.h"
 
 #define WHEEL_DELTA 120
 
+#define NS_PER_MS 1000000
+
+// A local X server timestamps events with the monotonic clock in milliseconds. Events which look older than this were
+// timestamped on another clock, e.g. by a remote server.
+#define SERVER_TIME_AGE_MAX 60000
+
 typedef struct _mouse_click {
     uint16_t count;
     uint64_t time;
@@ -22,6 +29,9 @@ static mouse_click click = {
 // Virtual event pointer.
 static uiohook_event uio_event;
 
+// When the X server timestamped the event which is being dispatched, on the monotonic clock.
+static uint64_t event_time = STATS_NO_EVENT_TIME;
+
 // Event dispatch callback.
 static dispatcher_t dispatch = NULL;
 static void *dispatch_data = NULL;
@@ -48,20 +58,36 @@ void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data) {
 
 // Send out an event if a dispatcher was set.
 static void dispatch_event(uiohook_event *const uio_event) {
+    uint64_t start = stats_get_time();
+    stats_record_event(uio_event->type, event_time, start);
+
     if (dispatch != NULL) {
         logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching event type %u.\n",
                 __FUNCTION__, __LINE__, uio_event->type);
 
         dispatch(uio_event, dispatch_data);
+        stats_record_callback(stats_get_time() - start);
     } else {
+        stats_record_dropped();
+
         logger(LOG_LEVEL_WARN, "%s [%u]: No dispatch callback set!\n",
                 __FUNCTION__, __LINE__);
     }
 }
 
+// The server time wraps around every 49 days, so only the age of the event is taken from it.
+static void set_event_time(Time server_time) {
+    uint64_t now = stats_get_time();
+    uint32_t age = (uint32_t) (now / NS_PER_MS) - (uint32_t) server_time;
+
+    event_time = age <= SERVER_TIME_AGE_MAX ? now - (uint64_t) age * NS_PER_MS : STATS_NO_EVENT_TIME;
+}
+
 bool dispatch_hook_enabled(uint64_t timestamp) {
     bool consumed = false;
 
+    event_time = STATS_NO_EVENT_TIME;
+
     // Populate the hook start event.
     uio_event.time = timestamp;
     uio_event.type = EVENT_HOOK_ENABLED;
@@ -77,6 +103,8 @@ bool dispatch_hook_enabled(uint64_t timestamp) {
 bool dispatch_hook_disabled(uint64_t timestamp) {
     bool consumed = false;
 
+    event_time = STATS_NO_EVENT_TIME;
+
     // Populate the hook stop event.
     uio_event.time = timestamp;
     uio_event.type = EVENT_HOOK_DISABLED;
@@ -91,6 +119,7 @@ bool dispatch_hook_disabled(uint64_t timestamp) {
 
 bool dispatch_key_press(uint64_t timestamp, XKeyPressedEvent * const x_event) {
     bool consumed = false;
+    set_event_time(x_event->time);
 
     uint16_t uiocode = keycode_to_uiocode(x_event->keycode);
 
@@ -162,6 +191,7 @@ bool dispatch_key_press(uint64_t timestamp, XKeyPressedEvent * const x_event) {
 
 bool dispatch_key_release(uint64_t timestamp, XKeyReleasedEvent * const x_event) {
     bool consumed = false;
+    set_event_time(x_event->time);
 
     uint16_t uiocode = keycode_to_uiocode(x_event->keycode);
 
@@ -363,6 +393,7 @@ static bool dispatch_mouse_button_pressed(uint64_t timestamp, XButtonPressedEven
 
 bool dispatch_mouse_press(uint64_t timestamp, XButtonEvent * const x_event) {
     bool consumed = false;
+    set_event_time(x_event->time);
     x_event->button = button_map_lookup(x_event->button);
 
     switch (x_event->button) {
@@ -497,6 +528,7 @@ static bool dispatch_mouse_button_clicked(uint64_t timestamp, XButtonEvent * con
 
 bool dispatch_mouse_release(uint64_t timestamp, XButtonEvent * const x_event) {
     bool consumed = false;
+    set_event_time(x_event->time);
 
     x_event->button = button_map_lookup(x_event->button);
     switch (x_event->button) {
@@ -527,6 +559,7 @@ bool dispatch_mouse_release(uint64_t timestamp, XButtonEvent * const x_event) {
 
 bool dispatch_mouse_move(uint64_t timestamp, XMotionEvent * const x_event) {
     bool consumed = false;
+    set_event_time(x_event->time);
 
     // Reset the click count.
     if (click.count != 0 && x_event->serial - click.time > hook_get_multi_click_time()) {
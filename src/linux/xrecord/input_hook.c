@@ -17,6 +17,7 @@
 #include "dispatch_event.h"
 #include "input_helper.h"
 #include "logger.h"
+#include "system_properties.h"
 
 typedef struct _hook_info {
     struct _data {
@@ -348,7 +349,12 @@ int run() {
         return UIOHOOK_ERROR_OUT_OF_MEMORY;
     }
 
-    int status = xrecord_start();
+    // The hook reads the keyboard state through the helper display for as long as it runs.
+    int status = UIOHOOK_ERROR_X_OPEN_DISPLAY;
+    if (acquire_helper(HELPER_HOOK)) {
+        status = xrecord_start();
+        release_helper(HELPER_HOOK);
+    }
 
     // Free data associated with this hook.
     free(hook);
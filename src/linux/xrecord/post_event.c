@@ -10,6 +10,7 @@
 
 #include "input_helper.h"
 #include "logger.h"
+#include "system_properties.h"
 
 static uint64_t post_text_delay = 50 * 1000000;
 
@@ -204,7 +205,15 @@ int hook_post_event(uiohook_event * const event) {
 }
 
 int hook_post_events(uiohook_event * const events, uint32_t size) {
-    if (helper_disp == NULL) {
+    return hook_post_events_counted(events, size, NULL);
+}
+
+int hook_post_events_counted(uiohook_event * const events, uint32_t size, uint32_t *posted) {
+    if (posted != NULL) {
+        *posted = 0;
+    }
+
+    if (!retain_helper(HELPER_POST)) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: XDisplay helper_disp is unavailable!\n",
                 __FUNCTION__, __LINE__);
         return UIOHOOK_ERROR_X_OPEN_DISPLAY;
@@ -265,6 +274,10 @@ int hook_post_events(uiohook_event * const events, uint32_t size) {
                 status = UIOHOOK_FAILURE;
                 break;
         }
+
+        if (status == UIOHOOK_SUCCESS && posted != NULL) {
+            (*posted)++;
+        }
     }
 
     XSync(helper_disp, True);
@@ -413,7 +426,7 @@ int hook_post_text(const uint16_t * const text) {
         return UIOHOOK_ERROR_NULL;
     }
 
-    if (helper_disp == NULL) {
+    if (!retain_helper(HELPER_POST)) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: XDisplay helper_disp is unavailable!\n",
                 __FUNCTION__, __LINE__);
         return UIOHOOK_ERROR_X_OPEN_DISPLAY;
@@ -464,3 +477,31 @@ int hook_post_text(const uint16_t * const text) {
 
     return status;
 }
+
+// Timed posting relies on the uinput devices, so it isn't available on the XRecord back-end.
+int hook_post_events_timed(uiohook_event * const events, uint32_t size, post_progress_t progress_proc,
+        void *user_data) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_cancel_post_events_timed() {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_relative_motion(const relative_motion_data * const motions, uint32_t size) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_pointer_path(const pointer_waypoint * const waypoints, uint32_t count,
+        const pointer_path_options * const options, post_progress_t progress_proc, void *user_data) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size) {
+    // Only the default devices exist here.
+    if (set_id != 0) {
+        return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+    }
+
+    return hook_post_events(events, size);
+}
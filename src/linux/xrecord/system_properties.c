@@ -1,7 +1,14 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include <X11/Xlib.h>
 #include <X11/XKBlib.h>
@@ -10,11 +17,29 @@
 
 #include <uiohook.h>
 
+#include "backend_lifecycle.h"
 #include "input_helper.h"
 #include "logger.h"
+#include "preload_thread.h"
+#include "screen_info.h"
+#include "system_properties.h"
+
+static XtAppContext xt_context = NULL;
+static Display *xt_disp = NULL;
+
+static pthread_mutex_t helper_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int helper_references[HELPER_CAPABILITY_COUNT];
+
+typedef struct _settings_thread_state {
+    pthread_t thread;
+    int stop_fd;
+    struct _settings_thread_state *next;
+} settings_thread_state;
 
-static XtAppContext xt_context;
-static Display *xt_disp;
+// The settings thread may be calling the settings changed callback, which may call back into the API and take the
+// helper mutex, so threads which were told to stop are only joined once the mutex is released.
+static settings_thread_state *settings_thread = NULL;
+static settings_thread_state *stopped_settings_threads = NULL;
 
 static pthread_mutex_t xrandr_mutex = PTHREAD_MUTEX_INITIALIZER;
 static XRRScreenResources *xrandr_resources = NULL;
@@ -28,81 +53,341 @@ uint32_t hook_get_optional_feature_support() {
         | UIOHOOK_FEATURE_POINTER_PROPERTIES;
 }
 
-static void settings_cleanup_proc(void *arg) {
-    if (pthread_mutex_trylock(&xrandr_mutex) == 0) {
-        if (xrandr_resources != NULL) {
-            XRRFreeScreenResources(xrandr_resources);
-            xrandr_resources = NULL;
-        }
+static void update_screen_resources(Display *disp, Window root, bool poll_hardware) {
+    pthread_mutex_lock(&xrandr_mutex);
 
-        if (arg != NULL) {
-            XCloseDisplay((Display *) arg);
-            arg = NULL;
-        }
+    if (xrandr_resources != NULL) {
+        XRRFreeScreenResources(xrandr_resources);
+    }
 
-        pthread_mutex_unlock(&xrandr_mutex);
+    xrandr_resources = poll_hardware
+        ? XRRGetScreenResources(disp, root)
+        : XRRGetScreenResourcesCurrent(disp, root);
+
+    if (xrandr_resources == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XRandR could not get screen resources!\n",
+                __FUNCTION__, __LINE__);
+    }
+
+    pthread_mutex_unlock(&xrandr_mutex);
+}
+
+static void free_screen_resources() {
+    pthread_mutex_lock(&xrandr_mutex);
+
+    if (xrandr_resources != NULL) {
+        XRRFreeScreenResources(xrandr_resources);
+        xrandr_resources = NULL;
     }
+
+    pthread_mutex_unlock(&xrandr_mutex);
 }
 
 static void *settings_thread_proc(void *arg) {
-    Display *settings_disp = XOpenDisplay(XDisplayName(NULL));;
-    if (settings_disp != NULL) {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
-                __FUNCTION__, __LINE__, "XOpenDisplay success.");
+    settings_thread_state *state = arg;
+
+    Display *settings_disp = XOpenDisplay(XDisplayName(NULL));
+    if (settings_disp == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: XOpenDisplay failure!\n",
+                __FUNCTION__, __LINE__);
+
+        return NULL;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
+            __FUNCTION__, __LINE__, "XOpenDisplay success.");
+
+    int event_base = 0;
+    int error_base = 0;
+    if (XRRQueryExtension(settings_disp, &event_base, &error_base)) {
+        Window root = XDefaultRootWindow(settings_disp);
+        XRRSelectInput(settings_disp, root, RRScreenChangeNotifyMask);
 
-        pthread_cleanup_push(settings_cleanup_proc, settings_disp);
+        struct pollfd fds[2];
 
-        int event_base = 0;
-        int error_base = 0;
-        if (XRRQueryExtension(settings_disp, &event_base, &error_base)) {
-            Window root = XDefaultRootWindow(settings_disp);
-            unsigned long event_mask = RRScreenChangeNotifyMask;
-            XRRSelectInput(settings_disp, root, event_mask);
+        fds[0].fd = ConnectionNumber(settings_disp);
+        fds[0].events = POLLIN;
 
-            XEvent ev;
+        fds[1].fd = state->stop_fd;
+        fds[1].events = POLLIN;
 
-            while(settings_disp != NULL) {
+        XEvent ev;
+
+        while (true) {
+            // XPending also reads whatever has arrived on the connection, so drain it before waiting.
+            while (XPending(settings_disp) > 0) {
                 XNextEvent(settings_disp, &ev);
 
-                if (ev.type == event_base + RRScreenChangeNotifyMask) {
+                if (ev.type == event_base + RRScreenChangeNotify) {
                     logger(LOG_LEVEL_DEBUG, "%s [%u]: Received XRRScreenChangeNotifyEvent.\n",
                             __FUNCTION__, __LINE__);
 
-                    pthread_mutex_lock(&xrandr_mutex);
-                    if (xrandr_resources != NULL) {
-                        XRRFreeScreenResources(xrandr_resources);
-                    }
+                    XRRUpdateConfiguration(&ev);
+                    update_screen_resources(settings_disp, root, true);
+                }
+            }
 
-                    xrandr_resources = XRRGetScreenResources(settings_disp, root);
-                    if (xrandr_resources == NULL) {
-                        logger(LOG_LEVEL_WARN, "%s [%u]: XRandR could not get screen resources!\n",
-                                __FUNCTION__, __LINE__);
-                    }
-                    pthread_mutex_unlock(&xrandr_mutex);
-                } else {
-                    logger(LOG_LEVEL_WARN, "%s [%u]: XRandR is not currently available!\n",
-                            __FUNCTION__, __LINE__);
+            fds[0].revents = 0;
+            fds[1].revents = 0;
+
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) { // We don't care about interruptions here.
+                    continue;
                 }
+
+                logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to poll for X events: %s\n",
+                        __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+                break;
             }
-        }
 
-        // Execute the thread cleanup handler.
-        pthread_cleanup_pop(1);
+            if (fds[1].revents & POLLIN) {
+                break;
+            }
+
+            if (fds[0].revents & (POLLERR | POLLHUP)) {
+                logger(LOG_LEVEL_WARN, "%s [%u]: The connection to the X server was lost!\n",
+                        __FUNCTION__, __LINE__);
 
+                break;
+            }
+        }
     } else {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: XOpenDisplay failure!\n",
+        logger(LOG_LEVEL_WARN, "%s [%u]: XRandR is not currently available!\n",
                 __FUNCTION__, __LINE__);
     }
 
+    XCloseDisplay(settings_disp);
+
     return NULL;
 }
 
+static void start_settings_thread() {
+    if (settings_thread != NULL) {
+        return;
+    }
+
+    settings_thread_state *state = malloc(sizeof(settings_thread_state));
+    if (state == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for the settings thread!\n",
+                __FUNCTION__, __LINE__);
+
+        return;
+    }
+
+    state->next = NULL;
+    state->stop_fd = eventfd(0, EFD_NONBLOCK);
+    if (state->stop_fd < 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the settings thread stop event: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+
+        free(state);
+        return;
+    }
+
+    if (pthread_create(&state->thread, NULL, settings_thread_proc, state) == 0) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Successfully created settings thread.\n",
+                __FUNCTION__, __LINE__);
+
+        settings_thread = state;
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create settings thread!\n",
+                __FUNCTION__, __LINE__);
+
+        close(state->stop_fd);
+        free(state);
+    }
+}
+
+// Tells the settings thread to stop, and leaves it to be joined once the helper mutex is released. Called under it.
+static void stop_settings_thread() {
+    if (settings_thread == NULL) {
+        return;
+    }
+
+    uint64_t value = 1;
+    if (write(settings_thread->stop_fd, &value, sizeof(value)) < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to signal the settings thread to stop: %s\n",
+                __FUNCTION__, __LINE__, strerrorname_np(errno));
+    }
+
+    settings_thread->next = stopped_settings_threads;
+    stopped_settings_threads = settings_thread;
+    settings_thread = NULL;
+}
+
+// Takes the settings threads which were stopped, so that they can be joined once the helper mutex is released.
+static settings_thread_state *take_stopped_settings_threads_locked() {
+    settings_thread_state *stopped = stopped_settings_threads;
+    stopped_settings_threads = NULL;
+
+    return stopped;
+}
+
+static void join_settings_threads(settings_thread_state *stopped) {
+    while (stopped != NULL) {
+        settings_thread_state *next = stopped->next;
+
+        pthread_join(stopped->thread, NULL);
+        close(stopped->stop_fd);
+        free(stopped);
+
+        stopped = next;
+    }
+}
+
+static void open_xt_display() {
+    XtToolkitInitialize();
+    xt_context = XtCreateApplicationContext();
+
+    int argc = 0;
+    char ** argv = { NULL };
+    xt_disp = XtOpenDisplay(xt_context, NULL, "UIOHook", "libuiohook", NULL, 0, &argc, argv);
+    if (xt_disp == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XtOpenDisplay failure!\n",
+                __FUNCTION__, __LINE__);
+    }
+}
+
+static void close_xt_display() {
+    if (xt_disp != NULL) {
+        XtCloseDisplay(xt_disp);
+        xt_disp = NULL;
+    }
+
+    if (xt_context != NULL) {
+        XtDestroyApplicationContext(xt_context);
+        xt_context = NULL;
+    }
+}
+
+static bool is_helper_unused() {
+    for (int i = 0; i < HELPER_CAPABILITY_COUNT; i++) {
+        if (helper_references[i] > 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool activate_helper(helper_capability capability) {
+    // Every capability goes through the helper display, so it's opened along with the first one.
+    if (helper_disp == NULL) {
+        helper_disp = XOpenDisplay(XDisplayName(NULL));
+        if (helper_disp == NULL) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: %s\n",
+                    __FUNCTION__, __LINE__, "XOpenDisplay failure!");
+
+            return false;
+        }
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
+                __FUNCTION__, __LINE__, "XOpenDisplay success.");
+    }
+
+    switch (capability) {
+        case HELPER_SCREENS:
+            // Load the screen resources right away, so we don't wait for the first screen change.
+            update_screen_resources(helper_disp, XDefaultRootWindow(helper_disp), false);
+            start_settings_thread();
+            break;
+
+        case HELPER_XT:
+            open_xt_display();
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+static void deactivate_helper(helper_capability capability) {
+    switch (capability) {
+        case HELPER_SCREENS:
+            stop_settings_thread();
+            free_screen_resources();
+            break;
+
+        case HELPER_XT:
+            close_xt_display();
+            break;
+
+        default:
+            break;
+    }
+
+    if (is_helper_unused() && helper_disp != NULL) {
+        XCloseDisplay(helper_disp);
+        helper_disp = NULL;
+    }
+}
+
+static bool acquire_helper_locked(helper_capability capability) {
+    if (helper_references[capability] == 0 && !activate_helper(capability)) {
+        return false;
+    }
+
+    helper_references[capability]++;
+
+    return true;
+}
+
+bool acquire_helper(helper_capability capability) {
+    pthread_mutex_lock(&helper_mutex);
+    bool available = acquire_helper_locked(capability);
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
+    pthread_mutex_unlock(&helper_mutex);
+
+    join_settings_threads(stopped);
+
+    return available;
+}
+
+void release_helper(helper_capability capability) {
+    pthread_mutex_lock(&helper_mutex);
+
+    if (helper_references[capability] > 0) {
+        helper_references[capability]--;
+
+        if (helper_references[capability] == 0) {
+            deactivate_helper(capability);
+        }
+    }
+
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
+
+    pthread_mutex_unlock(&helper_mutex);
+
+    join_settings_threads(stopped);
+}
+
+bool retain_helper(helper_capability capability) {
+    pthread_mutex_lock(&helper_mutex);
+
+    bool available = helper_references[capability] > 0;
+    if (!available) {
+        // The reference taken here is only released when the library is unloaded.
+        available = acquire_helper_locked(capability);
+    }
+
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
+
+    pthread_mutex_unlock(&helper_mutex);
+
+    join_settings_threads(stopped);
+
+    return available;
+}
+
 screen_data* hook_create_screen_info(unsigned char *count) {
     *count = 0;
     screen_data *screens = NULL;
 
     // Check and make sure we could connect to the x server.
-    if (helper_disp != NULL) {
+    if (retain_helper(HELPER_SCREENS)) {
         pthread_mutex_lock(&xrandr_mutex);
 
         if (xrandr_resources != NULL) {
@@ -149,13 +434,41 @@ screen_data* hook_create_screen_info(unsigned char *count) {
     return screens;
 }
 
+// There's no cached layout to copy from, so the last reported layout is kept to tell whether it has changed.
+static pthread_mutex_t screen_info_mutex = PTHREAD_MUTEX_INITIALIZER;
+static layout_history last_layout;
+
+uint8_t hook_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *layout_version) {
+    unsigned char count = 0;
+    screen_data *screens = hook_create_screen_info(&count);
+    if (screens == NULL) {
+        count = 0;
+    }
+
+    pthread_mutex_lock(&screen_info_mutex);
+
+    uint32_t version = track_layout(&last_layout, screens, count);
+
+    pthread_mutex_unlock(&screen_info_mutex);
+
+    copy_layout(buf, capacity, layout_version, screens, count, version);
+
+    free(screens);
+
+    return count;
+}
+
+// Settings changes aren't tracked on the XRecord back-end, so the callback is never called.
+void hook_set_settings_changed_proc(settings_changed_t settings_changed_proc, void *user_data) {
+}
+
 long int hook_get_auto_repeat_rate() {
     bool successful = false;
     long int value = -1;
     unsigned int delay = 0, rate = 0;
 
     // Check and make sure we could connect to the X server.
-    if (helper_disp != NULL) {
+    if (retain_helper(HELPER_SETTINGS)) {
         // Attempt to acquire the keyboard auto repeat rate using the XKB extension.
         if (!successful) {
             successful = XkbGetAutoRepeatRate(helper_disp, XkbUseCoreKbd, &delay, &rate);
@@ -183,7 +496,7 @@ long int hook_get_auto_repeat_delay() {
     unsigned int delay = 0, rate = 0;
 
     // Check and make sure we could connect to the X server.
-    if (helper_disp != NULL) {
+    if (retain_helper(HELPER_SETTINGS)) {
         // Attempt to acquire the keyboard auto repeat rate using the XKB extension.
         if (!successful) {
             successful = XkbGetAutoRepeatRate(helper_disp, XkbUseCoreKbd, &delay, &rate);
@@ -210,7 +523,7 @@ long int hook_get_pointer_acceleration_multiplier() {
     int accel_numerator, accel_denominator, threshold;
 
     // Check and make sure we could connect to the x server.
-    if (helper_disp != NULL) {
+    if (retain_helper(HELPER_SETTINGS)) {
         XGetPointerControl(helper_disp, &accel_numerator, &accel_denominator, &threshold);
         if (accel_denominator >= 0) {
             logger(LOG_LEVEL_DEBUG, "%s [%u]: XGetPointerControl: %i.\n",
@@ -231,7 +544,7 @@ long int hook_get_pointer_acceleration_threshold() {
     int accel_numerator, accel_denominator, threshold;
 
     // Check and make sure we could connect to the x server.
-    if (helper_disp != NULL) {
+    if (retain_helper(HELPER_SETTINGS)) {
         XGetPointerControl(helper_disp, &accel_numerator, &accel_denominator, &threshold);
         if (threshold >= 0) {
             logger(LOG_LEVEL_DEBUG, "%s [%u]: XGetPointerControl: %i.\n",
@@ -252,7 +565,7 @@ long int hook_get_pointer_sensitivity() {
     int accel_numerator, accel_denominator, threshold;
 
     // Check and make sure we could connect to the x server.
-    if (helper_disp != NULL) {
+    if (retain_helper(HELPER_SETTINGS)) {
         XGetPointerControl(helper_disp, &accel_numerator, &accel_denominator, &threshold);
         if (accel_numerator >= 0) {
             logger(LOG_LEVEL_DEBUG, "%s [%u]: XGetPointerControl: %i.\n",
@@ -273,6 +586,8 @@ long int hook_get_multi_click_time() {
     int click_time;
     bool successful = false;
 
+    retain_helper(HELPER_XT);
+
     // Check and make sure we could connect to the X server.
     if (xt_disp != NULL) {
         // Try and use the Xt extention to get the current multi-click.
@@ -328,59 +643,74 @@ long int hook_get_multi_click_time() {
 // Create a shared object constructor.
 __attribute__ ((constructor))
 void on_library_load() {
-    // Make sure we are initialized for threading.
+    // Xlib has to be initialized for threading before any other call into it, so this can't wait for the first display.
     XInitThreads();
+}
 
-    // Open local display.
-    helper_disp = XOpenDisplay(XDisplayName(NULL));
-    if (helper_disp == NULL) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: %s\n",
-                __FUNCTION__, __LINE__, "XOpenDisplay failure!");
-    } else {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
-                __FUNCTION__, __LINE__, "XOpenDisplay success.");
-    }
-
-    // Create the thread attribute.
-    pthread_attr_t settings_thread_attr;
-    pthread_attr_init(&settings_thread_attr);
+void release_helpers() {
+    pthread_mutex_lock(&helper_mutex);
 
-    pthread_t settings_thread_id;
-    if (pthread_create(&settings_thread_id, &settings_thread_attr, settings_thread_proc, NULL) == 0) {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: Successfully created settings thread.\n",
-                __FUNCTION__, __LINE__);
-    } else {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create settings thread!\n",
-                __FUNCTION__, __LINE__);
+    for (int i = 0; i < HELPER_CAPABILITY_COUNT; i++) {
+        if (helper_references[i] > 0) {
+            helper_references[i] = 0;
+            deactivate_helper((helper_capability) i);
+        }
     }
 
-    // Make sure the thread attribute is removed.
-    pthread_attr_destroy(&settings_thread_attr);
+    settings_thread_state *stopped = take_stopped_settings_threads_locked();
 
-    // Open XT display.
-    XtToolkitInitialize();
-    xt_context = XtCreateApplicationContext();
+    pthread_mutex_unlock(&helper_mutex);
 
-    int argc = 0;
-    char ** argv = { NULL };
-    xt_disp = XtOpenDisplay(xt_context, NULL, "UIOHook", "libuiohook", NULL, 0, &argc, argv);
+    join_settings_threads(stopped);
 }
 
 // Create a shared object destructor.
 __attribute__ ((destructor))
 void on_library_unload() {
     unload_input_helper();
+    release_helpers();
+}
 
-    if (xt_disp != NULL) {
-        XtCloseDisplay(xt_disp);
-    }
+static int preload_helpers() {
+    // The helpers are kept like the getters keep them, until the library is unloaded.
+    static const helper_capability capabilities[] = { HELPER_SCREENS, HELPER_SETTINGS, HELPER_XT, HELPER_POST };
 
-    if (xt_context != NULL) {
-        XtDestroyApplicationContext(xt_context);
+    int status = UIOHOOK_SUCCESS;
+    for (size_t i = 0; i < sizeof(capabilities) / sizeof(capabilities[0]); i++) {
+        if (!retain_helper(capabilities[i])) {
+            status = UIOHOOK_ERROR_X_OPEN_DISPLAY;
+        }
     }
 
-    if (helper_disp != NULL) {
-        XCloseDisplay(helper_disp);
-        helper_disp = NULL;
+    return status;
+}
+
+#ifdef UIOHOOK_STATIC_BACKEND
+// Built into libuiohook, the back-end has no loader which calls this on a thread of its own.
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    return start_preload_thread(preload_helpers, done_proc, user_data);
+}
+#else
+// The loader already calls this on a thread of its own, so the helpers are opened right here.
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    int status = preload_helpers();
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Preloaded the back-end. (%#X)\n",
+            __FUNCTION__, __LINE__, status);
+
+    if (done_proc != NULL) {
+        done_proc(status, user_data);
     }
+
+    return status;
+}
+#endif
+
+// XRecord posts through XTest, so there are neither device sets nor timed posts to keep.
+bool backend_is_busy() {
+    return false;
+}
+
+void backend_release() {
+    release_helpers();
 }
@@ -0,0 +1,30 @@
+#ifndef XRECORD_SYSTEM_PROPERTIES_H
+#define XRECORD_SYSTEM_PROPERTIES_H
+
+#include <stdbool.h>
+
+/* The helper resources which are initialised on first use, each with its own reference count. */
+typedef enum {
+    HELPER_HOOK,      // The helper display which the hook reads the keyboard state through.
+    HELPER_SCREENS,   // The screen resources and the thread which keeps them up to date.
+    HELPER_SETTINGS,  // The keyboard and pointer settings queries.
+    HELPER_XT,        // The X Toolkit display which the multi-click time is read from.
+    HELPER_POST,      // The XTest requests which events are posted through.
+    HELPER_CAPABILITY_COUNT
+} helper_capability;
+
+/* Acquires a reference to a helper capability, initialising it if it isn't in use yet. */
+bool acquire_helper(helper_capability capability);
+
+/* Releases a reference to a helper capability, freeing it once it isn't in use anymore. */
+void release_helper(helper_capability capability);
+
+/* Makes sure a helper capability is initialised, keeping it until the library is unloaded unless
+ * something else already holds it. Used by the getters which can be called at any time. */
+bool retain_helper(helper_capability capability);
+
+/* Drops every helper reference and frees the helpers, joining their threads. They are opened again when
+ * something acquires them later on. */
+void release_helpers();
+
+#endif
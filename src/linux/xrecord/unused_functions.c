@@ -44,5 +44,13 @@ int hook_destroy_virtual_devices() {
     return UIOHOOK_SUCCESS;
 }
 
+int hook_create_virtual_device_set(const char * const application_name, uint8_t *set_id) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_destroy_virtual_device_set(uint8_t set_id) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
 void hook_set_device_procs(device_open_t open_proc, device_close_t close_proc, void *user_data) {
 }
@@ -9,7 +9,9 @@
 static logger_t callback = NULL;
 static void *callback_data = NULL;
 
-void logger(unsigned int level, const char *format, ...) {
+_Atomic unsigned int logger_level = LOG_LEVEL_DEBUG;
+
+void log_message(unsigned int level, const char *format, ...) {
     if (callback != NULL) {
         va_list args;
 
@@ -23,3 +25,11 @@ void hook_set_logger_proc(logger_t logger_proc, void *user_data) {
     callback = logger_proc;
     callback_data = user_data;
 }
+
+unsigned int hook_get_log_level() {
+    return get_logger_level();
+}
+
+void hook_set_log_level(unsigned int level) {
+    atomic_store_explicit(&logger_level, level, memory_order_relaxed);
+}
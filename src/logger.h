@@ -1,6 +1,7 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <uiohook.h>
 
@@ -8,6 +9,35 @@
 #define __FUNCTION__ __func__
 #endif
 
-extern void logger(unsigned int level, const char *format, ...);
+// Debug messages are compiled out entirely when DISABLE_DEBUG_LOG is defined.
+#ifdef DISABLE_DEBUG_LOG
+#define LOG_LEVEL_MIN LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL_MIN LOG_LEVEL_DEBUG
+#endif
+
+// On Linux the loader and every back-end have a level and a callback of their own, which the loader keeps in step, so
+// they're hidden rather than resolved to the copies of the loader through symbol interposition.
+#if defined(__GNUC__) && !defined(_WIN32)
+#define LOGGER_HIDDEN __attribute__((visibility("hidden")))
+#else
+#define LOGGER_HIDDEN
+#endif
+
+extern LOGGER_HIDDEN _Atomic unsigned int logger_level;
+
+extern LOGGER_HIDDEN void log_message(unsigned int level, const char *format, ...);
+
+// Gets the level without ordering, as a message which races with a change of the level may be filtered by either one.
+#define get_logger_level() atomic_load_explicit(&logger_level, memory_order_relaxed)
+
+// The level is checked before the arguments are passed on, so a message which is filtered out costs a single
+// comparison instead of a call into the logger callback, and nothing at all if its level is below LOG_LEVEL_MIN.
+#define logger(level, ...) \
+    do { \
+        if ((level) >= LOG_LEVEL_MIN && (level) >= get_logger_level()) { \
+            log_message((level), __VA_ARGS__); \
+        } \
+    } while (0)
 
 #endif
@@ -275,6 +275,14 @@ int hook_post_event(uiohook_event * const event) {
 }
 
 int hook_post_events(uiohook_event * const events, uint32_t size) {
+    return hook_post_events_counted(events, size, NULL);
+}
+
+int hook_post_events_counted(uiohook_event * const events, uint32_t size, uint32_t *posted) {
+    if (posted != NULL) {
+        *posted = 0;
+    }
+
     // Check for accessibility before we post the events.
     if (!hook_is_ax_api_enabled(hook_get_prompt_user_if_ax_api_disabled())) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Accessibility API is disabled!\n",
@@ -344,6 +352,10 @@ int hook_post_events(uiohook_event * const events, uint32_t size) {
                 status = UIOHOOK_FAILURE;
                 break;
         }
+
+        if (status == UIOHOOK_SUCCESS && posted != NULL) {
+            (*posted)++;
+        }
     }
 
     CFRelease(src);
@@ -387,3 +399,31 @@ int hook_post_text(const uint16_t * const text) {
 
     return UIOHOOK_SUCCESS;
 }
+
+// Timed posting relies on the uinput devices, so it isn't available on macOS.
+int hook_post_events_timed(uiohook_event * const events, uint32_t size, post_progress_t progress_proc,
+        void *user_data) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_cancel_post_events_timed() {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_relative_motion(const relative_motion_data * const motions, uint32_t size) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_pointer_path(const pointer_waypoint * const waypoints, uint32_t count,
+        const pointer_path_options * const options, post_progress_t progress_proc, void *user_data) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size) {
+    // Only the default devices exist here.
+    if (set_id != 0) {
+        return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+    }
+
+    return hook_post_events(events, size);
+}
@@ -1,4 +1,7 @@
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <CoreFoundation/CoreFoundation.h>
 #include <IOKit/hidsystem/event_status_driver.h>
@@ -9,6 +12,7 @@
 
 #include "logger.h"
 #include "input_helper.h"
+#include "screen_info.h"
 
 #define MOUSE_ACCELERATION_MULTIPLIER 65536
 
@@ -39,7 +43,9 @@ screen_data* hook_create_screen_info(unsigned char *count) {
     if (display_ids != NULL) {
         // NOTE Pass UCHAR_MAX to make sure uint32_t doesn't overflow uint8_t.
         // TOOD Test/Check whether CGGetOnlineDisplayList is more suitable...
-        status = CGGetActiveDisplayList(UCHAR_MAX, display_ids, (uint32_t *) count);
+        uint32_t display_count = 0;
+        status = CGGetActiveDisplayList(UCHAR_MAX, display_ids, &display_count);
+        *count = (unsigned char) display_count;
 
         // If there is no error and at least one monitor.
         if (status == kCGErrorSuccess && *count > 0) {
@@ -99,6 +105,34 @@ screen_data* hook_create_screen_info(unsigned char *count) {
     return screens;
 }
 
+// There's no cached layout to copy from, so the last reported layout is kept to tell whether it has changed.
+static pthread_mutex_t screen_info_mutex = PTHREAD_MUTEX_INITIALIZER;
+static layout_history last_layout;
+
+uint8_t hook_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *layout_version) {
+    unsigned char count = 0;
+    screen_data *screens = hook_create_screen_info(&count);
+    if (screens == NULL) {
+        count = 0;
+    }
+
+    pthread_mutex_lock(&screen_info_mutex);
+
+    uint32_t version = track_layout(&last_layout, screens, count);
+
+    pthread_mutex_unlock(&screen_info_mutex);
+
+    copy_layout(buf, capacity, layout_version, screens, count, version);
+
+    free(screens);
+
+    return count;
+}
+
+// Settings changes aren't tracked on macOS, so the callback is never called.
+void hook_set_settings_changed_proc(settings_changed_t settings_changed_proc, void *user_data) {
+}
+
 /*
  * Apple's documentation is not very good.  I was finally able to find this
  * information after many hours of googling.  Value is the slider value in the
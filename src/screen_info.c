@@ -0,0 +1,55 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <uiohook.h>
+
+#include "screen_info.h"
+
+bool screens_equal(const screen_data *a, uint8_t a_count, const screen_data *b, uint8_t b_count) {
+    if (a_count != b_count) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < a_count; i++) {
+        if (a[i].number != b[i].number || a[i].x != b[i].x || a[i].y != b[i].y
+                || a[i].width != b[i].width || a[i].height != b[i].height) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t next_layout_version(uint32_t version) {
+    return version + 1 != 0 ? version + 1 : 1;
+}
+
+uint32_t track_layout(layout_history *history, const screen_data *screens, uint8_t count) {
+    if (!screens_equal(screens, count, history->screens, history->count)) {
+        history->version = next_layout_version(history->version);
+
+        if (count > 0) {
+            memcpy(history->screens, screens, sizeof(screen_data) * count);
+        }
+        history->count = count;
+    }
+
+    return history->version;
+}
+
+uint8_t copy_layout(screen_data *buf, uint8_t capacity, uint32_t *layout_version,
+        const screen_data *screens, uint8_t count, uint32_t version) {
+    bool current = layout_version != NULL && *layout_version == version;
+    if (!current && count <= capacity) {
+        if (count > 0) {
+            memcpy(buf, screens, sizeof(screen_data) * count);
+        }
+
+        if (layout_version != NULL) {
+            *layout_version = version;
+        }
+    }
+
+    return count;
+}
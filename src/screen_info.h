@@ -0,0 +1,38 @@
+#ifndef SCREEN_INFO_H
+#define SCREEN_INFO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <uiohook.h>
+
+// The helpers are compiled into every back-end on Linux, so they're hidden rather than resolved to the copies of another
+// object through symbol interposition.
+#if defined(__GNUC__) && !defined(_WIN32)
+#define SCREEN_INFO_HIDDEN __attribute__((visibility("hidden")))
+#else
+#define SCREEN_INFO_HIDDEN
+#endif
+
+/* The last layout which was reported on platforms which don't keep one, to tell whether the next one has changed. */
+typedef struct _layout_history {
+    screen_data screens[UINT8_MAX];
+    uint8_t count;
+    uint32_t version;
+} layout_history;
+
+/* Whether both layouts have the same screens in the same order. */
+SCREEN_INFO_HIDDEN bool screens_equal(const screen_data *a, uint8_t a_count, const screen_data *b, uint8_t b_count);
+
+/* Returns the version after the given one. Zero is skipped, as it's reserved for callers which don't have any layout. */
+SCREEN_INFO_HIDDEN uint32_t next_layout_version(uint32_t version);
+
+/* Remembers the layout if it differs from the last one, and returns its version. The caller serializes the calls. */
+SCREEN_INFO_HIDDEN uint32_t track_layout(layout_history *history, const screen_data *screens, uint8_t count);
+
+/* Copies the layout into the buffer for hook_get_screen_info, unless the caller already has this version of it or the
+ * buffer is too small, and returns the number of screens. */
+SCREEN_INFO_HIDDEN uint8_t copy_layout(screen_data *buf, uint8_t capacity, uint32_t *layout_version,
+        const screen_data *screens, uint8_t count, uint32_t version);
+
+#endif
@@ -233,6 +233,14 @@ int hook_post_event(uiohook_event * const event) {
 }
 
 int hook_post_events(uiohook_event * const events, uint32_t size) {
+    return hook_post_events_counted(events, size, NULL);
+}
+
+int hook_post_events_counted(uiohook_event * const events, uint32_t size, uint32_t *posted) {
+    if (posted != NULL) {
+        *posted = 0;
+    }
+
     if (events == NULL) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: Not simulating any events as the events are null.\n",
                 __FUNCTION__, __LINE__);
@@ -293,10 +301,18 @@ int hook_post_events(uiohook_event * const events, uint32_t size) {
         }
     }
 
-    if (status == UIOHOOK_SUCCESS && !SendInput(size, inputs, sizeof(INPUT))) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: SendInput() failed! (%#lX)\n",
-                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
-        status = UIOHOOK_FAILURE;
+    if (status == UIOHOOK_SUCCESS) {
+        // SendInput inserts the events in order, so the ones it reports as inserted are the first ones.
+        UINT sent = SendInput(size, inputs, sizeof(INPUT));
+        if (posted != NULL) {
+            *posted = sent;
+        }
+
+        if (sent != size) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: SendInput() failed! (%#lX)\n",
+                    __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+            status = UIOHOOK_FAILURE;
+        }
     }
 
     free(inputs);
@@ -370,3 +386,31 @@ int hook_post_text(const uint16_t * const text) {
 
     return UIOHOOK_SUCCESS;
 }
+
+// Timed posting relies on the uinput devices, so it isn't available on Windows.
+int hook_post_events_timed(uiohook_event * const events, uint32_t size, post_progress_t progress_proc,
+        void *user_data) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_cancel_post_events_timed() {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_relative_motion(const relative_motion_data * const motions, uint32_t size) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_pointer_path(const pointer_waypoint * const waypoints, uint32_t count,
+        const pointer_path_options * const options, post_progress_t progress_proc, void *user_data) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_post_events_on(uint8_t set_id, uiohook_event * const events, uint32_t size) {
+    // Only the default devices exist here.
+    if (set_id != 0) {
+        return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+    }
+
+    return hook_post_events(events, size);
+}
@@ -1,8 +1,13 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <uiohook.h>
 #include <windows.h>
 
 #include "logger.h"
 #include "input_helper.h"
+#include "screen_info.h"
 
 // The handle to the DLL module pulled in DllMain on DLL_PROCESS_ATTACH.
 HINSTANCE hInst;
@@ -104,6 +109,34 @@ screen_data* hook_create_screen_info(unsigned char *count) {
     return screens.data;
 }
 
+// There's no cached layout to copy from, so the last reported layout is kept to tell whether it has changed.
+static SRWLOCK screen_info_lock = SRWLOCK_INIT;
+static layout_history last_layout;
+
+uint8_t hook_get_screen_info(screen_data *buf, uint8_t capacity, uint32_t *layout_version) {
+    unsigned char count = 0;
+    screen_data *screens = hook_create_screen_info(&count);
+    if (screens == NULL) {
+        count = 0;
+    }
+
+    AcquireSRWLockExclusive(&screen_info_lock);
+
+    uint32_t version = track_layout(&last_layout, screens, count);
+
+    ReleaseSRWLockExclusive(&screen_info_lock);
+
+    copy_layout(buf, capacity, layout_version, screens, count, version);
+
+    free(screens);
+
+    return count;
+}
+
+// Settings changes aren't tracked on Windows, so the callback is never called.
+void hook_set_settings_changed_proc(settings_changed_t settings_changed_proc, void *user_data) {
+}
+
 long int hook_get_auto_repeat_rate() {
     long int value = -1;
     long int rate;
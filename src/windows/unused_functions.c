@@ -43,6 +43,14 @@ int hook_get_loaded_linux_backend() {
     return LINUX_LOADED_BACKEND_NONE;
 }
 
+int hook_preload(int mode, preload_done_t done_proc, void *user_data) {
+    if (done_proc != NULL) {
+        done_proc(UIOHOOK_SUCCESS, user_data);
+    }
+
+    return UIOHOOK_SUCCESS;
+}
+
 int hook_init_virtual_devices(const char * const application_name) {
     return UIOHOOK_SUCCESS;
 }
@@ -51,5 +59,20 @@ int hook_destroy_virtual_devices() {
     return UIOHOOK_SUCCESS;
 }
 
+int hook_create_virtual_device_set(const char * const application_name, uint8_t *set_id) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+int hook_destroy_virtual_device_set(uint8_t set_id) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
 void hook_set_device_procs(device_open_t open_proc, device_close_t close_proc, void *user_data) {
 }
+
+int hook_get_stats(hook_stats *stats) {
+    return UIOHOOK_ERROR_UNSUPPORTED_FEATURE;
+}
+
+void hook_reset_stats() {
+}
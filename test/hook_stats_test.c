@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <X11/Xlib.h>
+#include <uiohook.h>
+
+#include "dispatch_event.h"
+#include "input_helper.h"
+#include "minunit.h"
+
+#define NS_PER_MS   1000000ULL
+#define NS_PER_S    1000000000ULL
+
+#define CALLBACK_SLEEP_MS   2
+
+// Delays are bucketed by the number of bits in microseconds, so these land in the buckets from 4096 us and 32768 us
+// even if the dispatch takes a few milliseconds.
+#define SHORT_DELAY_MS      5
+#define SHORT_DELAY_BUCKET  13
+#define LONG_DELAY_MS       40
+#define LONG_DELAY_BUCKET   16
+
+// A motion timestamped this far in the future was timestamped on another clock.
+#define FUTURE_MS           1000
+
+static uint64_t get_monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * NS_PER_S + ts.tv_nsec) / NS_PER_MS;
+}
+
+static void dispatch_proc(uiohook_event * const event, void *user_data) {
+    if (event->type == EVENT_MOUSE_MOVED) {
+        struct timespec delay = { .tv_sec = 0, .tv_nsec = CALLBACK_SLEEP_MS * NS_PER_MS };
+        nanosleep(&delay, NULL);
+    }
+}
+
+// Dispatches a motion which a local X server timestamped the given number of milliseconds ago.
+static void dispatch_motion(int64_t age_ms) {
+    XMotionEvent x_event = {
+        .type = MotionNotify,
+        .time = (Time) (get_monotonic_ms() - age_ms),
+        .x_root = 10,
+        .y_root = 20
+    };
+
+    dispatch_mouse_move(0, &x_event);
+}
+
+static char * test_dispatched_events() {
+    // A button held by an earlier suite would turn the motions into drags.
+    clear_modifier_mask();
+    hook_reset_stats();
+
+    // Without a dispatch callback the event is counted, but dropped.
+    hook_set_dispatch_proc(NULL, NULL);
+    dispatch_hook_enabled(0);
+
+    hook_set_dispatch_proc(&dispatch_proc, NULL);
+    dispatch_hook_enabled(0);
+    dispatch_motion(SHORT_DELAY_MS);
+    dispatch_motion(LONG_DELAY_MS);
+
+    // A motion which was timestamped after it was dispatched is on another clock, so its delay is unknown.
+    dispatch_motion(-FUTURE_MS);
+
+    hook_set_dispatch_proc(NULL, NULL);
+
+    hook_stats stats;
+    mu_assert("error, could not get the stats", hook_get_stats(&stats) == UIOHOOK_SUCCESS);
+
+    mu_assert("error, the hook enabled events were not counted", stats.events[EVENT_HOOK_ENABLED] == 2);
+    mu_assert("error, the mouse moves were not counted", stats.events[EVENT_MOUSE_MOVED] == 3);
+    mu_assert("error, the event without a callback was not dropped", stats.events_dropped == 1);
+
+    mu_assert("error, the callbacks were not counted", stats.callback_count == 4);
+    mu_assert("error, the longest callback time is below the sleep",
+            stats.callback_time_max >= CALLBACK_SLEEP_MS * NS_PER_MS);
+    mu_assert("error, the callback time was not added up",
+            stats.callback_time_total >= 3 * CALLBACK_SLEEP_MS * NS_PER_MS);
+
+    mu_assert("error, a delay of 5 ms is not in the bucket from 4096 us",
+            stats.delay_histogram[SHORT_DELAY_BUCKET] == 1);
+    mu_assert("error, a delay of 40 ms is not in the bucket from 32768 us",
+            stats.delay_histogram[LONG_DELAY_BUCKET] == 1);
+
+    uint64_t delays = 0;
+    for (unsigned int i = 0; i < HOOK_STATS_DELAY_BUCKETS; i++) {
+        delays += stats.delay_histogram[i];
+    }
+
+    mu_assert("error, events without a known delay are in the histogram", delays == 2);
+
+    return NULL;
+}
+
+static char * test_reset() {
+    hook_set_dispatch_proc(&dispatch_proc, NULL);
+    dispatch_hook_enabled(0);
+    dispatch_motion(SHORT_DELAY_MS);
+    hook_set_dispatch_proc(NULL, NULL);
+
+    hook_reset_stats();
+
+    hook_stats stats;
+    hook_stats empty = {};
+    mu_assert("error, could not get the stats", hook_get_stats(&stats) == UIOHOOK_SUCCESS);
+    mu_assert("error, the stats were not reset", memcmp(&stats, &empty, sizeof(hook_stats)) == 0);
+
+    mu_assert("error, the stats could be written to a null pointer", hook_get_stats(NULL) == UIOHOOK_FAILURE);
+
+    return NULL;
+}
+
+static char * run_hook_stats_tests() {
+    mu_run_test(test_dispatched_events);
+    mu_run_test(test_reset);
+
+    return NULL;
+}
+
+char * hook_stats_tests() {
+    // The events are dispatched by the XRecord back-end which the tests link, so its stats are the ones which are read.
+    int previous_mode = hook_get_linux_mode();
+    int status = hook_set_linux_mode(LINUX_MODE_XRECORD);
+    mu_assert("error, could not switch to the XRecord back-end", status == UIOHOOK_SUCCESS);
+
+    char *result = run_hook_stats_tests();
+
+    hook_set_linux_mode(previous_mode);
+
+    return result;
+}
@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <linux/input-event-codes.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include "minunit.h"
+#include "wayland/keymap_helper.h"
+
+// Sends a keymap to the helper the way the compositor does, through a file descriptor.
+static bool send_keymap(const char *layout) {
+    struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if (context == NULL) {
+        return false;
+    }
+
+    struct xkb_rule_names names = { .layout = layout };
+    struct xkb_keymap *keymap = xkb_keymap_new_from_names(context, &names, XKB_KEYMAP_COMPILE_NO_FLAGS);
+    char *text = keymap != NULL ? xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1) : NULL;
+
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(context);
+
+    if (text == NULL) {
+        return false;
+    }
+
+    size_t size = strlen(text) + 1;
+    int fd = memfd_create("uiohook-test-keymap", MFD_CLOEXEC);
+
+    bool written = fd >= 0 && write(fd, text, size) == (ssize_t) size;
+    free(text);
+
+    if (!written) {
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        return false;
+    }
+
+    keymap_helper_set_keymap(WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, fd, (uint32_t) size);
+    return true;
+}
+
+static uint16_t translate(uint16_t evdev_code) {
+    uint16_t buffer[2] = {};
+    size_t count = keymap_helper_key_to_unicode(evdev_code, 0, buffer, sizeof(buffer) / sizeof(buffer[0]));
+
+    return count == 1 ? buffer[0] : 0;
+}
+
+static void type(uint16_t evdev_code) {
+    keymap_helper_update_key(evdev_code, true, 0);
+    keymap_helper_update_key(evdev_code, false, 0);
+}
+
+static char * test_translate_keys() {
+    mu_assert("error, could not send the US keymap", send_keymap("us"));
+    mu_assert("error, the keymap was not compiled", keymap_helper_has_keymap());
+
+    mu_assert("error, the A key was not translated", translate(KEY_A) == 'a');
+    mu_assert("error, the 1 key was not translated", translate(KEY_1) == '1');
+
+    keymap_helper_update_key(KEY_LEFTSHIFT, true, 0);
+    mu_assert("error, the A key was not translated with shift", translate(KEY_A) == 'A');
+    mu_assert("error, the 1 key was not translated with shift", translate(KEY_1) == '!');
+    keymap_helper_update_key(KEY_LEFTSHIFT, false, 0);
+
+    mu_assert("error, the A key was translated with shift after it was released", translate(KEY_A) == 'a');
+
+    type(KEY_CAPSLOCK);
+    mu_assert("error, the A key was not translated with caps lock", translate(KEY_A) == 'A');
+    type(KEY_CAPSLOCK);
+
+    // Control isn't in the table, so the key is translated through the state.
+    keymap_helper_update_key(KEY_LEFTCTRL, true, 0);
+    mu_assert("error, the A key was not translated with control", translate(KEY_A) == 0x01);
+    keymap_helper_update_key(KEY_LEFTCTRL, false, 0);
+
+    return NULL;
+}
+
+static char * test_new_keymap() {
+    mu_assert("error, could not send the Ukrainian keymap", send_keymap("ua"));
+    mu_assert("error, the new keymap was not picked up", translate(KEY_A) == 0x0444);
+
+    mu_assert("error, could not send the US keymap", send_keymap("us"));
+    mu_assert("error, the previous keymap was not picked up again", translate(KEY_A) == 'a');
+
+    return NULL;
+}
+
+char * keymap_helper_tests() {
+    mu_run_test(test_translate_keys);
+    mu_run_test(test_new_keymap);
+
+    keymap_helper_destroy();
+
+    return NULL;
+}
@@ -0,0 +1,146 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "minunit.h"
+#include "wayland/screen_layout.h"
+
+#define SCREEN_WIDTH        1920
+#define SCREEN_HEIGHT       1080
+#define MAX_SCREEN_COUNT    4
+
+#define HOT_PLUG_COUNT      100000
+
+// Publishes a row of screens side by side, as if outputs were plugged in or out.
+static bool publish_screens(uint8_t count) {
+    screen_layout *layout = screen_layout_create(count);
+    if (layout == NULL) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        layout->screens[i] = (screen_data) {
+            .number = i + 1,
+            .x = (int16_t) (i * SCREEN_WIDTH),
+            .y = 0,
+            .width = SCREEN_WIDTH,
+            .height = SCREEN_HEIGHT
+        };
+    }
+
+    layout->width = count > 0 ? count * SCREEN_WIDTH : 0;
+    layout->height = count > 0 ? SCREEN_HEIGHT : 0;
+
+    screen_layout_publish(layout);
+    return true;
+}
+
+static atomic_bool hot_plugging = false;
+
+typedef struct _reader_result {
+    uint64_t reads;
+    uint64_t inconsistent_reads;
+    uint32_t last_version;
+    bool version_went_back;
+} reader_result;
+
+static void *reader_thread_proc(void *arg) {
+    reader_result *result = arg;
+
+    while (atomic_load(&hot_plugging)) {
+        screen_layout *layout = screen_layout_acquire();
+        if (layout == NULL) {
+            continue;
+        }
+
+        // A layout is never changed after it's published, so the bounds always match the screens of the same one.
+        bool consistent = layout->count <= MAX_SCREEN_COUNT
+                && layout->width == layout->count * SCREEN_WIDTH
+                && layout->height == (layout->count > 0 ? SCREEN_HEIGHT : 0);
+
+        for (uint8_t i = 0; i < layout->count && consistent; i++) {
+            consistent = layout->screens[i].number == i + 1 && layout->screens[i].x == i * SCREEN_WIDTH;
+        }
+
+        if (!consistent) {
+            result->inconsistent_reads++;
+        }
+
+        if (layout->version < result->last_version) {
+            result->version_went_back = true;
+        }
+
+        result->last_version = layout->version;
+        result->reads++;
+
+        screen_layout_release(layout);
+    }
+
+    return NULL;
+}
+
+static char * test_versions() {
+    mu_assert("error, could not publish a layout", publish_screens(1));
+
+    screen_layout *first = screen_layout_acquire();
+    mu_assert("error, the published layout was not acquired", first != NULL && first->count == 1);
+
+    mu_assert("error, could not publish the same layout", publish_screens(1));
+
+    screen_layout *same = screen_layout_acquire();
+    mu_assert("error, the version changed for the same layout", same->version == first->version);
+    screen_layout_release(same);
+
+    mu_assert("error, could not publish another layout", publish_screens(2));
+
+    screen_layout *second = screen_layout_acquire();
+    mu_assert("error, the version didn't change for another layout", second->version != first->version);
+    mu_assert("error, the bounds don't match the new layout", second->width == 2 * SCREEN_WIDTH);
+    screen_layout_release(second);
+
+    // The first layout is still held, so it must be left as it was.
+    mu_assert("error, a held layout was changed", first->count == 1 && first->width == SCREEN_WIDTH);
+    screen_layout_release(first);
+
+    return NULL;
+}
+
+static char * test_hot_plug() {
+    printf("Hot-plugging screens %u times while the layout is read.\n", HOT_PLUG_COUNT);
+
+    reader_result result = {};
+
+    atomic_store(&hot_plugging, true);
+
+    pthread_t reader_thread;
+    mu_assert("error, could not start the reader thread",
+            pthread_create(&reader_thread, NULL, reader_thread_proc, &result) == 0);
+
+    bool published = true;
+    for (uint32_t i = 0; i < HOT_PLUG_COUNT && published; i++) {
+        published = publish_screens((uint8_t) (i % (MAX_SCREEN_COUNT + 1)));
+    }
+
+    atomic_store(&hot_plugging, false);
+    pthread_join(reader_thread, NULL);
+
+    printf("The layout was read %llu times.\n", (unsigned long long) result.reads);
+
+    mu_assert("error, could not publish a layout", published);
+    mu_assert("error, a layout was read with bounds which don't match its screens", result.inconsistent_reads == 0);
+    mu_assert("error, an older layout was read after a newer one", !result.version_went_back);
+
+    return NULL;
+}
+
+char * screen_layout_tests() {
+    mu_run_test(test_versions);
+    mu_run_test(test_hot_plug);
+
+    // Leaves an empty layout behind, like the monitor helper does when it disconnects.
+    publish_screens(0);
+
+    return NULL;
+}
@@ -1,6 +1,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <uiohook.h>
 
 #include "minunit.h"
@@ -9,6 +10,42 @@ static bool pointer_properties_supported() {
     return hook_get_optional_feature_support() & UIOHOOK_FEATURE_POINTER_PROPERTIES;
 }
 
+static char * test_screen_info() {
+    unsigned char created_count = 0;
+    screen_data *created = hook_create_screen_info(&created_count);
+
+    uint32_t version = 0;
+    uint8_t count = hook_get_screen_info(NULL, 0, &version);
+
+    fprintf(stdout, "Screen count: %u\n", count);
+    mu_assert("error, the screen count differs from the created screen info", count == created_count);
+    mu_assert("error, the layout version was updated without copying the screen info", count == 0 || version == 0);
+
+    screen_data buf[UINT8_MAX];
+    count = hook_get_screen_info(buf, UINT8_MAX, &version);
+    mu_assert("error, the screen count differs from the created screen info", count == created_count);
+
+    for (uint8_t i = 0; i < count; i++) {
+        mu_assert("error, the copied screen info differs from the created screen info",
+            buf[i].number == created[i].number && buf[i].x == created[i].x && buf[i].y == created[i].y
+                && buf[i].width == created[i].width && buf[i].height == created[i].height);
+    }
+
+    free(created);
+
+    // The layout hasn't changed, so the buffer must be left alone.
+    screen_data unchanged[UINT8_MAX] = { 0 };
+    uint32_t current_version = version;
+    count = hook_get_screen_info(unchanged, UINT8_MAX, &version);
+
+    mu_assert("error, the layout version changed without a layout change", version == current_version);
+    for (uint8_t i = 0; i < count; i++) {
+        mu_assert("error, the screen info was copied for the current layout version", unchanged[i].number == 0);
+    }
+
+    return NULL;
+}
+
 static char * test_auto_repeat_rate() {
     long int i = hook_get_auto_repeat_rate();
     
@@ -83,6 +120,8 @@ char * system_properties_tests() {
         fprintf(stdout, "The pointer properties are not supported, so they are only checked for reporting -1.\n");
     }
 
+    mu_run_test(test_screen_info);
+
     mu_run_test(test_auto_repeat_rate);
     mu_run_test(test_auto_repeat_delay);
 
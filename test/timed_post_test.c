@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <uiohook.h>
+
+#include "minunit.h"
+
+#define MOTION_COUNT        20
+#define MOTION_INTERVAL_MS  10
+#define MAX_JITTER_MS       5
+
+#define CANCELED_COUNT      100
+
+static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t state_cond = PTHREAD_COND_INITIALIZER;
+
+static bool hook_enabled = false;
+static bool hook_disabled = false;
+
+static uint64_t arrivals[MOTION_COUNT];
+static uint32_t arrival_count = 0;
+
+static bool post_finished = false;
+static uint32_t post_posted = 0;
+static int post_status = UIOHOOK_SUCCESS;
+
+static uint64_t get_monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void dispatch_proc(uiohook_event * const event, void *user_data) {
+    uint64_t now = get_monotonic_ns();
+
+    pthread_mutex_lock(&state_mutex);
+
+    switch (event->type) {
+        case EVENT_HOOK_ENABLED:
+            hook_enabled = true;
+            pthread_cond_broadcast(&state_cond);
+            break;
+
+        case EVENT_HOOK_DISABLED:
+            hook_disabled = true;
+            pthread_cond_broadcast(&state_cond);
+            break;
+
+        case EVENT_MOUSE_MOVED:
+            if ((event->mask & MASK_EMULATED) && arrival_count < MOTION_COUNT) {
+                arrivals[arrival_count++] = now;
+            }
+            break;
+    }
+
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static void progress_proc(uint32_t posted, uint32_t total, int status, void *user_data) {
+    pthread_mutex_lock(&state_mutex);
+
+    post_posted = posted;
+    post_status = status;
+
+    if (posted == total || status != UIOHOOK_SUCCESS) {
+        post_finished = true;
+        pthread_cond_broadcast(&state_cond);
+    }
+
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static void *hook_thread_proc(void *arg) {
+    hook_run_mouse();
+
+    // The hook may fail before it's enabled, so don't leave the test waiting for it.
+    pthread_mutex_lock(&state_mutex);
+    hook_disabled = true;
+    pthread_cond_broadcast(&state_cond);
+    pthread_mutex_unlock(&state_mutex);
+
+    return NULL;
+}
+
+static void reset_post() {
+    pthread_mutex_lock(&state_mutex);
+
+    arrival_count = 0;
+    post_finished = false;
+    post_posted = 0;
+    post_status = UIOHOOK_SUCCESS;
+
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static void wait_for_post() {
+    pthread_mutex_lock(&state_mutex);
+
+    while (!post_finished) {
+        pthread_cond_wait(&state_cond, &state_mutex);
+    }
+
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static void fill_motion_events(uiohook_event *events, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        events[i] = (uiohook_event) {
+            .time = 1000 + i * MOTION_INTERVAL_MS,
+            .type = EVENT_MOUSE_MOVED_RELATIVE,
+            .data.mouse.x = i % 2 == 0 ? 1 : -1,
+            .data.mouse.y = 0
+        };
+    }
+}
+
+static char * test_timed_post_jitter() {
+    reset_post();
+
+    uiohook_event events[MOTION_COUNT];
+    fill_motion_events(events, MOTION_COUNT);
+
+    int status = hook_post_events_timed(events, MOTION_COUNT, progress_proc, NULL);
+    mu_assert("error, could not start posting the timed events", status == UIOHOOK_SUCCESS);
+
+    wait_for_post();
+
+    // Let the hook catch up with the last events.
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = 100000000 };
+    nanosleep(&delay, NULL);
+
+    pthread_mutex_lock(&state_mutex);
+
+    uint32_t count = arrival_count;
+    int64_t max_jitter = 0;
+
+    for (uint32_t i = 1; i < count; i++) {
+        int64_t expected = (int64_t) i * MOTION_INTERVAL_MS * 1000000;
+        int64_t actual = (int64_t) (arrivals[i] - arrivals[0]);
+        int64_t jitter = actual > expected ? actual - expected : expected - actual;
+
+        if (jitter > max_jitter) {
+            max_jitter = jitter;
+        }
+    }
+
+    int final_status = post_status;
+
+    pthread_mutex_unlock(&state_mutex);
+
+    fprintf(stdout, "Timed post jitter: %.3f ms over %u events\n", max_jitter / 1e6, count);
+
+    mu_assert("error, the timed events were not all posted", final_status == UIOHOOK_SUCCESS);
+    mu_assert("error, the hook did not receive all of the timed events", count == MOTION_COUNT);
+    mu_assert("error, the timed events were posted with too much jitter", max_jitter < MAX_JITTER_MS * 1000000);
+
+    return NULL;
+}
+
+static char * test_timed_post_cancel() {
+    reset_post();
+
+    uiohook_event events[CANCELED_COUNT];
+    fill_motion_events(events, CANCELED_COUNT);
+
+    int status = hook_post_events_timed(events, CANCELED_COUNT, progress_proc, NULL);
+    mu_assert("error, could not start posting the timed events", status == UIOHOOK_SUCCESS);
+
+    status = hook_post_events_timed(events, CANCELED_COUNT, progress_proc, NULL);
+    mu_assert("error, a second batch was accepted while the first one was being posted", status == UIOHOOK_FAILURE);
+
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = 5 * MOTION_INTERVAL_MS * 1000000 };
+    nanosleep(&delay, NULL);
+
+    status = hook_cancel_post_events_timed();
+    mu_assert("error, could not cancel posting the timed events", status == UIOHOOK_SUCCESS);
+
+    wait_for_post();
+
+    pthread_mutex_lock(&state_mutex);
+    uint32_t posted = post_posted;
+    int final_status = post_status;
+    pthread_mutex_unlock(&state_mutex);
+
+    mu_assert("error, the canceled post was not reported as canceled", final_status == UIOHOOK_ERROR_CANCELED);
+    mu_assert("error, the canceled post posted every event", posted > 0 && posted < CANCELED_COUNT);
+
+    return NULL;
+}
+
+static char * test_pointer_path() {
+    reset_post();
+
+    // The thread of the previous post reports that it's finished just before it stops.
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = 50000000 };
+    nanosleep(&delay, NULL);
+
+    // A relative square which leaves the pointer where it was.
+    pointer_waypoint waypoints[] = {
+        { .x = 0, .y = 0 },
+        { .x = 10, .y = 0 },
+        { .x = 10, .y = 10 },
+        { .x = 0, .y = 10 },
+        { .x = 0, .y = 0 }
+    };
+
+    pointer_path_options options = {
+        .curve = POINTER_PATH_CURVE_LINEAR,
+        .easing = POINTER_PATH_EASING_IN_OUT,
+        .relative = true,
+        .duration = 100,
+        .rate = 100
+    };
+
+    int status = hook_post_pointer_path(waypoints, sizeof(waypoints) / sizeof(waypoints[0]), &options,
+        progress_proc, NULL);
+    mu_assert("error, could not start posting the pointer path", status == UIOHOOK_SUCCESS);
+
+    wait_for_post();
+
+    pthread_mutex_lock(&state_mutex);
+    uint32_t posted = post_posted;
+    int final_status = post_status;
+    pthread_mutex_unlock(&state_mutex);
+
+    mu_assert("error, the pointer path was not posted", final_status == UIOHOOK_SUCCESS);
+    mu_assert("error, the pointer path has more events than its steps", posted > 0 && posted <= 11);
+
+    options.rate = POINTER_PATH_RATE_MAX + 1;
+    status = hook_post_pointer_path(waypoints, sizeof(waypoints) / sizeof(waypoints[0]), &options,
+        progress_proc, NULL);
+    mu_assert("error, a pointer path with too high a rate was accepted", status == UIOHOOK_FAILURE);
+
+    return NULL;
+}
+
+static char * run_timed_post_tests() {
+    mu_run_test(test_timed_post_jitter);
+    mu_run_test(test_timed_post_cancel);
+    mu_run_test(test_pointer_path);
+
+    return NULL;
+}
+
+char * timed_post_tests() {
+    // The XRecord back-end doesn't support timed posting, so one of the others is used instead.
+    int previous_mode = hook_get_linux_mode();
+    if (previous_mode == LINUX_MODE_AUTO_XRECORD || previous_mode == LINUX_MODE_XRECORD) {
+        int status = hook_set_linux_mode(LINUX_MODE_AUTO_LOW_LEVEL);
+        mu_assert("error, could not switch to a back-end which supports timed posting", status == UIOHOOK_SUCCESS);
+    }
+
+    int status = hook_cancel_post_events_timed();
+    mu_assert("error, timed posting is not supported", status != UIOHOOK_ERROR_UNSUPPORTED_FEATURE);
+
+    status = hook_init_virtual_devices("uiohook tests");
+    mu_assert("error, could not initialize the virtual devices", status == UIOHOOK_SUCCESS);
+
+    hook_set_dispatch_proc(dispatch_proc, NULL);
+
+    pthread_t hook_thread;
+    pthread_create(&hook_thread, NULL, hook_thread_proc, NULL);
+
+    pthread_mutex_lock(&state_mutex);
+    while (!hook_enabled && !hook_disabled) {
+        pthread_cond_wait(&state_cond, &state_mutex);
+    }
+
+    bool enabled = hook_enabled;
+    pthread_mutex_unlock(&state_mutex);
+
+    char *result = enabled ? run_timed_post_tests() : "error, could not run the hook";
+
+    if (enabled) {
+        hook_stop();
+    }
+
+    pthread_join(hook_thread, NULL);
+
+    hook_set_dispatch_proc(NULL, NULL);
+    hook_destroy_virtual_devices();
+
+    hook_set_linux_mode(previous_mode);
+
+    return result;
+}
@@ -7,11 +7,22 @@
 #include "input_helper.h"
 #include "minunit.h"
 
+#ifdef __linux__
+#include "logger.h"
+#endif
+
 extern char * system_properties_tests();
 extern char * input_helper_tests();
 
 #ifdef __linux__
 extern char * evdev_input_helper_tests();
+extern char * hook_stats_tests();
+extern char * keymap_helper_tests();
+extern char * screen_layout_tests();
+extern char * xkb_state_tests();
+extern char * timed_post_tests();
+extern char * virtual_device_set_tests();
+extern char * wayland_post_text_tests();
 #endif
 
 int tests_run = 0;
@@ -26,14 +37,23 @@ typedef struct _test_suite {
     const char *name;
     char * (*run)();
     bool requires_display;
+    // Whether the suite is only run when it's named, as it has to run on its own in an environment set up for it.
+    bool runs_alone;
 } test_suite;
 
 static const test_suite test_suites[] = {
-    { "system_properties", system_properties_tests, REQUIRES_DISPLAY },
-    { "input_helper", input_helper_tests, REQUIRES_DISPLAY },
+    { "system_properties", system_properties_tests, REQUIRES_DISPLAY, false },
+    { "input_helper", input_helper_tests, REQUIRES_DISPLAY, false },
 
     #ifdef __linux__
-    { "evdev_input_helper", evdev_input_helper_tests, false },
+    { "evdev_input_helper", evdev_input_helper_tests, false, false },
+    { "hook_stats", hook_stats_tests, false, false },
+    { "keymap_helper", keymap_helper_tests, false, false },
+    { "screen_layout", screen_layout_tests, false, false },
+    { "xkb_state", xkb_state_tests, true, false },
+    { "timed_post", timed_post_tests, true, false },
+    { "virtual_device_set", virtual_device_set_tests, true, false },
+    { "wayland_post_text", wayland_post_text_tests, true, true },
     #endif
 };
 
@@ -63,6 +83,19 @@ static void logger_proc(unsigned int level, void *user_data, const char *format,
     vfprintf(stdout, format, args);
 }
 
+#ifdef __linux__
+// The helpers which are compiled into the tests can't reach the logger of a back-end, as it's hidden in the library.
+_Atomic unsigned int logger_level = LOG_LEVEL_DEBUG;
+
+void log_message(unsigned int level, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    logger_proc(level, NULL, format, args);
+    va_end(args);
+}
+#endif
+
 static char * init_tests() {
     #ifndef _WIN32
     if (input_helper_needed) {
@@ -100,14 +133,16 @@ static void print_suites() {
     printf("Available test suites:\n");
 
     for (size_t i = 0; i < TEST_SUITE_COUNT; i++) {
-        printf("  %-20s %s\n", test_suites[i].name,
-                test_suites[i].requires_display ? "(requires a display)" : "(headless)");
+        printf("  %-20s %s%s\n", test_suites[i].name,
+                test_suites[i].requires_display ? "(requires a display)" : "(headless)",
+                test_suites[i].runs_alone ? " (only runs when named)" : "");
     }
 }
 
 static void print_usage(const char *program) {
     printf("Usage: %s [--headless | --list | --help | <suite>...]\n\n", program);
-    printf("  <suite>...   Run only the named suites. All suites run when none are named.\n");
+    printf("  <suite>...   Run only the named suites. When none are named, all suites run except the ones which\n");
+    printf("               only run when they're named.\n");
     printf("  --headless   Run only the suites which don't need a display.\n");
     printf("  --list       List the available suites and exit.\n");
     printf("  --help       Print this message and exit.\n\n");
@@ -118,7 +153,7 @@ static void print_usage(const char *program) {
 static bool select_tests(int argc, char *argv[]) {
     if (argc <= 1) {
         for (size_t i = 0; i < TEST_SUITE_COUNT; i++) {
-            selected[i] = true;
+            selected[i] = !test_suites[i].runs_alone;
         }
 
         return true;
@@ -131,7 +166,7 @@ static bool select_tests(int argc, char *argv[]) {
         }
 
         for (size_t i = 0; i < TEST_SUITE_COUNT; i++) {
-            selected[i] = !test_suites[i].requires_display;
+            selected[i] = !test_suites[i].requires_display && !test_suites[i].runs_alone;
         }
 
         return true;
@@ -0,0 +1,211 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <uiohook.h>
+
+#include "minunit.h"
+
+#define POST_COUNT      20
+#define RECEIVE_WAIT_S  2
+
+static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t state_cond = PTHREAD_COND_INITIALIZER;
+
+static bool hook_enabled = false;
+static bool hook_disabled = false;
+
+// The number of emulated motion events which were received from each set.
+static uint32_t received[UINT8_MAX + 1];
+
+typedef struct _post_thread_args {
+    uint8_t set_id;
+    int status;
+} post_thread_args;
+
+static void dispatch_proc(uiohook_event * const event, void *user_data) {
+    pthread_mutex_lock(&state_mutex);
+
+    switch (event->type) {
+        case EVENT_HOOK_ENABLED:
+            hook_enabled = true;
+            pthread_cond_broadcast(&state_cond);
+            break;
+
+        case EVENT_HOOK_DISABLED:
+            hook_disabled = true;
+            pthread_cond_broadcast(&state_cond);
+            break;
+
+        case EVENT_MOUSE_MOVED:
+            if (event->mask & MASK_EMULATED) {
+                received[(event->mask & MASK_VIRTUAL_DEVICE_SET) >> MASK_VIRTUAL_DEVICE_SET_SHIFT]++;
+                pthread_cond_broadcast(&state_cond);
+            }
+            break;
+    }
+
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static void *hook_thread_proc(void *arg) {
+    hook_run_mouse();
+
+    // The hook may fail before it's enabled, so don't leave the test waiting for it.
+    pthread_mutex_lock(&state_mutex);
+    hook_disabled = true;
+    pthread_cond_broadcast(&state_cond);
+    pthread_mutex_unlock(&state_mutex);
+
+    return NULL;
+}
+
+// Moves the pointer back and forth by a pixel, so that the test leaves it where it was.
+static void *post_thread_proc(void *arg) {
+    post_thread_args *args = (post_thread_args *) arg;
+
+    uiohook_event events[POST_COUNT];
+    for (uint32_t i = 0; i < POST_COUNT; i++) {
+        events[i] = (uiohook_event) {
+            .type = EVENT_MOUSE_MOVED_RELATIVE,
+            .data.mouse.x = i % 2 == 0 ? 1 : -1,
+            .data.mouse.y = 0
+        };
+    }
+
+    // Each event is posted separately, so that the threads interleave.
+    args->status = UIOHOOK_SUCCESS;
+    for (uint32_t i = 0; i < POST_COUNT && args->status == UIOHOOK_SUCCESS; i++) {
+        args->status = hook_post_events_on(args->set_id, events + i, 1);
+    }
+
+    return NULL;
+}
+
+static bool wait_for_events(uint8_t first_set_id, uint8_t second_set_id) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += RECEIVE_WAIT_S;
+
+    pthread_mutex_lock(&state_mutex);
+
+    int result = 0;
+    while ((received[first_set_id] < POST_COUNT || received[second_set_id] < POST_COUNT) && result == 0) {
+        result = pthread_cond_timedwait(&state_cond, &state_mutex, &deadline);
+    }
+
+    pthread_mutex_unlock(&state_mutex);
+
+    return result == 0;
+}
+
+static char * test_post_on_sets() {
+    uint8_t first_set_id = 0, second_set_id = 0;
+
+    int status = hook_create_virtual_device_set("uiohook tests first", &first_set_id);
+    mu_assert("error, could not create the first virtual device set", status == UIOHOOK_SUCCESS);
+
+    status = hook_create_virtual_device_set("uiohook tests second", &second_set_id);
+    mu_assert("error, could not create the second virtual device set", status == UIOHOOK_SUCCESS);
+
+    mu_assert("error, a virtual device set has the ID of the default devices", first_set_id != 0 && second_set_id != 0);
+    mu_assert("error, the virtual device sets have the same ID", first_set_id != second_set_id);
+
+    post_thread_args first_args = { .set_id = first_set_id };
+    post_thread_args second_args = { .set_id = second_set_id };
+
+    pthread_t first_thread, second_thread;
+    pthread_create(&first_thread, NULL, post_thread_proc, &first_args);
+    pthread_create(&second_thread, NULL, post_thread_proc, &second_args);
+
+    pthread_join(first_thread, NULL);
+    pthread_join(second_thread, NULL);
+
+    bool all_received = wait_for_events(first_set_id, second_set_id);
+
+    pthread_mutex_lock(&state_mutex);
+    uint32_t first_received = received[first_set_id];
+    uint32_t second_received = received[second_set_id];
+    pthread_mutex_unlock(&state_mutex);
+
+    hook_destroy_virtual_device_set(first_set_id);
+    hook_destroy_virtual_device_set(second_set_id);
+
+    mu_assert("error, could not post to the first virtual device set", first_args.status == UIOHOOK_SUCCESS);
+    mu_assert("error, could not post to the second virtual device set", second_args.status == UIOHOOK_SUCCESS);
+
+    fprintf(stdout, "Received %u and %u of %u events from the virtual device sets\n",
+            first_received, second_received, POST_COUNT);
+
+    mu_assert("error, the events were not attributed to their virtual device sets", all_received);
+    mu_assert("error, more events were attributed to a virtual device set than it posted",
+            first_received == POST_COUNT && second_received == POST_COUNT);
+
+    return NULL;
+}
+
+static char * test_destroyed_set() {
+    uint8_t set_id = 0;
+
+    int status = hook_create_virtual_device_set("uiohook tests", &set_id);
+    mu_assert("error, could not create a virtual device set", status == UIOHOOK_SUCCESS);
+
+    status = hook_destroy_virtual_device_set(set_id);
+    mu_assert("error, could not destroy the virtual device set", status == UIOHOOK_SUCCESS);
+
+    uiohook_event event = { .type = EVENT_MOUSE_MOVED_RELATIVE };
+    status = hook_post_events_on(set_id, &event, 1);
+    mu_assert("error, could post to a destroyed virtual device set", status != UIOHOOK_SUCCESS);
+
+    status = hook_destroy_virtual_device_set(set_id);
+    mu_assert("error, could destroy a virtual device set twice", status != UIOHOOK_SUCCESS);
+
+    return NULL;
+}
+
+static char * run_virtual_device_set_tests() {
+    mu_run_test(test_post_on_sets);
+    mu_run_test(test_destroyed_set);
+
+    return NULL;
+}
+
+char * virtual_device_set_tests() {
+    uint8_t set_id;
+    int status = hook_create_virtual_device_set(NULL, &set_id);
+    if (status == UIOHOOK_ERROR_UNSUPPORTED_FEATURE) {
+        fprintf(stdout, "Virtual device sets are not supported, so they are not tested.\n");
+        return NULL;
+    }
+
+    mu_assert("error, could not create a virtual device set", status == UIOHOOK_SUCCESS);
+    hook_destroy_virtual_device_set(set_id);
+
+    hook_set_dispatch_proc(dispatch_proc, NULL);
+
+    pthread_t hook_thread;
+    pthread_create(&hook_thread, NULL, hook_thread_proc, NULL);
+
+    pthread_mutex_lock(&state_mutex);
+    while (!hook_enabled && !hook_disabled) {
+        pthread_cond_wait(&state_cond, &state_mutex);
+    }
+
+    bool enabled = hook_enabled;
+    pthread_mutex_unlock(&state_mutex);
+
+    char *result = enabled ? run_virtual_device_set_tests() : "error, could not run the hook";
+
+    if (enabled) {
+        hook_stop();
+    }
+
+    pthread_join(hook_thread, NULL);
+
+    hook_set_dispatch_proc(NULL, NULL);
+
+    return result;
+}
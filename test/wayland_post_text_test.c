@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <uiohook.h>
+
+#include "minunit.h"
+
+// More distinct characters than a single keymap has keys, so that the text is typed through several of them.
+#define DISTINCT_CHARACTER_COUNT 300
+
+static char * test_post_text() {
+    // Latin and Cyrillic letters, an emoji as a surrogate pair, and a new line.
+    const uint16_t text[] = { 'H', 'i', ',', ' ', 0x043C, 0x0438, 0x0440, '!', ' ', 0xD83D, 0xDE00, '\n', 0 };
+
+    int status = hook_post_text(text);
+    mu_assert("error, could not post text", status == UIOHOOK_SUCCESS);
+
+    return NULL;
+}
+
+static char * test_post_text_with_many_characters() {
+    uint16_t text[DISTINCT_CHARACTER_COUNT + 1];
+
+    for (uint16_t i = 0; i < DISTINCT_CHARACTER_COUNT; i++) {
+        text[i] = 0x4E00 + i;
+    }
+
+    text[DISTINCT_CHARACTER_COUNT] = 0;
+
+    int status = hook_post_text(text);
+    mu_assert("error, could not post text with more characters than a keymap has keys", status == UIOHOOK_SUCCESS);
+
+    return NULL;
+}
+
+static char * test_post_empty_text() {
+    const uint16_t text[] = { 0 };
+
+    int status = hook_post_text(text);
+    mu_assert("error, could not post empty text", status == UIOHOOK_SUCCESS);
+
+    status = hook_post_text(NULL);
+    mu_assert("error, null text was posted", status == UIOHOOK_ERROR_NULL);
+
+    return NULL;
+}
+
+char * wayland_post_text_tests() {
+    // Text is typed into whatever has focus, so it's only posted into a compositor which is started for the tests,
+    // in which case this has to be the only suite that runs.
+    if (hook_set_linux_mode(LINUX_MODE_WAYLAND) != UIOHOOK_SUCCESS) {
+        fprintf(stdout, "The Wayland back-end cannot be loaded, so posting text on it is not tested.\n");
+        return NULL;
+    }
+
+    if (!(hook_get_optional_feature_support() & UIOHOOK_FEATURE_POST_TEXT)) {
+        fprintf(stdout, "The compositor doesn't support virtual keyboards, so posting text is not tested.\n");
+        return NULL;
+    }
+
+    mu_run_test(test_post_text);
+    mu_run_test(test_post_text_with_many_characters);
+    mu_run_test(test_post_empty_text);
+
+    return NULL;
+}
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+
+#include "minunit.h"
+#include "x11/xkb_state.h"
+
+#define NAME_MASK (XkbKeycodesNameMask | XkbTypesNameMask | XkbCompatNameMask | XkbSymbolsNameMask | XkbGeometryNameMask)
+
+static Display *disp = NULL;
+static XkbComponentNamesRec original_names;
+
+static char *get_name(Atom atom) {
+    return atom != None ? XGetAtomName(disp, atom) : NULL;
+}
+
+static void free_names(XkbComponentNamesRec *names) {
+    XFree(names->keycodes);
+    XFree(names->types);
+    XFree(names->compat);
+    XFree(names->symbols);
+    XFree(names->geometry);
+}
+
+static bool load_keymap(XkbComponentNamesRec *names) {
+    XkbDescPtr xkb = XkbGetKeyboardByName(disp, XkbUseCoreKbd, names,
+            XkbGBN_AllComponentsMask, XkbGBN_AllComponentsMask, True);
+
+    if (xkb == NULL) {
+        return false;
+    }
+
+    XkbFreeKeyboard(xkb, XkbAllComponentsMask, True);
+    return true;
+}
+
+static void sync_state() {
+    XSync(disp, False);
+
+    XEvent event;
+    while (XPending(disp) > 0) {
+        XNextEvent(disp, &event);
+        xkb_state_handle_event(&event);
+    }
+}
+
+static char * test_load_two_groups() {
+    XkbDescPtr xkb = XkbAllocKeyboard();
+    mu_assert("error, could not allocate a keyboard description", xkb != NULL);
+
+    bool names_loaded = XkbGetNames(disp, NAME_MASK, xkb) == Success;
+    if (names_loaded) {
+        // Remember the current keymap, so that it can be put back once the tests are done.
+        original_names = (XkbComponentNamesRec) {
+            .keycodes = get_name(xkb->names->keycodes),
+            .types = get_name(xkb->names->types),
+            .compat = get_name(xkb->names->compat),
+            .symbols = get_name(xkb->names->symbols),
+            .geometry = get_name(xkb->names->geometry)
+        };
+    }
+
+    XkbFreeKeyboard(xkb, XkbAllComponentsMask, True);
+    mu_assert("error, could not get the names of the current keymap", names_loaded);
+
+    XkbComponentNamesRec names = {
+        .keycodes = "evdev+aliases(qwerty)",
+        .types = "complete",
+        .compat = "complete",
+        .symbols = "pc+us+de:2+inet(evdev)",
+        .geometry = "pc(pc105)"
+    };
+
+    printf("Loading a keymap with two layout groups.\n");
+    mu_assert("error, could not load a keymap with two layout groups", load_keymap(&names));
+
+    return NULL;
+}
+
+static char * test_initial_state() {
+    XkbLockGroup(disp, XkbUseCoreKbd, 0);
+    XSync(disp, False);
+
+    mu_assert("error, could not start tracking the keyboard state", xkb_state_init(disp));
+    mu_assert("error, the initial layout group is not the first one", xkb_state_get_group() == 0);
+
+    return NULL;
+}
+
+static char * test_group_switch() {
+    printf("Switching to the second layout group.\n");
+
+    XkbLockGroup(disp, XkbUseCoreKbd, 1);
+    sync_state();
+
+    mu_assert("error, the tracked layout group did not follow the switch", xkb_state_get_group() == 1);
+    mu_assert("error, the core state does not contain the layout group",
+            XkbGroupForCoreState(xkb_state_get_core_state()) == 1);
+
+    printf("Switching back to the first layout group.\n");
+
+    XkbLockGroup(disp, XkbUseCoreKbd, 0);
+    sync_state();
+
+    mu_assert("error, the tracked layout group did not follow the switch back", xkb_state_get_group() == 0);
+    mu_assert("error, the core state still contains the second layout group",
+            XkbGroupForCoreState(xkb_state_get_core_state()) == 0);
+
+    return NULL;
+}
+
+static char * test_modifier_lock() {
+    printf("Locking and unlocking caps lock.\n");
+
+    XkbLockModifiers(disp, XkbUseCoreKbd, LockMask, LockMask);
+    sync_state();
+
+    mu_assert("error, the tracked modifiers did not follow caps lock", xkb_state_get_core_state() & LockMask);
+
+    XkbLockModifiers(disp, XkbUseCoreKbd, LockMask, 0);
+    sync_state();
+
+    mu_assert("error, the tracked modifiers did not follow caps lock being released",
+            !(xkb_state_get_core_state() & LockMask));
+
+    return NULL;
+}
+
+static char * run_xkb_state_tests() {
+    mu_run_test(test_load_two_groups);
+    mu_run_test(test_initial_state);
+    mu_run_test(test_group_switch);
+    mu_run_test(test_modifier_lock);
+
+    return NULL;
+}
+
+char * xkb_state_tests() {
+    disp = XOpenDisplay(NULL);
+    mu_assert("error, could not open the display", disp != NULL);
+
+    char *message = run_xkb_state_tests();
+
+    xkb_state_reset();
+
+    if (original_names.symbols != NULL) {
+        load_keymap(&original_names);
+        free_names(&original_names);
+    }
+
+    XCloseDisplay(disp);
+    disp = NULL;
+
+    return message;
+}